@@ -9,6 +9,10 @@ import json
 
 dstjsonname = 'Whitelist.json'
 
+# Write the members of each product group as a pattern like chips_pringles_{001..500}
+# instead of one object per member. The plugin expands the pattern when reading the whitelist
+compact = False
+
 shelves = []
 shelves.append({
     'Name': 'BP_ShelfMain',
@@ -323,9 +327,31 @@ for shelf in shelves:
         JsonShelf['id'] = cnt
         JsonShelves.append(JsonShelf)
 
+def indicespattern(indices):
+    # turn a list of indices into the braces of a member pattern, e.g. [1, 2, 3, 7] -> {001..003,007}
+    indices = sorted(set(indices))
+    items = []
+    first = last = indices[0]
+    for idx in indices[1:] + [None]:
+        if idx is not None and idx == last + 1:
+            last = idx
+            continue
+        if first == last:
+            items.append('{:03d}'.format(first))
+        else:
+            items.append('{:03d}..{:03d}'.format(first, last))
+        if idx is not None:
+            first = last = idx
+    return '{' + ','.join(items) + '}'
+
 JsonProducts = []
 for productgroup in productgroups:
     JsonProductGroup = deepcopy(productgroup)
+    if compact:
+        JsonProductGroup['MemberPattern'] = JsonProductGroup['GroupName'] + '_' + indicespattern(list(productgroup['Repeat']))
+        del JsonProductGroup['Repeat']
+        JsonProducts.append(JsonProductGroup)
+        continue
     JsonProductGroup['Members'] = []
     repeatgroup = productgroup['Repeat']
     shuffle(repeatgroup)
@@ -57,6 +57,9 @@ public class AutoShuffleWindow : ModuleRules
 			);
 		
 		
+		// the convex decomposition calls V-HACD directly, off the game thread
+		AddEngineThirdPartyPrivateStaticDependencies(Target, "VHACD");
+
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{
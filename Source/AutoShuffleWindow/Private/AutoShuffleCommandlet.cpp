@@ -0,0 +1,76 @@
+// Copyright 1998-2016 Epic Games, Inc. All Rights Reserved.
+
+#include "AutoShuffleWindowPrivatePCH.h"
+#include "AutoShuffleCommandlet.h"
+
+#include "Engine.h"
+
+UAutoShuffleCommandlet::UAutoShuffleCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = true;
+    LogToConsole = true;
+}
+
+int32 UAutoShuffleCommandlet::Main(const FString& Params)
+{
+    FAutoShuffleSettings Settings;
+    FString MapName, ManifestFileDir = FPaths::Combine(*FPaths::GameDir(), TEXT("Data"), TEXT("LayoutManifest.bin"));
+    int32 FirstSeed = 0, LayoutsNum = 1;
+    FParse::Value(*Params, TEXT("Map="), MapName);
+    FParse::Value(*Params, TEXT("Output="), ManifestFileDir);
+    FParse::Value(*Params, TEXT("FirstSeed="), FirstSeed);
+    FParse::Value(*Params, TEXT("Layouts="), LayoutsNum);
+    FParse::Value(*Params, TEXT("Density="), Settings.Density);
+    FParse::Value(*Params, TEXT("Proximity="), Settings.Proxmity);
+    FParse::Bool(*Params, TEXT("Organize="), Settings.bIsOrganizing);
+    FParse::Bool(*Params, TEXT("PerGroup="), Settings.bIsPerGroup);
+    FParse::Bool(*Params, TEXT("RowStacking="), Settings.bIsRowStacking);
+    FParse::Value(*Params, TEXT("Occlusion="), Settings.OcclusionThreshold);
+    if (MapName.IsEmpty())
+    {
+        UE_LOG(LogAutoShuffle, Error, TEXT("No map to shuffle. Usage: -run=AutoShuffle -Map=/Game/Maps/Name [-FirstSeed=0] [-Layouts=1] [-Density=0.5] [-Proximity=0.5] [-Organize=false] [-PerGroup=false] [-RowStacking=false] [-Occlusion=0.9] [-Output=File]"));
+        return 1;
+    }
+    UWorld* World = LoadTargetWorld(MapName);
+    if (World == nullptr)
+    {
+        UE_LOG(LogAutoShuffle, Error, TEXT("Map %s could not be loaded."), *MapName);
+        return 1;
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("Generating %d layouts of %s from seed %d to %s"), LayoutsNum, *MapName, FirstSeed, *ManifestFileDir);
+    FAutoShuffleWindowModule::SetTargetWorld(World);
+    int32 GeneratedNum = FAutoShuffleWindowModule::GenerateLayouts(Settings, FirstSeed, LayoutsNum, ManifestFileDir);
+    FAutoShuffleWindowModule::SetTargetWorld(nullptr);
+    World->DestroyWorld(false);
+    World->RemoveFromRoot();
+    UE_LOG(LogAutoShuffle, Log, TEXT("Generated %d of %d layouts"), GeneratedNum, LayoutsNum);
+    return GeneratedNum == LayoutsNum ? 0 : 1;
+}
+
+UWorld* UAutoShuffleCommandlet::LoadTargetWorld(const FString& MapName)
+{
+    UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+    UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+    if (World == nullptr)
+    {
+        return nullptr;
+    }
+    World->WorldType = EWorldType::Editor;
+    World->AddToRoot();
+    if (!World->bIsWorldInitialized)
+    {
+        // the shuffle needs the physics scene for the overlap queries, and nothing else of a running world
+        UWorld::InitializationValues InitValues;
+        InitValues.RequiresHitProxies(false);
+        InitValues.ShouldSimulatePhysics(false);
+        InitValues.EnableTraceCollision(true);
+        InitValues.CreateNavigation(false);
+        InitValues.CreateAISystem(false);
+        InitValues.AllowAudioPlayback(false);
+        World->InitWorld(InitValues);
+    }
+    World->UpdateWorldComponents(true, false);
+    return World;
+}
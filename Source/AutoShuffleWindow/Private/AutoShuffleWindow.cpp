@@ -15,71 +15,135 @@
 #include "Developer/RawMesh/Public/RawMesh.h"
 // the following header files for convex decomposition
 #include "Runtime/Engine/Public/StaticMeshResources.h"
-#include "BusyCursor.h"
 #include "Runtime/Engine/Classes/PhysicsEngine/BodySetup.h"
-#include "Editor/UnrealEd/Private/ConvexDecompTool.h"
+#include "ThirdParty/VHACD/public/VHACD.h"
 #include "Editor/UnrealEd/Private/GeomFitUtils.h"
 
 #include "Engine.h"
+// the following header files for reading the whitelist in the background
+#include "Async/Async.h"
+#include "NotificationManager.h"
+#include "SNotificationList.h"
 
 static const FName AutoShuffleWindowTabName("AutoShuffleWindow");
 
+/** The package metadata keys recording the settings and the derived data key of the last batch convex decomposition of a mesh,
+ *  and the hull cache key hashed from the geometry it decomposed */
+static const FName ConvexDecompositionMetaDataKey("AutoShuffle.ConvexDecomposition");
+static const FName ConvexHullKeyMetaDataKey("AutoShuffle.ConvexHullKey");
+
 #define LOCTEXT_NAMESPACE "FAutoShuffleWindowModule"
 DEFINE_LOG_CATEGORY(LogAutoShuffle);
 
+DECLARE_STATS_GROUP(TEXT("AutoShuffle"), STATGROUP_AutoShuffle, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Read Whitelist"), STAT_AutoShuffle_ReadWhitelist, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Parse Whitelist"), STAT_AutoShuffle_ParseWhitelist, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Resolve Whitelist"), STAT_AutoShuffle_ResolveWhitelist, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Place Products"), STAT_AutoShuffle_PlaceProducts, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Expand Scale"), STAT_AutoShuffle_ExpandScale, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Organize Products"), STAT_AutoShuffle_OrganizeProducts, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Lower Products"), STAT_AutoShuffle_LowerProducts, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Rasterize Occlusion"), STAT_AutoShuffle_RasterizeOcclusion, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Count Occlusion Pixels"), STAT_AutoShuffle_CountOcclusionPixels, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Batch Convex Decomposition"), STAT_AutoShuffle_BatchConvexDecomposition, STATGROUP_AutoShuffle);
+DECLARE_CYCLE_STAT(TEXT("Decompose Mesh"), STAT_AutoShuffle_DecomposeMesh, STATGROUP_AutoShuffle);
+
 // #define VERBOSE_AUTO_SHUFFLE
 #define AUTO_SHUFFLE_Y_TWO_END_OFFSET 10.f
 #define AUTO_SHUFFLE_MAX_TRY_TIMES 50
 #define AUTO_SHUFFLE_INC_STEP 0.1f
 #define AUTO_SHUFFLE_INC_BOUND 1000
 #define AUTO_SHUFFLE_EXPANSION_BOUND 20
+#define AUTO_SHUFFLE_FAILURE_MEMO_MIN_TRIES 5
+#define AUTO_SHUFFLE_DISCARD_POOL_SPACING 200.f
+#define AUTO_SHUFFLE_DISCARD_POOL_ROW 64
+#define AUTO_SHUFFLE_NAME_PATTERN_MAX_NAMES 100000
+#define AUTO_SHUFFLE_TICK_BUDGET 0.02
 
 void FAutoShuffleWindowModule::StartupModule()
 {
     // This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
     
-    FAutoShuffleWindowStyle::Initialize();
-    FAutoShuffleWindowStyle::ReloadTextures();
+    // a commandlet has no level editor to extend and usually no Slate
+    if (!IsRunningCommandlet())
+    {
+        FAutoShuffleWindowStyle::Initialize();
+        FAutoShuffleWindowStyle::ReloadTextures();
 
-    FAutoShuffleWindowCommands::Register();
+        FAutoShuffleWindowCommands::Register();
     
-    PluginCommands = MakeShareable(new FUICommandList);
+        PluginCommands = MakeShareable(new FUICommandList);
 
-    PluginCommands->MapAction(
-        FAutoShuffleWindowCommands::Get().OpenPluginWindow,
-        FExecuteAction::CreateRaw(this, &FAutoShuffleWindowModule::PluginButtonClicked),
-        FCanExecuteAction());
+        PluginCommands->MapAction(
+            FAutoShuffleWindowCommands::Get().OpenPluginWindow,
+            FExecuteAction::CreateRaw(this, &FAutoShuffleWindowModule::PluginButtonClicked),
+            FCanExecuteAction());
         
-    FLevelEditorModule& LevelEditorModule = FModuleManager::LoadModuleChecked<FLevelEditorModule>("LevelEditor");
+        FLevelEditorModule& LevelEditorModule = FModuleManager::LoadModuleChecked<FLevelEditorModule>("LevelEditor");
     
-    {
-        TSharedPtr<FExtender> MenuExtender = MakeShareable(new FExtender());
-        MenuExtender->AddMenuExtension("WindowLayout", EExtensionHook::After, PluginCommands, FMenuExtensionDelegate::CreateRaw(this, &FAutoShuffleWindowModule::AddMenuExtension));
+        {
+            TSharedPtr<FExtender> MenuExtender = MakeShareable(new FExtender());
+            MenuExtender->AddMenuExtension("WindowLayout", EExtensionHook::After, PluginCommands, FMenuExtensionDelegate::CreateRaw(this, &FAutoShuffleWindowModule::AddMenuExtension));
 
-        LevelEditorModule.GetMenuExtensibilityManager()->AddExtender(MenuExtender);
-    }
+            LevelEditorModule.GetMenuExtensibilityManager()->AddExtender(MenuExtender);
+        }
     
-    {
-        TSharedPtr<FExtender> ToolbarExtender = MakeShareable(new FExtender);
-        ToolbarExtender->AddToolBarExtension("Settings", EExtensionHook::After, PluginCommands, FToolBarExtensionDelegate::CreateRaw(this, &FAutoShuffleWindowModule::AddToolbarExtension));
+        {
+            TSharedPtr<FExtender> ToolbarExtender = MakeShareable(new FExtender);
+            ToolbarExtender->AddToolBarExtension("Settings", EExtensionHook::After, PluginCommands, FToolBarExtensionDelegate::CreateRaw(this, &FAutoShuffleWindowModule::AddToolbarExtension));
         
-        LevelEditorModule.GetToolBarExtensibilityManager()->AddExtender(ToolbarExtender);
-    }
+            LevelEditorModule.GetToolBarExtensibilityManager()->AddExtender(ToolbarExtender);
+        }
     
-    FGlobalTabmanager::Get()->RegisterNomadTabSpawner(AutoShuffleWindowTabName, FOnSpawnTab::CreateRaw(this, &FAutoShuffleWindowModule::OnSpawnPluginTab))
-        .SetDisplayName(LOCTEXT("FAutoShuffleWindowTabTitle", "AutoShuffleWindow"))
-        .SetMenuType(ETabSpawnerMenuType::Hidden);
+        FGlobalTabmanager::Get()->RegisterNomadTabSpawner(AutoShuffleWindowTabName, FOnSpawnTab::CreateRaw(this, &FAutoShuffleWindowModule::OnSpawnPluginTab))
+            .SetDisplayName(LOCTEXT("FAutoShuffleWindowTabTitle", "AutoShuffleWindow"))
+            .SetMenuType(ETabSpawnerMenuType::Hidden);
+    }
 }
 
 void FAutoShuffleWindowModule::ShutdownModule()
 {
     // This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
     // we call this function before unloading the module.
-    FAutoShuffleWindowStyle::Shutdown();
+    if (!IsRunningCommandlet())
+    {
+        FAutoShuffleWindowStyle::Shutdown();
+
+        FAutoShuffleWindowCommands::Unregister();
+
+        FGlobalTabmanager::Get()->UnregisterNomadTabSpawner(AutoShuffleWindowTabName);
+    }
 
-    FAutoShuffleWindowCommands::Unregister();
+    if (ShuffleTickerHandle.IsValid())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(ShuffleTickerHandle);
+        ShuffleTickerHandle.Reset();
+    }
+    if (DecompositionTickerHandle.IsValid())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(DecompositionTickerHandle);
+        DecompositionTickerHandle.Reset();
+    }
+    if (WhitelistTickerHandle.IsValid())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(WhitelistTickerHandle);
+        WhitelistTickerHandle.Reset();
+    }
 
-    FGlobalTabmanager::Get()->UnregisterNomadTabSpawner(AutoShuffleWindowTabName);
+    // the background tasks write into the statics of this module, so they must be done before its code goes away
+    bIsDecompositionCancelled = true;
+    for (auto JobIt = DecompositionJobs.CreateIterator(); JobIt; ++JobIt)
+    {
+        if (JobIt->Result.IsValid())
+        {
+            JobIt->Result.Wait();
+        }
+    }
+    DecompositionJobs.Reset();
+    if (WhitelistParseResult.IsValid())
+    {
+        WhitelistParseResult.Wait();
+    }
 }
 
 TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabArgs& SpawnTabArgs)
@@ -104,8 +168,32 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
     OcclusionSpinBox->SetMaxSliderValue(1.f);
     OcclusionSpinBox->SetValue(0.9f);
     
+    AccuracySpinBox = SNew(SSpinBox<float>);
+    AccuracySpinBox->SetMinValue(0.f);
+    AccuracySpinBox->SetMaxValue(1.f);
+    AccuracySpinBox->SetMinSliderValue(0.f);
+    AccuracySpinBox->SetMaxSliderValue(1.f);
+    AccuracySpinBox->SetValue(1.f);
+    MaxHullVertsSpinBox = SNew(SSpinBox<int32>);
+    MaxHullVertsSpinBox->SetMinValue(6);
+    MaxHullVertsSpinBox->SetMaxValue(32);
+    MaxHullVertsSpinBox->SetMinSliderValue(6);
+    MaxHullVertsSpinBox->SetMaxSliderValue(32);
+    MaxHullVertsSpinBox->SetValue(32);
+    
     // init or re-init the checkboxes
     OrganizeCheckBox = SNew(SCheckBox);
+    PerGroupCheckBox = SNew(SCheckBox);
+    RowStackingCheckBox = SNew(SCheckBox);
+    DetailedExportCheckBox = SNew(SCheckBox);
+    ProxyErrorCheckBox = SNew(SCheckBox);
+    BinaryExportCheckBox = SNew(SCheckBox);
+
+    // init or re-init the placement stats of the last shuffle
+    PlacementStatsTextBlock = SNew(STextBlock).Text(FText::FromString(TEXT("No placement stats yet")));
+
+    // init or re-init the snapshot name
+    SnapshotNameTextBox = SNew(SEditableTextBox).Text(FText::FromString(TEXT("Default")));
 
     // set the region of the discarded products to origin
     DiscardedProductsRegions = FVector(0.f, 0.f, 0.f);
@@ -136,15 +224,31 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
     ExportActorNameMappingButton->SetHAlign(HAlign_Center);
     ExportActorNameMappingButton->SetContent(SNew(STextBlock).Text(FText::FromString(TEXT("Export Actor Name Mapping"))));
 
+    TSharedRef<SButton> SaveSnapshotButton = SNew(SButton);
+    SaveSnapshotButton->SetVAlign(VAlign_Center);
+    SaveSnapshotButton->SetHAlign(HAlign_Center);
+    SaveSnapshotButton->SetContent(SNew(STextBlock).Text(FText::FromString(TEXT("Save Snapshot"))));
+
+    TSharedRef<SButton> RestoreSnapshotButton = SNew(SButton);
+    RestoreSnapshotButton->SetVAlign(VAlign_Center);
+    RestoreSnapshotButton->SetHAlign(HAlign_Center);
+    RestoreSnapshotButton->SetContent(SNew(STextBlock).Text(FText::FromString(TEXT("Restore Snapshot"))));
+
+    TSharedRef<SButton> AppendLayoutManifestButton = SNew(SButton);
+    AppendLayoutManifestButton->SetVAlign(VAlign_Center);
+    AppendLayoutManifestButton->SetHAlign(HAlign_Center);
+    AppendLayoutManifestButton->SetContent(SNew(STextBlock).Text(FText::FromString(TEXT("Append Layout To Manifest"))));
+
     auto OnAutoShuffleButtonClickedLambda = []() -> FReply
     {
-        AutoShuffleImplementation();
+        // the whitelist is read in the background and the shuffle starts once the actors are resolved
+        ReadWhitelistAsync(FSimpleDelegate::CreateStatic(&FAutoShuffleWindowModule::StartShuffle));
         return FReply::Handled();
     };
 
     auto OnOcclusionVisibilityButtonClickedLambda = []() -> FReply
     {
-        OcclusionVisibilityImplementation();
+        ReadWhitelistAsync(FSimpleDelegate::CreateStatic(&FAutoShuffleWindowModule::ComputeOcclusionVisibility));
         return FReply::Handled();
     };
 
@@ -168,16 +272,44 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
         return FReply::Handled();
     };
     
+    auto OnSaveSnapshotButtonClickedLambda = []() -> FReply
+    {
+        SaveLayoutSnapshot();
+        return FReply::Handled();
+    };
+
+    auto OnRestoreSnapshotButtonClickedLambda = []() -> FReply
+    {
+        RestoreLayoutSnapshot();
+        return FReply::Handled();
+    };
+    
+    auto OnAppendLayoutManifestButtonClickedLambda = []() -> FReply
+    {
+        AppendLayoutManifest();
+        return FReply::Handled();
+    };
+    
     AutoShuffleButton->SetOnClicked(FOnClicked::CreateLambda(OnAutoShuffleButtonClickedLambda));
     OcclusionVisibilityButton->SetOnClicked(FOnClicked::CreateLambda(OnOcclusionVisibilityButtonClickedLambda));
     BatchConvexDecompButton->SetOnClicked(FOnClicked::CreateLambda(OnBatchConvexDecompButtonClickedLambda));
     NonProductsVisibleToggleButton->SetOnClicked(FOnClicked::CreateLambda(OnNonProductsVisibleToggleButtonClickedLamda));
     ExportActorNameMappingButton->SetOnClicked(FOnClicked::CreateLambda(OnExportActorNameMappingButtonClickedLambda));
+    SaveSnapshotButton->SetOnClicked(FOnClicked::CreateLambda(OnSaveSnapshotButtonClickedLambda));
+    RestoreSnapshotButton->SetOnClicked(FOnClicked::CreateLambda(OnRestoreSnapshotButtonClickedLambda));
+    AppendLayoutManifestButton->SetOnClicked(FOnClicked::CreateLambda(OnAppendLayoutManifestButtonClickedLambda));
     FText Density = FText::FromString(TEXT("Density      "));
     FText Proxmity = FText::FromString(TEXT("Proxmity   "));
     FText Organize = FText::FromString(TEXT("Organize   "));
     FText PerGroup = FText::FromString(TEXT("PerGroup   "));
+    FText RowStacking = FText::FromString(TEXT("RowStacking   "));
     FText OcclusionThreshold = FText::FromString(TEXT("OccThres   "));
+    FText DetailedExport = FText::FromString(TEXT("Detailed   "));
+    FText BinaryExport = FText::FromString(TEXT("Binary   "));
+    FText SnapshotName = FText::FromString(TEXT("Snapshot   "));
+    FText Accuracy = FText::FromString(TEXT("Accuracy   "));
+    FText ProxyError = FText::FromString(TEXT("ProxyError   "));
+    FText MaxHullVerts = FText::FromString(TEXT("HullVerts   "));
     
     return SNew(SDockTab).TabRole(ETabRole::NomadTab)
     [
@@ -191,7 +323,7 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
             ]
             + SHorizontalBox::Slot().HAlign(HAlign_Fill)
             [
-                DensitySpinBox
+                DensitySpinBox.ToSharedRef()
             ]
         ]
         + SVerticalBox::Slot().Padding(30.f, 10.f).AutoHeight()
@@ -203,7 +335,7 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
             ]
             + SHorizontalBox::Slot().HAlign(HAlign_Fill)
             [
-                ProxmitySpinBox
+                ProxmitySpinBox.ToSharedRef()
             ]
         ]
         + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
@@ -215,7 +347,7 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
             ]
             + SHorizontalBox::Slot().HAlign(HAlign_Fill)
             [
-                OrganizeCheckBox
+                OrganizeCheckBox.ToSharedRef()
             ]
             + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
             [
@@ -223,13 +355,53 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
             ]
             + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
             [
-                PerGroupCheckBox
+                PerGroupCheckBox.ToSharedRef()
+            ]
+        ]
+        + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
+        [
+            SNew(SHorizontalBox)
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
+            [
+                SNew(STextBlock).Text(RowStacking)
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill)
+            [
+                RowStackingCheckBox.ToSharedRef()
             ]
         ]
         + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
         [
             AutoShuffleButton
         ]
+        + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
+        [
+            PlacementStatsTextBlock.ToSharedRef()
+        ]
+        + SVerticalBox::Slot().Padding(30.f, 10.f).AutoHeight()
+        [
+            SNew(SHorizontalBox)
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
+            [
+                SNew(STextBlock).Text(SnapshotName)
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill)
+            [
+                SnapshotNameTextBox.ToSharedRef()
+            ]
+        ]
+        + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
+        [
+            SNew(SHorizontalBox)
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).Padding(0.f, 0.f, 5.f, 0.f)
+            [
+                SaveSnapshotButton
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).Padding(5.f, 0.f, 0.f, 0.f)
+            [
+                RestoreSnapshotButton
+            ]
+        ]
         + SVerticalBox::Slot().Padding(30.f, 10.f).AutoHeight()
         [
             SNew(SHorizontalBox)
@@ -239,13 +411,41 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
             ]
             + SHorizontalBox::Slot().HAlign(HAlign_Fill)
             [
-                OcclusionSpinBox
+                OcclusionSpinBox.ToSharedRef()
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth().Padding(10.f, 0.f, 0.f, 0.f)
+            [
+                SNew(STextBlock).Text(ProxyError)
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
+            [
+                ProxyErrorCheckBox.ToSharedRef()
             ]
         ]
         + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
         [
             OcclusionVisibilityButton
         ]
+        + SVerticalBox::Slot().Padding(30.f, 10.f).AutoHeight()
+        [
+            SNew(SHorizontalBox)
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
+            [
+                SNew(STextBlock).Text(Accuracy)
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill)
+            [
+                AccuracySpinBox.ToSharedRef()
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
+            [
+                SNew(STextBlock).Text(MaxHullVerts)
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill)
+            [
+                MaxHullVertsSpinBox.ToSharedRef()
+            ]
+        ]
         + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
         [
             BatchConvexDecompButton
@@ -255,9 +455,33 @@ TSharedRef<SDockTab> FAutoShuffleWindowModule::OnSpawnPluginTab(const FSpawnTabA
             NonProductsVisibleToggleButton
         ]
         + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
+        [
+            SNew(SHorizontalBox)
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
+            [
+                SNew(STextBlock).Text(DetailedExport)
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill)
+            [
+                DetailedExportCheckBox.ToSharedRef()
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
+            [
+                SNew(STextBlock).Text(BinaryExport)
+            ]
+            + SHorizontalBox::Slot().HAlign(HAlign_Fill).VAlign(VAlign_Center).AutoWidth()
+            [
+                BinaryExportCheckBox.ToSharedRef()
+            ]
+        ]
+        + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
         [
             ExportActorNameMappingButton
         ]
+        + SVerticalBox::Slot().AutoHeight().Padding(30.f, 10.f)
+        [
+            AppendLayoutManifestButton
+        ]
     ];
 }
 
@@ -277,1419 +501,4394 @@ void FAutoShuffleWindowModule::AddToolbarExtension(FToolBarBuilder& Builder)
 }
 
 /** The folloinwg are the implemetations of the auto shuffle */
-TSharedRef<SSpinBox<float>> FAutoShuffleWindowModule::DensitySpinBox = SNew(SSpinBox<float>);
-TSharedRef<SSpinBox<float>> FAutoShuffleWindowModule::ProxmitySpinBox = SNew(SSpinBox<float>);
-TSharedRef<SSpinBox<float>> FAutoShuffleWindowModule::OcclusionSpinBox = SNew(SSpinBox<float>);
-TSharedRef<SCheckBox> FAutoShuffleWindowModule::OrganizeCheckBox = SNew(SCheckBox);
-TSharedRef<SCheckBox> FAutoShuffleWindowModule::PerGroupCheckBox = SNew(SCheckBox);
-TArray<FAutoShuffleShelf>* FAutoShuffleWindowModule::ShelvesWhitelist = nullptr;
-TArray<FAutoShuffleProductGroup>* FAutoShuffleWindowModule::ProductsWhitelist = nullptr;
+TSharedPtr<SSpinBox<float>> FAutoShuffleWindowModule::DensitySpinBox;
+TSharedPtr<SSpinBox<float>> FAutoShuffleWindowModule::ProxmitySpinBox;
+TSharedPtr<SSpinBox<float>> FAutoShuffleWindowModule::OcclusionSpinBox;
+TSharedPtr<SCheckBox> FAutoShuffleWindowModule::OrganizeCheckBox;
+TSharedPtr<SCheckBox> FAutoShuffleWindowModule::PerGroupCheckBox;
+TSharedPtr<SCheckBox> FAutoShuffleWindowModule::RowStackingCheckBox;
+TSharedPtr<SCheckBox> FAutoShuffleWindowModule::DetailedExportCheckBox;
+TSharedPtr<SCheckBox> FAutoShuffleWindowModule::BinaryExportCheckBox;
+TSharedPtr<SEditableTextBox> FAutoShuffleWindowModule::SnapshotNameTextBox;
+TMap<FString, FAutoShuffleLayoutSnapshot> FAutoShuffleWindowModule::LayoutSnapshots;
+TArray<FAutoShuffleShelf> FAutoShuffleWindowModule::ShelvesWhitelist;
+TArray<FAutoShuffleProductGroup> FAutoShuffleWindowModule::ProductsWhitelist;
+FAutoShuffleProductStore FAutoShuffleWindowModule::ProductStore;
 FVector FAutoShuffleWindowModule::DiscardedProductsRegions;
+TMap<FString, AActor*> FAutoShuffleWindowModule::ActorLabelIndex;
+TArray<FString> FAutoShuffleWindowModule::UnresolvedGroups;
+TArray<TWeakObjectPtr<AActor>> FAutoShuffleWindowModule::NonProductActors;
+TWeakObjectPtr<UWorld> FAutoShuffleWindowModule::VisibilityWorld;
+TSharedPtr<FAutoShuffleWhitelistDescription, ESPMode::ThreadSafe> FAutoShuffleWindowModule::PendingWhitelist;
+TFuture<bool> FAutoShuffleWindowModule::WhitelistParseResult;
+FThreadSafeCounter FAutoShuffleWindowModule::WhitelistBytesRead;
+int64 FAutoShuffleWindowModule::WhitelistFileSize;
+FDelegateHandle FAutoShuffleWindowModule::WhitelistTickerHandle;
+FSimpleDelegate FAutoShuffleWindowModule::OnWhitelistResolved;
+TSharedPtr<SNotificationItem> FAutoShuffleWindowModule::WhitelistNotification;
+TArray<FAutoShuffleDecompositionJob> FAutoShuffleWindowModule::DecompositionJobs;
+int32 FAutoShuffleWindowModule::NextDecompositionJob;
+int32 FAutoShuffleWindowModule::RunningDecompositionJobs;
+int32 FAutoShuffleWindowModule::AppliedDecompositionJobs;
+TSharedPtr<SSpinBox<float>> FAutoShuffleWindowModule::AccuracySpinBox;
+TSharedPtr<SCheckBox> FAutoShuffleWindowModule::ProxyErrorCheckBox;
+TSharedPtr<SSpinBox<int32>> FAutoShuffleWindowModule::MaxHullVertsSpinBox;
+FThreadSafeCounter FAutoShuffleWindowModule::CachedDecompositionJobs;
+FThreadSafeBool FAutoShuffleWindowModule::bIsDecompositionCancelled;
+FDelegateHandle FAutoShuffleWindowModule::DecompositionTickerHandle;
+TSharedPtr<SNotificationItem> FAutoShuffleWindowModule::DecompositionNotification;
 bool FAutoShuffleWindowModule::bIsOrganizeChecked;
 bool FAutoShuffleWindowModule::bIsPerGroupChecked;
+bool FAutoShuffleWindowModule::bIsRowStackingChecked;
 bool FAutoShuffleWindowModule::bIsNonProductsVisible;
+FAutoShuffleWindowModule::EShufflePhase FAutoShuffleWindowModule::ShufflePhase = FAutoShuffleWindowModule::SP_Done;
+int32 FAutoShuffleWindowModule::ShuffleStep;
+int32 FAutoShuffleWindowModule::ShuffleStepsNum[FAutoShuffleWindowModule::SP_Done];
+float FAutoShuffleWindowModule::ShuffleDensity;
+float FAutoShuffleWindowModule::ShuffleProxmity;
+bool FAutoShuffleWindowModule::bIsShuffleCancelled;
+FDelegateHandle FAutoShuffleWindowModule::ShuffleTickerHandle;
+TSharedPtr<SNotificationItem> FAutoShuffleWindowModule::ShuffleNotification;
+FAutoShufflePhaseTimings FAutoShuffleWindowModule::RunTimings;
+TArray<FAutoShufflePlacementStats> FAutoShuffleWindowModule::GroupPlacementStats;
+TArray<TArray<float>> FAutoShuffleWindowModule::ShelfLevelFreeAreas;
+TArray<float> FAutoShuffleWindowModule::ShelfPendingFootprints;
+TArray<TArray<FVector2D>> FAutoShuffleWindowModule::ShelfLevelFailedFootprints;
+TArray<TArray<int32>> FAutoShuffleWindowModule::ShelfLevelFailureEpochs;
+TArray<int32> FAutoShuffleWindowModule::ShelfFreeSpaceEpochs;
+TArray<FAutoShufflePlacementStats> FAutoShuffleWindowModule::ShelfPlacementStats;
+TArray<int32> FAutoShuffleWindowModule::ProductGroupIndices;
+FAutoShuffleGroupPlacement FAutoShuffleWindowModule::GroupPlacement;
+int32 FAutoShuffleWindowModule::OrganizeShelfIdx = INDEX_NONE;
+TArray<AActor*> FAutoShuffleWindowModule::OrganizedProducts;
+int32 FAutoShuffleWindowModule::NextOrganizedProduct;
+TSharedPtr<STextBlock> FAutoShuffleWindowModule::PlacementStatsTextBlock;
+TWeakObjectPtr<UWorld> FAutoShuffleWindowModule::TargetWorld;
+double FAutoShuffleWindowModule::WhitelistReadStartTime;
+double FAutoShuffleWindowModule::DecompositionStartTime;
 
 // the rendering device: a very big two-dimensional tarray of index of actors, and depth
 TArray<class FOcclusionPixel> FAutoShuffleWindowModule::RenderingDevice[OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT][OCCLUSION_VISIBILITY_RESOLUTION_WIDTH];
 
-void FAutoShuffleWindowModule::AutoShuffleImplementation()
+void FAutoShuffleWindowModule::SetTargetWorld(UWorld* World)
+{
+    TargetWorld = World;
+}
+
+UWorld* FAutoShuffleWindowModule::GetTargetWorld()
 {
-    float Density = FAutoShuffleWindowModule::DensitySpinBox->GetValue();
-    float Proxmity = FAutoShuffleWindowModule::ProxmitySpinBox->GetValue();
-    bIsOrganizeChecked = FAutoShuffleWindowModule::OrganizeCheckBox->IsChecked();
-    bIsPerGroupChecked = FAutoShuffleWindowModule::PerGroupCheckBox->IsChecked();
-    bool Result = FAutoShuffleWindowModule::ReadWhitelist();
+    if (TargetWorld.IsValid())
+    {
+        return TargetWorld.Get();
+    }
+    return GEditor ? GEditor->GetEditorWorldContext().World() : nullptr;
+}
+
+int32 FAutoShuffleWindowModule::GenerateLayouts(const FAutoShuffleSettings& Settings, int32 FirstSeed, int32 LayoutsNum, const FString& ManifestFileDir)
+{
+    RunTimings.Reset();
+    // nothing read from the whitelist may depend on the time-seeded generator, or the same seed would give
+    // another layout on another node
+    FMath::RandInit(FirstSeed);
+    bool Result = ReadWhitelist();
     if (!Result)
     {
         UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist read wrong. Module quits."));
-        return;
+        return 0;
     }
-    // Activate, put aside and shrink all the Products
-    for (auto ProductGroupIt = ProductsWhitelist->CreateIterator(); ProductGroupIt; ++ProductGroupIt)
+    // every layout starts from the level as loaded, so that a seed gives the same layout whatever range it is run in
+    FAutoShuffleLayoutSnapshot InitialLayout;
+    InitialLayout.Capture(ProductStore);
+    int32 GeneratedNum = 0;
+    for (int32 LayoutIdx = 0; LayoutIdx < LayoutsNum; ++LayoutIdx)
     {
-        for (auto ProductIt = ProductGroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
+        int32 Seed = FirstSeed + LayoutIdx;
+        double StartTime = FPlatformTime::Seconds();
+        InitialLayout.Restore(ProductStore);
+        FMath::RandInit(Seed);
+        RunTimings.Reset();
+        ShuffleProducts(Settings);
+        ComputeOcclusionVisibilityWithSettings(Settings);
+        if (!WriteLayoutManifest(ManifestFileDir))
         {
-            ProductIt->ResetDiscard();
-            ProductIt->ResetOnShelf();
-            ProductIt->SetPosition(DiscardedProductsRegions);
-            ProductIt->ShrinkScale();
+            break;
         }
+        ++GeneratedNum;
+        UE_LOG(LogAutoShuffle, Log, TEXT("Layout %d / %d of seed %d generated in %.2f s"), GeneratedNum, LayoutsNum, Seed, FPlatformTime::Seconds() - StartTime);
     }
-    // AddNoiseToShelf("BP_ShelfMain_002", 50);
-    PlaceProducts(Density, Proxmity);
-    // Expand all the Products
-    for (int ExpendIdx = 0; ExpendIdx < AUTO_SHUFFLE_EXPANSION_BOUND; ++ExpendIdx)
+    return GeneratedNum;
+}
+
+FAutoShuffleSettings FAutoShuffleWindowModule::GetWindowSettings()
+{
+    FAutoShuffleSettings Settings;
+    Settings.Density = DensitySpinBox->GetValue();
+    Settings.Proxmity = ProxmitySpinBox->GetValue();
+    Settings.bIsOrganizing = OrganizeCheckBox->IsChecked();
+    Settings.bIsPerGroup = PerGroupCheckBox->IsChecked();
+    Settings.bIsRowStacking = RowStackingCheckBox->IsChecked();
+    Settings.OcclusionThreshold = OcclusionSpinBox->GetValue();
+    Settings.bIsProxyErrorReported = ProxyErrorCheckBox->IsChecked();
+    return Settings;
+}
+
+void FAutoShuffleWindowModule::ShuffleProducts(const FAutoShuffleSettings& Settings)
+{
+    if (ShuffleTickerHandle.IsValid())
     {
-        for (auto ProductGroupIt = ProductsWhitelist->CreateIterator(); ProductGroupIt; ++ProductGroupIt)
-        {
-            for (auto ProductIt = ProductGroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
-            {
-                if (!ProductIt->IsDiscarded())
-                {
-                    ProductIt->ExpandScale();
-                }
-            }
-        }
+        UE_LOG(LogAutoShuffle, Warning, TEXT("A shuffle is already running."));
+        return;
     }
-    if (bIsOrganizeChecked)
+    BeginShuffle(Settings);
+    while (StepShuffle())
     {
-        for (int i = 0; i < 2; ++i)
-        {
-            OrganizeProducts();
-        }
     }
-    LowerProducts();
+    WritePlacementStats();
+    WritePhaseTimings(TEXT("Shuffle"));
 }
 
-void FAutoShuffleWindowModule::OcclusionVisibilityImplementation()
+void FAutoShuffleWindowModule::StartShuffle()
 {
-    UE_LOG(LogAutoShuffle, Log, TEXT("Set Occlusion Visibility"));
-    float OcclusionThreshold = FAutoShuffleWindowModule::OcclusionSpinBox->GetValue();
-    bool Result = FAutoShuffleWindowModule::ReadWhitelist();
-    if (!Result)
+    if (ShuffleTickerHandle.IsValid())
     {
-        UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist read wrong. Module quits."));
+        UE_LOG(LogAutoShuffle, Warning, TEXT("A shuffle is already running."));
         return;
     }
-    // find the boundary of the shelves
-    // pre-assumptions: looking from small x to big x, and within 1e10 scale
-    float RenderingBorderXLeft = 1e10f, RenderingBorderXRight = -1e10f,
-        RenderingBorderYLeft = 1e10f, RenderingBorderYRight = -1e10f,
-        RenderingBorderZLeft = 1e10f, RenderingBorderZRight = -1e10f;
-    for (auto ShelfIt = ShelvesWhitelist->CreateIterator(); ShelfIt; ++ShelfIt)
+    BeginShuffle(GetWindowSettings());
+    bIsShuffleCancelled = false;
+    FNotificationInfo Info(FText::FromString(TEXT("Shuffling...")));
+    Info.bFireAndForget = false;
+    Info.ButtonDetails.Add(FNotificationButtonInfo(FText::FromString(TEXT("Cancel")), FText::FromString(TEXT("Stop and go back to the layout before the shuffle")),
+        FSimpleDelegate::CreateStatic(&FAutoShuffleWindowModule::CancelShuffle), SNotificationItem::CS_Pending));
+    ShuffleNotification = FSlateNotificationManager::Get().AddNotification(Info);
+    if (ShuffleNotification.IsValid())
     {
-        FVector ShelfOrigin, ShelfExtent;
-        ShelfIt->GetObjectActor()->GetActorBounds(false, ShelfOrigin, ShelfExtent);
-        RenderingBorderXLeft = FMath::Min(RenderingBorderXLeft, ShelfOrigin.X - ShelfExtent.X);
-        RenderingBorderXRight = FMath::Max(RenderingBorderXRight, ShelfOrigin.X + ShelfExtent.X);
-        RenderingBorderYLeft = FMath::Min(RenderingBorderYLeft, ShelfOrigin.Y - ShelfExtent.Y);
-        RenderingBorderYRight = FMath::Max(RenderingBorderYRight, ShelfOrigin.Y + ShelfExtent.Y);
-        RenderingBorderZLeft = FMath::Min(RenderingBorderZLeft, ShelfOrigin.Z - ShelfExtent.Z);
-        RenderingBorderZRight = FMath::Max(RenderingBorderZRight, ShelfOrigin.Z + ShelfExtent.Z);
+        ShuffleNotification->SetCompletionState(SNotificationItem::CS_Pending);
     }
-    UE_LOG(LogAutoShuffle, Log, TEXT("Valid Boundary: %f, %f, %f, %f, %f, %f"), RenderingBorderXLeft, RenderingBorderXRight, RenderingBorderYLeft, RenderingBorderYRight, RenderingBorderZLeft, RenderingBorderZRight);
-    // clean the occlusion visibility rendering device
-    for (int y = 0; y < OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT; ++y)
+    ShuffleTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&FAutoShuffleWindowModule::TickShuffle));
+}
+
+void FAutoShuffleWindowModule::BeginShuffle(const FAutoShuffleSettings& Settings)
+{
+    ShuffleDensity = Settings.Density;
+    ShuffleProxmity = Settings.Proxmity;
+    bIsOrganizeChecked = Settings.bIsOrganizing;
+    bIsPerGroupChecked = Settings.bIsPerGroup;
+    bIsRowStackingChecked = Settings.bIsRowStacking;
+    // keep the layout to go back to without shuffling again
+    LayoutSnapshots.FindOrAdd(TEXT("PreviousShuffle")).Capture(ProductStore);
+    // A step of the placement places one product and a step of the organizing pushes one product, so that a step is
+    // about one product between two checks of the frame budget. The placement counts the groups of each shelf and the
+    // organizing counts its passes: their steps move on only once the group or the pass is done
+    GroupPlacement.Reset();
+    OrganizeShelfIdx = INDEX_NONE;
+    ShuffleStepsNum[SP_Park] = ProductStore.Num();
+    ShuffleStepsNum[SP_Place] = ShelvesWhitelist.Num() * ProductsWhitelist.Num();
+    ShuffleStepsNum[SP_Expand] = AUTO_SHUFFLE_EXPANSION_BOUND * ProductStore.Num();
+    ShuffleStepsNum[SP_Organize] = bIsOrganizeChecked ? 2 : 0;
+    ShuffleStepsNum[SP_Lower] = 1;
+    ShufflePhase = SP_Park;
+    ShuffleStep = 0;
+    ResetPlacementStats();
+    ResetShelfCapacities();
+}
+
+bool FAutoShuffleWindowModule::StepShuffle()
+{
+    // move on to the next phase with steps left
+    while (ShufflePhase < SP_Done && ShuffleStep >= ShuffleStepsNum[ShufflePhase])
     {
-        for (int x = 0; x < OCCLUSION_VISIBILITY_RESOLUTION_WIDTH; ++x)
-        {
-            RenderingDevice[y][x].Empty();
-        }
+        // the phase worked on staged transforms; the actors are updated once per product here
+        ProductStore.CommitTransforms();
+        ShufflePhase = EShufflePhase(ShufflePhase + 1);
+        ShuffleStep = 0;
     }
-    // gather all the valid static mesh actors
-    TArray<AStaticMeshActor*> ActorArray;
-    TArray<FString> ActorNameArray;
-    for (auto GroupIt = ProductsWhitelist->CreateIterator(); GroupIt; ++GroupIt)
+    if (ShufflePhase == SP_Done)
     {
-        for (auto ProductIt = GroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
-        {
-            // see if the product is within the border by testing the product center
-            FVector ProductOrigin, ProductExtent;
-            if (!ProductIt->GetObjectActor())
-            {
-                continue;
-            }
-            AStaticMeshActor* StaticMeshActor = Cast<AStaticMeshActor>(ProductIt->GetObjectActor());
-            ProductIt->GetObjectActor()->GetActorBounds(false, ProductOrigin, ProductExtent);
-            if (ProductOrigin.X > RenderingBorderXRight || ProductOrigin.X < RenderingBorderXLeft ||
-                ProductOrigin.Y > RenderingBorderYRight || ProductOrigin.Y < RenderingBorderYLeft ||
-                /** ProductOrigin.Z > RenderingBorderZRight || */ ProductOrigin.Z < RenderingBorderZLeft)
-            {
-                continue;
-            }
-            if (StaticMeshActor)
-            {
-                ActorArray.Add(StaticMeshActor);
-                ActorNameArray.Add(ProductIt->GetName());
-            }
-        }
+        return false;
     }
-    // Get all the meshes and draw them on the rendering device
-    // Reference: https://forums.unrealengine.com/showthread.php?8856-Accessing-Vertex-Positions-of-static-mesh
-    // Reference: https://answers.unrealengine.com/questions/465376/access-to-mesh-data-in-object-via-c.html
-    // @todo Parallelable
-    UE_LOG(LogAutoShuffle, Log, TEXT("Start rendering %d static meshes"), ActorArray.Num());
-    FDateTime DateTime;
-    UE_LOG(LogAutoShuffle, Log, TEXT("%d: %d: %d starts"), DateTime.Now().GetMinute(), DateTime.Now().GetSecond(), DateTime.Now().GetMillisecond());
-    for (int ActorIdx = 0; ActorIdx < ActorArray.Num(); ++ActorIdx)
+    FAutoShufflePhaseScope PhaseScope(RunTimings, GetShufflePhaseName(ShufflePhase));
+    // a placement step of a group or an organizing step of a pass leaves the rest of it for the next steps
+    bool bIsStepDone = true;
+    switch (ShufflePhase)
     {
-        if (!ActorArray[ActorIdx]->GetStaticMeshComponent())
-        {
-            continue;
-        }
-        if (!ActorArray[ActorIdx]->GetStaticMeshComponent()->GetStaticMesh())
-        {
-            continue;
-        }
-        if (ActorArray[ActorIdx]->GetStaticMeshComponent()->GetStaticMesh()->SourceModels.Num() == 0)
-        {
-            continue;
-        }
-        FRawMesh RawMesh;
-        ActorArray[ActorIdx]->GetStaticMeshComponent()->GetStaticMesh()->SourceModels[0].RawMeshBulkData->LoadRawMesh(RawMesh);
-        TArray<FVector> Vertices = RawMesh.VertexPositions;
-        TArray<uint32> Wedges = RawMesh.WedgeIndices;
-        // Assumption: this is a triangle mesh; otherwise, don't know how to do
-        for (int WedgeIdx = 0; 3 * WedgeIdx < Wedges.Num(); ++WedgeIdx)
-        {
-            FVector Vec1 = ActorArray[ActorIdx]->GetActorLocation() + ActorArray[ActorIdx]->GetTransform().TransformVector(Vertices[Wedges[3 * WedgeIdx + 0]]);
-            FVector Vec2 = ActorArray[ActorIdx]->GetActorLocation() + ActorArray[ActorIdx]->GetTransform().TransformVector(Vertices[Wedges[3 * WedgeIdx + 1]]);
-            FVector Vec3 = ActorArray[ActorIdx]->GetActorLocation() + ActorArray[ActorIdx]->GetTransform().TransformVector(Vertices[Wedges[3 * WedgeIdx + 2]]);
-            
-            F2DPointf Pointf1(
-                (Vec1.Y - RenderingBorderYLeft) / (RenderingBorderYRight - RenderingBorderYLeft) * OCCLUSION_VISIBILITY_RESOLUTION_WIDTH,
-                (Vec1.Z - RenderingBorderZLeft) / (RenderingBorderZRight - RenderingBorderZLeft) * OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT,
-                Vec1.X
-            ), Pointf2(
-                (Vec2.Y - RenderingBorderYLeft) / (RenderingBorderYRight - RenderingBorderYLeft) * OCCLUSION_VISIBILITY_RESOLUTION_WIDTH,
-                (Vec2.Z - RenderingBorderZLeft) / (RenderingBorderZRight - RenderingBorderZLeft) * OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT,
-                Vec2.X
-            ), Pointf3(
-                (Vec3.Y - RenderingBorderYLeft) / (RenderingBorderYRight - RenderingBorderYLeft) * OCCLUSION_VISIBILITY_RESOLUTION_WIDTH,
-                (Vec3.Z - RenderingBorderZLeft) / (RenderingBorderZRight - RenderingBorderZLeft) * OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT,
-                Vec3.X
-            );
-            TArray<F2DPoint> *RenderingPoints = TriangleRasterizer(Pointf1, Pointf2, Pointf3);
-            if (RenderingPoints->Num() > 0)
-            {
-                // Render them to the device
-                for (auto PointIt = RenderingPoints->CreateIterator(); PointIt; ++PointIt)
-                {
-                    if (PointIt->X < 0 || PointIt->X >= OCCLUSION_VISIBILITY_RESOLUTION_WIDTH ||
-                        PointIt->Y < 0 || PointIt->Y >= OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT)
-                    {
-                        continue;
-                    }
-                    RenderingDevice[PointIt->Y][PointIt->X].Add(FOcclusionPixel(ActorIdx, PointIt->Z));
-                }
-            }
-            delete RenderingPoints;
-            RenderingPoints = TriangleRasterizer(Pointf1, Pointf3, Pointf2);
-            if (RenderingPoints->Num() > 0)
-            {
-                // Render them to the device
-                for (auto PointIt = RenderingPoints->CreateIterator(); PointIt; ++PointIt)
-                {
-                    if (PointIt->X < 0 || PointIt->X >= OCCLUSION_VISIBILITY_RESOLUTION_WIDTH ||
-                        PointIt->Y < 0 || PointIt->Y >= OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT)
-                    {
-                        continue;
-                    }
-                    RenderingDevice[PointIt->Y][PointIt->X].Add(FOcclusionPixel(ActorIdx, PointIt->Z));
-                }
-            }
-            delete RenderingPoints;
-        }
+    case SP_Park:
+    {
+        // Park and shrink all the Products; placing a product takes it out of the discard pool again
+        ProductStore.Discard(ShuffleStep);
+        ProductStore.ResetOnShelf(ShuffleStep);
+        ProductStore.ShrinkScale(ShuffleStep);
+        break;
     }
-    UE_LOG(LogAutoShuffle, Log, TEXT("%d: %d: %d ends"), DateTime.Now().GetMinute(), DateTime.Now().GetSecond(), DateTime.Now().GetMillisecond());
-    // Organize the pixels: one product can only have one depth at one pixel
-    // the smallest (because we are looking from small to big) product is visible; others are not
-    int *VisiblePixelCount = new int[ActorArray.Num()]();
-    int *TotalPixelCount = new int[ActorArray.Num()]();
-    for (int y = 0; y < OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT; ++y)
+    case SP_Place:
     {
-        for (int x = 0; x < OCCLUSION_VISIBILITY_RESOLUTION_WIDTH; ++x)
+        SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_PlaceProducts);
+        // AddNoiseToShelf("BP_ShelfMain_002", 50);
+        bIsStepDone = StepPlaceProductGroup(ShuffleStep / ProductsWhitelist.Num(), ShuffleStep % ProductsWhitelist.Num(), ShuffleDensity, ShuffleProxmity);
+        break;
+    }
+    case SP_Expand:
+    {
+        // Expand all the Products, one pass over all of them after another
+        int32 ProductIdx = ShuffleStep % ProductStore.Num();
+        if (!ProductStore.IsDiscarded(ProductIdx))
         {
-            TArray<FOcclusionPixel> &PixelArray = RenderingDevice[y][x];
-            if (PixelArray.Num() == 0)
-            {
-                continue;
-            }
-            // Sort the pixel array according to depth (from small to big)
-            PixelArray.Sort(FOcclusionPixel::OrganizePixelPredicateLowToHigh);
-            VisiblePixelCount[PixelArray[0].ActorIdx] += 1;
-            TArray<int> RelatedActorIdxArray;
-            for (int PixelIdx = 0; PixelIdx < PixelArray.Num(); ++PixelIdx)
-            {
-                int RelatedActorIdx = PixelArray[PixelIdx].ActorIdx, Dummy;
-                bool ActorIdxFound = RelatedActorIdxArray.Find(RelatedActorIdx, Dummy);
-                if (ActorIdxFound == false)
-                {
-                    RelatedActorIdxArray.Add(RelatedActorIdx);
-                }
-            }
-            for (auto RelatedActorIt = RelatedActorIdxArray.CreateIterator(); RelatedActorIt; ++RelatedActorIt)
+            int32 StepsNum = ProductStore.ExpandScale(ProductIdx);
+            int32 GroupIdx = ProductGroupIndices[ProductIdx];
+            if (GroupIdx != INDEX_NONE)
             {
-                TotalPixelCount[*RelatedActorIt] += 1;
+                GroupPlacementStats[GroupIdx].QueriesNum += StepsNum;
+                GroupPlacementStats[GroupIdx].ExpansionStepsNum += StepsNum;
             }
         }
+        break;
     }
-    for (int ActorIdx = 0; ActorIdx < ActorArray.Num(); ++ActorIdx)
+    case SP_Organize:
     {
-        if ((VisiblePixelCount[ActorIdx] + 0.f) / TotalPixelCount[ActorIdx] < OcclusionThreshold)
-        {
-            ActorArray[ActorIdx]->SetActorHiddenInGame(true);
-        }
-        else
-        {
-            ActorArray[ActorIdx]->SetActorHiddenInGame(false);
-        }
+        bIsStepDone = StepOrganizeProducts();
+        break;
+    }
+    case SP_Lower:
+    {
+        LowerProducts();
+        break;
+    }
+    default:
+        break;
+    }
+    if (bIsStepDone)
+    {
+        ++ShuffleStep;
     }
-    delete[] VisiblePixelCount;
-    delete[] TotalPixelCount;
+    return true;
 }
 
-void FAutoShuffleWindowModule::BatchConvexDecomposition()
+bool FAutoShuffleWindowModule::TickShuffle(float DeltaTime)
 {
-    // Batch convex decomposition on every product
-    // Reference: https://github.com/EpicGames/UnrealEngine/blob/55c9f3ba0010e2e483d49a4cd378f36a46601fad/Engine/Source/Editor/StaticMeshEditor/Private/StaticMeshEditor.cpp#L1625
-    UE_LOG(LogAutoShuffle, Log, TEXT("Start Batch Convex Decomposition"));
-    ReadWhitelist();
-    float InAccuracy = 1.f;
-    int32 InMaxHullVerts = 32;
-    for (auto GroupIt = ProductsWhitelist->CreateIterator(); GroupIt; ++GroupIt)
+    bool bIsRunning = !bIsShuffleCancelled;
+    double StartTime = FPlatformTime::Seconds();
+    while (bIsRunning && FPlatformTime::Seconds() - StartTime < AUTO_SHUFFLE_TICK_BUDGET)
+    {
+        bIsRunning = StepShuffle();
+    }
+    if (bIsRunning)
     {
-        for (auto ProductIt = GroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
+        if (ShuffleNotification.IsValid())
         {
-            AStaticMeshActor* StaticMeshActor = Cast<AStaticMeshActor>(ProductIt->GetObjectActor());
-            if (!StaticMeshActor)
-            {
-                continue;
-            }
-            if (!StaticMeshActor->GetStaticMeshComponent())
-            {
-                continue;
-            }
-            if (!StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh())
-            {
-                continue;
-            }
-            if (!StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh()->RenderData)
-            {
-                continue;
-            }
-            FStaticMeshLODResources &LODModel = StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh()->RenderData->LODResources[0];
-            // Start a busy cursor so the user has feedback while waiting
-            const FScopedBusyCursor BusyCursor;
-            // make vertex buffer
-            int32 NumVerts = LODModel.VertexBuffer.GetNumVertices();
-            TArray<FVector> Verts;
-            for (int32 VertIdx = 0; VertIdx < NumVerts; ++VertIdx)
-            {
-                FVector Vert = LODModel.PositionVertexBuffer.VertexPosition(VertIdx);
-                Verts.Add(Vert);
-            }
-            // grab all indices
-            TArray<uint32> AllIndices;
-            LODModel.IndexBuffer.GetCopy(AllIndices);
-            // only copy indices that have collision enabled
-            TArray<uint32> CollidingIndices;
-            for (const FStaticMeshSection& Section : LODModel.Sections)
-            {
-                if (Section.bEnableCollision)
-                {
-                    for (uint32 IndexIdx = Section.FirstIndex; IndexIdx < Section.FirstIndex + (Section.NumTriangles * 3); IndexIdx++)
-                    {
-                        CollidingIndices.Add(AllIndices[IndexIdx]);
-                    }
-                }
-            }
-            // get the bodysetup we are going to put the collision into
-            UBodySetup *BodySetup = StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh()->BodySetup;
-            if (BodySetup)
-            {
-                BodySetup->RemoveSimpleCollision();
-            }
-            else
-            {
-                // otherwise, create one here.
-                StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh()->CreateBodySetup();
-                BodySetup = StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh()->BodySetup;
-            }
-            // run actual util to do the work (if we have some valid input)
-            if (Verts.Num() >= 3 && CollidingIndices.Num() > 3)
-            {
-                DecomposeMeshToHulls(BodySetup, Verts, CollidingIndices, InAccuracy, InMaxHullVerts);
-            }
-            // refresh collision change back to static mesh components
-            RefreshCollisionChange(StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh());
-            // mark mesh as dirty
-            StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh()->MarkPackageDirty();
-            // mark the static mesh for collision customization
-            StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh()->bCustomizedCollision = true;
+            ShuffleNotification->SetText(FText::FromString(TEXT("Shuffling... ") + GetShuffleProgress()));
         }
+        return true;
     }
-}
-
-void FAutoShuffleWindowModule::NonProductsVisibilityTogglingImplementation()
-{
-    auto EditorWorld = GEditor->GetEditorWorldContext().World();
-    if (bIsNonProductsVisible == true)
+    FString Message;
+    WritePhaseTimings(bIsShuffleCancelled ? TEXT("ShuffleCancelled") : TEXT("Shuffle"));
+    if (bIsShuffleCancelled)
     {
-        for (TActorIterator<AActor> ActorIt(EditorWorld); ActorIt; ++ActorIt)
-        {
-            ActorIt->SetActorHiddenInGame(false);
-        }
+        FAutoShuffleLayoutSnapshot* Snapshot = LayoutSnapshots.Find(TEXT("PreviousShuffle"));
+        int32 RestoredNum = Snapshot != nullptr ? Snapshot->Restore(ProductStore) : 0;
+        ShufflePhase = SP_Done;
+        Message = FString::Printf(TEXT("Shuffle cancelled. %d products restored"), RestoredNum);
     }
     else
     {
-        ReadWhitelist();
-        for (TActorIterator<AActor> ActorIt(EditorWorld); ActorIt; ++ActorIt)
-        {
-            ActorIt->SetActorHiddenInGame(true);
-        }
-        for (auto GroupIt = ProductsWhitelist->CreateIterator(); GroupIt; ++GroupIt)
+        int32 PlacedNum = 0;
+        for (int32 ProductIdx = 0; ProductIdx < ProductStore.Num(); ++ProductIdx)
         {
-            for (auto ProductIt = GroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
-            {
-                if (ProductIt->GetObjectActor())
-                {
-                    FVector ProductLocation = ProductIt->GetObjectActor()->GetActorLocation();
-                    if (FMath::Abs(ProductLocation.X - DiscardedProductsRegions.X) > 0.1 ||
-                        FMath::Abs(ProductLocation.Y - DiscardedProductsRegions.Y) > 0.1 ||
-                        FMath::Abs(ProductLocation.Z - DiscardedProductsRegions.Z) > 0.1)
-                    {
-                        ProductIt->GetObjectActor()->SetActorHiddenInGame(false);
-                    }
-                }
-            }
+            PlacedNum += ProductStore.IsDiscarded(ProductIdx) ? 0 : 1;
         }
+        Message = FString::Printf(TEXT("Shuffled: %d of %d products placed"), PlacedNum, ProductStore.Num());
+        WritePlacementStats();
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("%s"), *Message);
+    if (ShuffleNotification.IsValid())
+    {
+        ShuffleNotification->SetText(FText::FromString(Message));
+        ShuffleNotification->SetCompletionState(bIsShuffleCancelled ? SNotificationItem::CS_Fail : SNotificationItem::CS_Success);
+        ShuffleNotification->ExpireAndFadeout();
+        ShuffleNotification.Reset();
     }
+    ShuffleTickerHandle.Reset();
+    return false;
 }
 
-void FAutoShuffleWindowModule::ExportMappingBetweenActorIdAndDisplayName()
+void FAutoShuffleWindowModule::CancelShuffle()
+{
+    bIsShuffleCancelled = true;
+}
+
+FString FAutoShuffleWindowModule::GetShuffleProgress()
 {
-    FString MappingFileDir = FPaths::Combine(*FPaths::GameDir(), *FString("Data"), *FString("ActorNameMapping.csv"));
-    auto EditorWorld = GEditor->GetEditorWorldContext().World();
-    FString FileContent = "";
-    for (TActorIterator<AActor> ActorIt(EditorWorld); ActorIt; ++ActorIt)
+    TArray<FString> Progress;
+    for (int32 Phase = 0; Phase < SP_Done; ++Phase)
     {
-        FString ActorID = ActorIt->GetName(), ActorLabel = ActorIt->GetActorLabel();
-        FileContent = FileContent + FString::Printf(TEXT("%s,%s\n"), *ActorID, *ActorLabel);
+        int32 DoneNum = Phase < ShufflePhase ? ShuffleStepsNum[Phase] : Phase == ShufflePhase ? ShuffleStep : 0;
+        int32 Percent = ShuffleStepsNum[Phase] > 0 ? 100 * DoneNum / ShuffleStepsNum[Phase] : 100;
+        Progress.Add(FString::Printf(TEXT("%s %d%%"), GetShufflePhaseName(EShufflePhase(Phase)), Percent));
     }
-    FFileHelper::SaveStringToFile(FileContent, *MappingFileDir);
+    return FString::Join(Progress, TEXT(" | "));
 }
 
-bool FAutoShuffleWindowModule::ReadWhitelist()
+const TCHAR* FAutoShuffleWindowModule::GetShufflePhaseName(EShufflePhase Phase)
 {
-    // Always read the list even if the whitelists have been initialized
-    // This is to make sure that changes of the configurations can be directly reflected every time the button is clicked
-    if (FAutoShuffleWindowModule::ShelvesWhitelist != nullptr)
+    static const TCHAR* PhaseNames[SP_Done] = { TEXT("Park"), TEXT("Place"), TEXT("Expand"), TEXT("Organize"), TEXT("Lower") };
+    return Phase < SP_Done ? PhaseNames[Phase] : TEXT("Done");
+}
+
+void FAutoShuffleWindowModule::WritePhaseTimings(const FString& RunName)
+{
+    UE_LOG(LogAutoShuffle, Log, TEXT("%s took %.1f ms: %s"), *RunName, RunTimings.GetTotalSeconds() * 1000.0, *RunTimings.ToString());
+    FString FileDir = GetPhaseTimingsFileDir();
+    if (!RunTimings.AppendToFile(FileDir, RunName))
     {
-        delete FAutoShuffleWindowModule::ShelvesWhitelist;
-        FAutoShuffleWindowModule::ShelvesWhitelist = nullptr;
+        UE_LOG(LogAutoShuffle, Warning, TEXT("The phase timings could not be written to %s"), *FileDir);
     }
-    if (FAutoShuffleWindowModule::ProductsWhitelist != nullptr)
+    RunTimings.Reset();
+}
+
+void FAutoShuffleWindowModule::QueryOverlappingActors(AActor* Actor, TArray<AActor*>& OutOverlappingActors, FAutoShufflePlacementStats& Stats)
+{
+    ++Stats.QueriesNum;
+    Actor->GetOverlappingActors(OutOverlappingActors);
+}
+
+void FAutoShuffleWindowModule::QueryOverlappingProducts(int32 ProductIdx, TArray<AActor*>& OutOverlappingActors, FAutoShufflePlacementStats& Stats)
+{
+    ++Stats.QueriesNum;
+    ProductStore.GetOverlappingActors(ProductIdx, OutOverlappingActors);
+}
+
+void FAutoShuffleWindowModule::ResetPlacementStats()
+{
+    GroupPlacementStats.Reset();
+    GroupPlacementStats.SetNum(ProductsWhitelist.Num());
+    ShelfPlacementStats.Reset();
+    ShelfPlacementStats.SetNum(ShelvesWhitelist.Num());
+    // the expansion runs per product, so it needs the group of each product
+    ProductGroupIndices.Init(INDEX_NONE, ProductStore.Num());
+    for (int32 GroupIdx = 0; GroupIdx < ProductsWhitelist.Num(); ++GroupIdx)
     {
-        delete FAutoShuffleWindowModule::ProductsWhitelist;
-        FAutoShuffleWindowModule::ProductsWhitelist = nullptr;
+        for (int32 ProductIdx = ProductsWhitelist[GroupIdx].GetFirstMember(); ProductIdx < ProductsWhitelist[GroupIdx].GetMembersEnd(); ++ProductIdx)
+        {
+            ProductGroupIndices[ProductIdx] = GroupIdx;
+        }
     }
-    auto EditorWorld = GEditor->GetEditorWorldContext().World();
-    // NOTE: EditorWorld must do InitializeActorsForPlay to make overlapping detection work
-    if (!EditorWorld->AreActorsInitialized())
+}
+
+void FAutoShuffleWindowModule::ResetShelfCapacities()
+{
+    // the products stand in a strip along the shelf, clear of its two ends, as deep as the shelf
+    ShelfLevelFreeAreas.Reset();
+    ShelfLevelFreeAreas.SetNum(ShelvesWhitelist.Num());
+    ShelfLevelFailedFootprints.Reset();
+    ShelfLevelFailedFootprints.SetNum(ShelvesWhitelist.Num());
+    ShelfLevelFailureEpochs.Reset();
+    ShelfLevelFailureEpochs.SetNum(ShelvesWhitelist.Num());
+    ShelfFreeSpaceEpochs.Init(0, ShelvesWhitelist.Num());
+    // the products are parked and shrunk before the first group is placed, so their footprints are summed then
+    ShelfPendingFootprints.Init(-1.f, ShelvesWhitelist.Num());
+    for (int32 ShelfIdx = 0; ShelfIdx < ShelvesWhitelist.Num(); ++ShelfIdx)
     {
-        FURL URL;
-        EditorWorld->InitializeActorsForPlay(URL);
+        FVector ShelfOrigin, ShelfExtent;
+        ShelvesWhitelist[ShelfIdx].GetObjectActor()->GetActorBounds(false, ShelfOrigin, ShelfExtent);
+        float LevelArea = FMath::Max(ShelfExtent.Y * 2.f - AUTO_SHUFFLE_Y_TWO_END_OFFSET * 2.f, 0.f) * ShelfExtent.X * 2.f;
+        int32 LevelsNum = ShelvesWhitelist[ShelfIdx].GetLevelsNum();
+        ShelfLevelFreeAreas[ShelfIdx].Init(LevelArea, LevelsNum);
+        ShelfLevelFailedFootprints[ShelfIdx].Init(FVector2D(0.f, 0.f), LevelsNum);
+        ShelfLevelFailureEpochs[ShelfIdx].Init(INDEX_NONE, LevelsNum);
     }
-    FString PluginDir = FPaths::Combine(*FPaths::GamePluginsDir(), TEXT("AutoShuffleWindow"));
-    FString ResourseDir = FPaths::Combine(*PluginDir, TEXT("Resources"));
-    FString FileDir = FPaths::Combine(*ResourseDir, TEXT("Whitelist.json"));
-    FString Filedata = "";
-    FFileHelper::LoadFileToString(Filedata, *FileDir);
-    TSharedPtr<FJsonObject> WhitelistJson = FAutoShuffleWindowModule::ParseJSON(Filedata, TEXT("Whitelist"), false);
-    
-    // Start reading JsonObject "Whitelist"
+}
+
+float FAutoShuffleWindowModule::GetPendingFootprints(int32 ShelfIdx, int32 FirstGroupIdx)
+{
+    float FootprintsSum = 0.f;
+    for (int32 GroupIdx = FirstGroupIdx; GroupIdx < ProductsWhitelist.Num(); ++GroupIdx)
     {
-        if (!WhitelistJson.IsValid())
+        FAutoShuffleProductGroup& Group = ProductsWhitelist[GroupIdx];
+        if (Group.GetShelfName() != ShelvesWhitelist[ShelfIdx].GetName() || Group.IsDiscarded())
         {
-            UE_LOG(LogAutoShuffle, Warning, TEXT("Nothing to shuffle. Module quites."));
-            return false;
-        }
-        if (WhitelistJson->HasField("Whitelist"))
-        {
-            UE_LOG(LogAutoShuffle, Log, TEXT("Reading Whitelist..."));
+            continue;
         }
-        else
+        for (int32 ProductIdx = Group.GetFirstMember(); ProductIdx < Group.GetMembersEnd(); ++ProductIdx)
         {
-            UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist reading failed. Module quites."));
-            return false;
+            FVector ProductOrigin, ProductExtent;
+            ProductStore.GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+            FootprintsSum += ProductExtent.X * ProductExtent.Y * 4.f;
         }
     }
-    TSharedPtr<FJsonObject> WhitelistObjectJson = WhitelistJson->GetObjectField("Whitelist");
-    
-    // Start reading JsonArray "Shelves"
-    if (WhitelistObjectJson->HasField("Shelves"))
+    return FootprintsSum;
+}
+
+void FAutoShuffleWindowModule::InvalidateFailedFootprints()
+{
+    for (auto EpochIt = ShelfFreeSpaceEpochs.CreateIterator(); EpochIt; ++EpochIt)
     {
-        UE_LOG(LogAutoShuffle, Log, TEXT("Reading Shelves..."));
+        ++(*EpochIt);
     }
-    else
+}
+
+bool FAutoShuffleWindowModule::IsFootprintKnownToFail(int32 ShelfIdx, int32 LevelIdx, const FVector2D& FootprintExtent)
+{
+    if (ShelfLevelFailureEpochs[ShelfIdx][LevelIdx] != ShelfFreeSpaceEpochs[ShelfIdx])
     {
-        UE_LOG(LogAutoShuffle, Warning, TEXT("Shelves reading failed. Module quits."));
         return false;
     }
-    TArray<TSharedPtr<FJsonValue>> ShelvesArrayJson = WhitelistObjectJson->GetArrayField("Shelves");
-    FAutoShuffleWindowModule::ShelvesWhitelist = new TArray<FAutoShuffleShelf>();
-    for (auto JsonValueIt = ShelvesArrayJson.CreateIterator(); JsonValueIt; ++JsonValueIt)
+    // no bigger footprint in either direction fits where a smaller one did not
+    const FVector2D& FailedExtent = ShelfLevelFailedFootprints[ShelfIdx][LevelIdx];
+    return FootprintExtent.X >= FailedExtent.X && FootprintExtent.Y >= FailedExtent.Y;
+}
+
+void FAutoShuffleWindowModule::RecordFailedFootprint(int32 ShelfIdx, const TArray<int32>& LevelTriesNum, const FVector2D& FootprintExtent)
+{
+    for (int32 LevelIdx = 0; LevelIdx < LevelTriesNum.Num(); ++LevelIdx)
     {
-        TSharedPtr<FJsonObject> ShelfObjectJson = (*JsonValueIt)->AsObject();
-        FString NewName = ShelfObjectJson->GetStringField("Name");
-        AActor* NewObjectActor = nullptr;
-        for (TActorIterator<AActor> ActorIt(EditorWorld); ActorIt; ++ActorIt)
-        {
-            if (ActorIt->GetActorLabel() == NewName)
-            {
-                NewObjectActor = *ActorIt;
-#ifdef VERBOSE_AUTO_SHUFFLE
-                UE_LOG(LogAutoShuffle, Log, TEXT("Found %s for %s"), *NewObjectActor->GetActorLabel(), *NewName);
-#endif
-                break;
-            }
-        }
-        if (NewObjectActor == nullptr)
+        // a level tried only a few times may still have had a gap
+        if (LevelTriesNum[LevelIdx] < AUTO_SHUFFLE_FAILURE_MEMO_MIN_TRIES)
         {
-#ifdef VERBOSE_AUTO_SHUFFLE
-            UE_LOG(LogAutoShuffle, Log, TEXT("Found 0 object for %s"), *NewName);
-#endif
             continue;
         }
-        float NewScale = ShelfObjectJson->GetNumberField("Scale");
-        TArray<float>* NewShelfBase = new TArray<float>();
-        TArray<TSharedPtr<FJsonValue>> Shelfbase = ShelfObjectJson->GetArrayField("Shelfbase");
-        for (auto BaseValueIt = Shelfbase.CreateIterator(); BaseValueIt; ++BaseValueIt)
-        {
-            NewShelfBase->Add((*BaseValueIt)->AsNumber());
-        }
-        TArray<float>* NewShelfOffset = new TArray<float>();
-        TArray<TSharedPtr<FJsonValue>> Shelfoffset = ShelfObjectJson->GetArrayField("Shelfoffset");
-        for (auto OffsetValueIt = Shelfoffset.CreateIterator(); OffsetValueIt; ++OffsetValueIt)
+        FVector2D& FailedExtent = ShelfLevelFailedFootprints[ShelfIdx][LevelIdx];
+        int32& FailureEpoch = ShelfLevelFailureEpochs[ShelfIdx][LevelIdx];
+        // a failure from before the space last freed up tells nothing any more; otherwise the smaller footprint is kept
+        if (FailureEpoch != ShelfFreeSpaceEpochs[ShelfIdx] || FootprintExtent.X * FootprintExtent.Y < FailedExtent.X * FailedExtent.Y)
         {
-            NewShelfOffset->Add((*OffsetValueIt)->AsNumber());
+            FailedExtent = FootprintExtent;
+            FailureEpoch = ShelfFreeSpaceEpochs[ShelfIdx];
         }
-        FVector NewPosition = NewObjectActor->GetActorLocation();
-        ShelvesWhitelist->Add(FAutoShuffleShelf());
-        ShelvesWhitelist->Top().SetShelfBase(NewShelfBase);
-        ShelvesWhitelist->Top().SetShelfOffset(NewShelfOffset);
-        ShelvesWhitelist->Top().SetName(NewName);
-        ShelvesWhitelist->Top().SetObjectActor(NewObjectActor);
-        ShelvesWhitelist->Top().SetPosition(NewPosition);
-        ShelvesWhitelist->Top().SetScale(NewScale);
     }
-    
-#ifdef VERBOSE_AUTO_SHUFFLE
-    for (auto ShelfIt = ShelvesWhitelist->CreateIterator(); ShelfIt; ++ShelfIt)
+}
+
+void FAutoShuffleWindowModule::WritePlacementStats()
+{
+    // a shelf sums up its groups, plus the queries of organizing it
+    TArray<FAutoShufflePlacementStats> ShelfTotals = ShelfPlacementStats;
+    TArray<int32> GroupShelfIndices;
+    GroupShelfIndices.Init(INDEX_NONE, ProductsWhitelist.Num());
+    for (int32 GroupIdx = 0; GroupIdx < ProductsWhitelist.Num(); ++GroupIdx)
     {
-        UE_LOG(LogAutoShuffle, Log, TEXT("Shelf: %s in Scale: %f"), *(ShelfIt->GetName()), ShelfIt->GetScale());
-        for (auto BaseIt = ShelfIt->GetShelfBase()->CreateIterator(); BaseIt; ++BaseIt)
+        FAutoShufflePlacementStats& GroupStats = GroupPlacementStats[GroupIdx];
+        const FAutoShuffleProductGroup& Group = ProductsWhitelist[GroupIdx];
+        GroupStats.ProductsNum = Group.GetMembersEnd() - Group.GetFirstMember();
+        GroupStats.PlacedNum = 0;
+        for (int32 ProductIdx = Group.GetFirstMember(); ProductIdx < Group.GetMembersEnd(); ++ProductIdx)
+        {
+            GroupStats.PlacedNum += ProductStore.IsDiscarded(ProductIdx) ? 0 : 1;
+        }
+        for (int32 ShelfIdx = 0; ShelfIdx < ShelvesWhitelist.Num(); ++ShelfIdx)
         {
-            UE_LOG(LogAutoShuffle, Log, TEXT("Shelfbase: %f"), *BaseIt);
+            if (ShelvesWhitelist[ShelfIdx].GetName() == Group.GetShelfName())
+            {
+                GroupShelfIndices[GroupIdx] = ShelfIdx;
+                ShelfTotals[ShelfIdx] += GroupStats;
+                break;
+            }
         }
     }
-#endif
-    
-    // Start reading JsonArray "Products"
-    if (WhitelistObjectJson->HasField("Products"))
+    FString FileDir = GetPlacementStatsFileDir();
+    bool bIsNewFile = !IFileManager::Get().FileExists(*FileDir);
+    TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*FileDir, FILEWRITE_Append));
+    if (!FileWriter.IsValid())
     {
-        UE_LOG(LogAutoShuffle, Log, TEXT("Reading Products..."));
+        UE_LOG(LogAutoShuffle, Warning, TEXT("The placement stats could not be written to %s"), *FileDir);
     }
-    else
+    FAutoShuffleExportBuffer Buffer(FileWriter.Get());
+    if (FileWriter.IsValid() && bIsNewFile)
     {
-        UE_LOG(LogAutoShuffle, Warning, TEXT("Products reading failed. Module quits."));
-        return false;
+        Buffer.AppendText(TEXT("Date,Shelf,Group,") + FAutoShufflePlacementStats::GetCsvHeader() + TEXT("\n"));
     }
-    TArray<TSharedPtr<FJsonValue>> ProductsArrayJson = WhitelistObjectJson->GetArrayField("Products");
-    FAutoShuffleWindowModule::ProductsWhitelist = new TArray<FAutoShuffleProductGroup>();
-    for (auto JsonValueIt = ProductsArrayJson.CreateIterator(); JsonValueIt; ++JsonValueIt)
+    FString Date = FDateTime::Now().ToString();
+    FString Summary;
+    for (int32 ShelfIdx = 0; ShelfIdx < ShelvesWhitelist.Num(); ++ShelfIdx)
     {
-        TSharedPtr<FJsonObject> ProductObjectJson = (*JsonValueIt)->AsObject();
-        FString NewGroupName = ProductObjectJson->GetStringField("GroupName");
-        FString NewShelfName = ProductObjectJson->GetStringField("ShelfName");
-        bool bProductsDiscarded = ProductObjectJson->GetBoolField("Discard");
-        TArray<FAutoShuffleObject>* NewMembers = new TArray<FAutoShuffleObject>();
-        TArray<TSharedPtr<FJsonValue>> Members = ProductObjectJson->GetArrayField("Members");
-        for (auto MemberValueIt = Members.CreateIterator(); MemberValueIt; ++MemberValueIt)
+        FString ShelfName = ShelvesWhitelist[ShelfIdx].GetName();
+        UE_LOG(LogAutoShuffle, Log, TEXT("Shelf %s: %s"), *ShelfName, *ShelfTotals[ShelfIdx].ToString());
+        Summary += FString::Printf(TEXT("%s: %s\n"), *ShelfName, *ShelfTotals[ShelfIdx].ToString());
+        if (FileWriter.IsValid())
         {
-            TSharedPtr<FJsonObject> ProductMember = (*MemberValueIt)->AsObject();
-            FString NewName = ProductMember->GetStringField("Name");
-            AActor* NewObjectActor = nullptr;
-            for (TActorIterator<AActor> ActorIt(EditorWorld); ActorIt; ++ActorIt)
-            {
-                if (ActorIt->GetActorLabel() == NewName)
-                {
-                    NewObjectActor = *ActorIt;
-#ifdef VERBOSE_AUTO_SHUFFLE
-                    UE_LOG(LogAutoShuffle, Log, TEXT("Found %s for %s"), *ActorIt->GetActorLabel(), *NewName);
-#endif
-                    break;
-                }
-            }
-            if (NewObjectActor == nullptr)
+            Buffer.AppendText(FString::Printf(TEXT("%s,%s,,%s\n"), *Date, *EscapeCsvField(ShelfName), *ShelfTotals[ShelfIdx].ToCsvRow()));
+        }
+        for (int32 GroupIdx = 0; GroupIdx < ProductsWhitelist.Num(); ++GroupIdx)
+        {
+            if (GroupShelfIndices[GroupIdx] != ShelfIdx)
             {
-#ifdef VERBOSE_AUTO_SHUFFLE
-                UE_LOG(LogAutoShuffle, Log, TEXT("Found 0 Object for %s"), *NewName);
-#endif
                 continue;
             }
-            float NewScale = ProductMember->GetNumberField("Scale");
-            NewMembers->Add(FAutoShuffleObject());
-            NewMembers->Top().SetName(NewName);
-            NewMembers->Top().SetObjectActor(NewObjectActor);
-            NewMembers->Top().SetScale(NewScale);
-            if (bProductsDiscarded)
+            FString GroupName = ProductsWhitelist[GroupIdx].GetName();
+            UE_LOG(LogAutoShuffle, Log, TEXT("    Group %s: %s"), *GroupName, *GroupPlacementStats[GroupIdx].ToString());
+            Summary += FString::Printf(TEXT("    %s: %s\n"), *GroupName, *GroupPlacementStats[GroupIdx].ToString());
+            if (FileWriter.IsValid())
             {
-                NewMembers->Top().SetPosition(DiscardedProductsRegions);
+                Buffer.AppendText(FString::Printf(TEXT("%s,%s,%s,%s\n"), *Date, *EscapeCsvField(ShelfName), *EscapeCsvField(GroupName), *GroupPlacementStats[GroupIdx].ToCsvRow()));
             }
         }
-        ProductsWhitelist->Add(FAutoShuffleProductGroup());
-        ProductsWhitelist->Top().SetName(NewGroupName);
-        ProductsWhitelist->Top().SetMembers(NewMembers);
-        ProductsWhitelist->Top().SetShelfName(NewShelfName);
-        if (bProductsDiscarded)
-        {
-            ProductsWhitelist->Top().Discard();
-        }
     }
-    
-#ifdef VERBOSE_AUTO_SHUFFLE
-    for (auto GroupIt = ProductsWhitelist->CreateIterator(); GroupIt; ++GroupIt)
+    if (FileWriter.IsValid())
     {
-        UE_LOG(LogAutoShuffle, Log, TEXT("Product Group: %s"), *(GroupIt->GetName()));
-        for (auto ProductIt = GroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
-        {
-            UE_LOG(LogAutoShuffle, Log, TEXT("Product Name: %s in Scale: %f"), *(ProductIt->GetName()), ProductIt->GetScale());
-        }
+        Buffer.Flush();
+        FileWriter->Close();
+    }
+    // the window may never have been opened, e.g. in the commandlet
+    if (PlacementStatsTextBlock.IsValid())
+    {
+        PlacementStatsTextBlock->SetText(FText::FromString(Summary.TrimTrailing()));
     }
-#endif
-    
-    UE_LOG(LogAutoShuffle, Log, TEXT("Collected %d Shelves and %d Products Group"), ShelvesArrayJson.Num(), ProductsArrayJson.Num());
-    
-    return true;
 }
 
-void FAutoShuffleWindowModule::AddNoiseToShelf(const FString& ShelfName, float NoiseScale)
+FString FAutoShuffleWindowModule::GetPlacementStatsFileDir()
 {
-    // Get the first shelf's name and its presumably fixed Position.Z
-    if (FAutoShuffleWindowModule::ShelvesWhitelist->Num() < 1)
-    {
-        UE_LOG(LogAutoShuffle, Warning, TEXT("No shelves loaded."));
-        return;
-    }
-    FAutoShuffleShelf& FirstShelf = FAutoShuffleWindowModule::ShelvesWhitelist->operator[](0);
-    FString Name = FirstShelf.GetName();
-    FVector RefPosition = FirstShelf.GetPosition();
-    if (Name == ShelfName)
+    return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("AutoShuffle"), TEXT("PlacementStats.csv"));
+}
+
+FString FAutoShuffleWindowModule::GetPhaseTimingsFileDir()
+{
+    return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("AutoShuffle"), TEXT("PhaseTimings.csv"));
+}
+
+void FAutoShuffleWindowModule::ComputeOcclusionVisibility()
+{
+    ComputeOcclusionVisibilityWithSettings(GetWindowSettings());
+}
+
+void FAutoShuffleWindowModule::ComputeOcclusionVisibilityWithSettings(const FAutoShuffleSettings& Settings)
+{
+    UE_LOG(LogAutoShuffle, Log, TEXT("Set Occlusion Visibility"));
+    float OcclusionThreshold = Settings.OcclusionThreshold;
+    // find the boundary of the shelves
+    // pre-assumptions: looking from small x to big x, and within 1e10 scale
+    float RenderingBorderXLeft = 1e10f, RenderingBorderXRight = -1e10f,
+        RenderingBorderYLeft = 1e10f, RenderingBorderYRight = -1e10f,
+        RenderingBorderZLeft = 1e10f, RenderingBorderZRight = -1e10f;
+    for (auto ShelfIt = ShelvesWhitelist.CreateIterator(); ShelfIt; ++ShelfIt)
     {
-        UE_LOG(LogAutoShuffle, Warning, TEXT("Shelf %s is fixed."), *Name);
-        return;
+        FVector ShelfOrigin, ShelfExtent;
+        ShelfIt->GetObjectActor()->GetActorBounds(false, ShelfOrigin, ShelfExtent);
+        RenderingBorderXLeft = FMath::Min(RenderingBorderXLeft, ShelfOrigin.X - ShelfExtent.X);
+        RenderingBorderXRight = FMath::Max(RenderingBorderXRight, ShelfOrigin.X + ShelfExtent.X);
+        RenderingBorderYLeft = FMath::Min(RenderingBorderYLeft, ShelfOrigin.Y - ShelfExtent.Y);
+        RenderingBorderYRight = FMath::Max(RenderingBorderYRight, ShelfOrigin.Y + ShelfExtent.Y);
+        RenderingBorderZLeft = FMath::Min(RenderingBorderZLeft, ShelfOrigin.Z - ShelfExtent.Z);
+        RenderingBorderZRight = FMath::Max(RenderingBorderZRight, ShelfOrigin.Z + ShelfExtent.Z);
     }
-    FAutoShuffleShelf* ShelfToChange = nullptr;
-    for (auto ShelfIt = ShelvesWhitelist->CreateIterator(); ShelfIt; ++ShelfIt)
+    UE_LOG(LogAutoShuffle, Log, TEXT("Valid Boundary: %f, %f, %f, %f, %f, %f"), RenderingBorderXLeft, RenderingBorderXRight, RenderingBorderYLeft, RenderingBorderYRight, RenderingBorderZLeft, RenderingBorderZRight);
+    FBox RenderingBorder(FVector(RenderingBorderXLeft, RenderingBorderYLeft, RenderingBorderZLeft), FVector(RenderingBorderXRight, RenderingBorderYRight, RenderingBorderZRight));
+    // gather all the valid static mesh actors
+    TArray<AStaticMeshActor*> ActorArray;
+    TArray<int32> ActorProductIdxArray;
+    for (int32 ProductIdx = 0; ProductIdx < ProductStore.Num(); ++ProductIdx)
     {
-        if (ShelfIt->GetName() == ShelfName)
+        // the ratios of an earlier layout must not leak into this one
+        ProductStore.SetOcclusionRatio(ProductIdx, -1.f);
+        // see if the product is within the border by testing the product center
+        FVector ProductOrigin, ProductExtent;
+        AActor* ProductActor = ProductStore.GetObjectActor(ProductIdx);
+        // parked products neither occlude nor get a ratio, and they stay hidden
+        if (!ProductActor || ProductStore.IsDiscarded(ProductIdx))
         {
-            ShelfToChange = &*ShelfIt;
-            break;
+            continue;
         }
-    }
-    if (ShelfToChange == nullptr)
-    {
-        UE_LOG(LogAutoShuffle, Warning, TEXT("No shelf matches the name %s"), *ShelfName);
-        return;
-    }
-    FVector NewPosition = ShelfToChange->GetPosition();
-    NewPosition.Z = RefPosition.Z - NoiseScale * (float(FMath::Rand()) / RAND_MAX);
-    ShelfToChange->SetPosition(NewPosition);
-}
-
-TSharedPtr<FJsonObject> FAutoShuffleWindowModule::ParseJSON(const FString& FileContents, const FString& NameForErrors, bool bSilent)
-{
-    // Parsing source code from:
-    // https://github.com/EpicGames/UnrealEngine/blob/master/Engine/Plugins/2D/Paper2D/Source/PaperSpriteSheetImporter/Private/PaperJsonSpriteSheetImporter.cpp
-    if (!FileContents.IsEmpty())
-    {
-        const TSharedRef<TJsonReader<>>& Reader = TJsonReaderFactory<>::Create(FileContents);
-        TSharedPtr<FJsonObject> SpriteDescriptorObject;
-        if (FJsonSerializer::Deserialize(Reader, SpriteDescriptorObject) && SpriteDescriptorObject.IsValid())
+        AStaticMeshActor* StaticMeshActor = Cast<AStaticMeshActor>(ProductActor);
+        ProductActor->GetActorBounds(false, ProductOrigin, ProductExtent);
+        if (ProductOrigin.X > RenderingBorderXRight || ProductOrigin.X < RenderingBorderXLeft ||
+            ProductOrigin.Y > RenderingBorderYRight || ProductOrigin.Y < RenderingBorderYLeft ||
+            /** ProductOrigin.Z > RenderingBorderZRight || */ ProductOrigin.Z < RenderingBorderZLeft)
         {
-            // File was loaded and deserialized OK!
-            return SpriteDescriptorObject;
+            continue;
         }
-        else
+        if (StaticMeshActor)
         {
-            if (!bSilent)
-            {
-                UE_LOG(LogAutoShuffle, Warning, TEXT("Faled to parse sprite descriptor file '%s'. Error: '%s'"), *NameForErrors, *Reader->GetErrorMessage());
-            }
-            return nullptr;
+            ActorArray.Add(StaticMeshActor);
+            ActorProductIdxArray.Add(ProductIdx);
         }
     }
-    else
+    UE_LOG(LogAutoShuffle, Log, TEXT("Start rendering %d static meshes"), ActorArray.Num());
+    double StartTime = FPlatformTime::Seconds();
+    TArray<int32> VisiblePixelCount, TotalPixelCount;
+    int32 TrianglesNum = RenderOcclusion(ActorArray, RenderingBorder, true, VisiblePixelCount, TotalPixelCount);
+    UE_LOG(LogAutoShuffle, Log, TEXT("Rendered %d proxy triangles in %.1f ms"), TrianglesNum, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+    if (Settings.bIsProxyErrorReported)
     {
-        if (!bSilent)
+        // render again in full detail and compare the occlusion ratios of the products visible in both
+        StartTime = FPlatformTime::Seconds();
+        TArray<int32> FullVisiblePixelCount, FullTotalPixelCount;
+        int32 FullTrianglesNum = RenderOcclusion(ActorArray, RenderingBorder, false, FullVisiblePixelCount, FullTotalPixelCount);
+        float MeanError = 0.f, MaxError = 0.f;
+        int32 ComparedNum = 0;
+        for (int ActorIdx = 0; ActorIdx < ActorArray.Num(); ++ActorIdx)
         {
-            UE_LOG(LogAutoShuffle, Warning, TEXT("Sprite descriptor file '%s' was empty. This sprite cannot be imported."), *NameForErrors);
+            if (TotalPixelCount[ActorIdx] == 0 || FullTotalPixelCount[ActorIdx] == 0)
+            {
+                continue;
+            }
+            float Error = FMath::Abs((VisiblePixelCount[ActorIdx] + 0.f) / TotalPixelCount[ActorIdx] - (FullVisiblePixelCount[ActorIdx] + 0.f) / FullTotalPixelCount[ActorIdx]);
+            MeanError += Error;
+            MaxError = FMath::Max(MaxError, Error);
+            ++ComparedNum;
         }
-        return nullptr;
+        MeanError = ComparedNum > 0 ? MeanError / ComparedNum : 0.f;
+        UE_LOG(LogAutoShuffle, Log, TEXT("Full detail: %d triangles (%.1fx the proxies) in %.1f ms. Occlusion ratio error of the proxies over %d products: mean %f, max %f"),
+            FullTrianglesNum, (FullTrianglesNum + 0.f) / FMath::Max(TrianglesNum, 1), (FPlatformTime::Seconds() - StartTime) * 1000.0, ComparedNum, MeanError, MaxError);
     }
-}
-
-void FAutoShuffleWindowModule::PlaceProducts(float Density, float Proxmity)
-{
-    /** Placing the products to the shelf
-     * @param Density: How many products are considerd 0 ~ 1 multiplied by all the stuffs
-     * @param Proxmity: How close the items in the same group are placed 0: one on another 1: randomly placed
-     * @note density and proxmity are w.r.t. one shelf.
-     * @note The shelf must be aligned with x, y, and z, and y is the longest side of the shelf
-     * @todo Consider two-side placing and product-shelf associations
-     */
-    
-    // iterate through shelves
-    for (auto ShelfIt = FAutoShuffleWindowModule::ShelvesWhitelist->CreateIterator(); ShelfIt; ++ShelfIt)
+    for (int ActorIdx = 0; ActorIdx < ActorArray.Num(); ++ActorIdx)
     {
-        // find the bounding box of the shelf and the longest between x and y as the places for products to enter from
-        FVector BoundingBoxOrigin, BoundingBoxExtent;
-        ShelfIt->GetObjectActor()->GetActorBounds(false, BoundingBoxOrigin, BoundingBoxExtent);
-#ifdef VERBOSE_AUTO_SHUFFLE
-        UE_LOG(LogAutoShuffle, Log, TEXT("Shelf %s has bounding box %s, %s"), *ShelfIt->GetName(), *BoundingBoxOrigin.ToString(), *BoundingBoxExtent.ToString());
-#endif
-        // find the Z-values of shelf bases
-        TArray<float> ShelfBaseZ;
-        for (auto ShelfBaseIt = ShelfIt->GetShelfBase()->CreateIterator(); ShelfBaseIt; ++ShelfBaseIt)
+        // kept for the dataset manifest; products that cover no pixel stay unknown
+        if (TotalPixelCount[ActorIdx] > 0)
         {
-            ShelfBaseZ.Add(*ShelfBaseIt * BoundingBoxExtent.Z * 2.f + BoundingBoxOrigin.Z - BoundingBoxExtent.Z);
+            ProductStore.SetOcclusionRatio(ActorProductIdxArray[ActorIdx], 1.f - (VisiblePixelCount[ActorIdx] + 0.f) / TotalPixelCount[ActorIdx]);
         }
-        // find the Z offset of shelf bases
-        TArray<float> ShelfOffsetZ;
-        for (auto ShelfOffsetIt = ShelfIt->GetShelfOffset()->CreateIterator(); ShelfOffsetIt; ++ShelfOffsetIt)
+        if ((VisiblePixelCount[ActorIdx] + 0.f) / TotalPixelCount[ActorIdx] < OcclusionThreshold)
         {
-            ShelfOffsetZ.Add(*ShelfOffsetIt * BoundingBoxExtent.Z * 2.f);
+            ActorArray[ActorIdx]->SetActorHiddenInGame(true);
         }
-#ifdef VERBOSE_AUTO_SHUFFLE
-        for (auto ShelfBaseIt = ShelfBaseZ.CreateIterator(); ShelfBaseIt; ++ShelfBaseIt)
+        else
         {
-            UE_LOG(LogAutoShuffle, Log, TEXT("The real Z values of shelf %s: %f"), *ShelfIt->GetName(), *ShelfBaseIt);
+            ActorArray[ActorIdx]->SetActorHiddenInGame(false);
         }
-#endif
-        // iterate through all the product groups
-        for (auto ProductGroupIt = ProductsWhitelist->CreateIterator(); ProductGroupIt; ++ProductGroupIt)
-        {
-            // check if the name of the shelf that this group belongs to match the current shelf name
-            if (ProductGroupIt->GetShelfName() != ShelfIt->GetName())
-            {
-                continue;
-            }
-            // check if the whole group of products have been discarded in whitelist
-            if (ProductGroupIt->IsDiscarded())
+    }
+    WritePhaseTimings(TEXT("OcclusionVisibility"));
+}
+
+int32 FAutoShuffleWindowModule::RenderOcclusion(const TArray<AStaticMeshActor*>& ActorArray, const FBox& RenderingBorder, bool bUseProxies, TArray<int32>& OutVisiblePixelCount, TArray<int32>& OutTotalPixelCount)
+{
+    int32 TrianglesNum = RasterizeOcclusion(ActorArray, RenderingBorder, bUseProxies);
+    CountOcclusionPixels(ActorArray.Num(), bUseProxies, OutVisiblePixelCount, OutTotalPixelCount);
+    return TrianglesNum;
+}
+
+int32 FAutoShuffleWindowModule::RasterizeOcclusion(const TArray<AStaticMeshActor*>& ActorArray, const FBox& RenderingBorder, bool bUseProxies)
+{
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_RasterizeOcclusion);
+    FAutoShufflePhaseScope PhaseScope(RunTimings, bUseProxies ? TEXT("Rasterize") : TEXT("RasterizeFullDetail"));
+    // clean the occlusion visibility rendering device
+    for (int y = 0; y < OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT; ++y)
+    {
+        for (int x = 0; x < OCCLUSION_VISIBILITY_RESOLUTION_WIDTH; ++x)
+        {
+            RenderingDevice[y][x].Empty();
+        }
+    }
+    // Get all the meshes and draw them on the rendering device
+    // Reference: https://forums.unrealengine.com/showthread.php?8856-Accessing-Vertex-Positions-of-static-mesh
+    // Reference: https://answers.unrealengine.com/questions/465376/access-to-mesh-data-in-object-via-c.html
+    // The geometry of a mesh is loaded once per render and shared by all of its instances
+    TMap<UStaticMesh*, FAutoShuffleOcclusionMesh> OcclusionMeshes;
+    TArray<F2DPointf> Points;
+    TArray<uint32> Indices;
+    int32 TrianglesNum = 0;
+    for (int ActorIdx = 0; ActorIdx < ActorArray.Num(); ++ActorIdx)
+    {
+        if (!ActorArray[ActorIdx]->GetStaticMeshComponent())
+        {
+            continue;
+        }
+        UStaticMesh* StaticMesh = ActorArray[ActorIdx]->GetStaticMeshComponent()->GetStaticMesh();
+        if (!StaticMesh)
+        {
+            continue;
+        }
+        FAutoShuffleOcclusionMesh& OcclusionMesh = OcclusionMeshes.FindOrAdd(StaticMesh);
+        const FTransform& Transform = ActorArray[ActorIdx]->GetTransform();
+        Points.Reset();
+        const FAutoShuffleOcclusionGeometry* Geometry = nullptr;
+        if (!bUseProxies)
+        {
+            Geometry = OcclusionMesh.GetFullDetail(StaticMesh);
+        }
+        else
+        {
+            // Proxy policy: a product needs no more triangles than the pixels it covers. Take the finest render LOD within
+            // that budget; if even the coarsest LOD is over it, draw the outline of the convex hulls, or of the bounds
+            FVector ProductOrigin, ProductExtent;
+            ActorArray[ActorIdx]->GetActorBounds(false, ProductOrigin, ProductExtent);
+            FVector BorderSize = RenderingBorder.GetSize();
+            float ProjectedPixels = 2.f * ProductExtent.Y / BorderSize.Y * OCCLUSION_VISIBILITY_RESOLUTION_WIDTH *
+                2.f * ProductExtent.Z / BorderSize.Z * OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT;
+            int32 LODIdx = SelectOcclusionLOD(StaticMesh, ProjectedPixels * OCCLUSION_PROXY_TRIANGLES_PER_PIXEL);
+            if (LODIdx != INDEX_NONE)
             {
-                continue;
+                Geometry = OcclusionMesh.GetRenderLOD(StaticMesh, LODIdx);
             }
-            // get a centerilized anchor for placing products
-            int ShelfBaseIdx = FMath::RandRange(0, ShelfBaseZ.Num() - 1);
-            FVector Anchor;
-            Anchor.Z = ShelfBaseZ[ShelfBaseIdx];
-            Anchor.Y = FMath::RandRange(float(BoundingBoxOrigin.Y - BoundingBoxExtent.Y + AUTO_SHUFFLE_Y_TWO_END_OFFSET), float(BoundingBoxOrigin.Y + BoundingBoxExtent.Y - AUTO_SHUFFLE_Y_TWO_END_OFFSET));
-            Anchor.X = BoundingBoxOrigin.X - BoundingBoxExtent.X;
-            // iterate through all the products within the current group
-            for (auto ProductIt = ProductGroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
+            else
             {
-                // if rand() <= Density, select
-                if (FMath::RandRange(0.f, 1.f) > Density)
-                {
-#ifdef VERBOSE_AUTO_SHUFFLE
-                    UE_LOG(LogAutoShuffle, Log, TEXT("Product %s has been discarded"), *ProductIt->GetName());
-#endif
-                    ProductIt->SetPosition(DiscardedProductsRegions);
-                    ProductIt->Discard();
-                    ProductIt->ResetOnShelf();
-                    continue;
-                }
-                // if rand() >= Proxmity place it randomly
-                if (FMath::RandRange(0.f, 1.f) >= Proxmity)
+                TArray<FVector> HullPoints;
+                if (StaticMesh->BodySetup)
                 {
-                    // randomly get a start point on the boundary of the shelf; if collided get another one
-                    FVector ProductStartPoint;
-                    int AlreadyTriedTimes = 0;
-                    TArray<AActor*> OverlappingActors;
-                    while (true)
-                    {
-                        if (AlreadyTriedTimes >= AUTO_SHUFFLE_MAX_TRY_TIMES)
-                        {
-                            AlreadyTriedTimes = -1;
-                            break;
-                        }
-                        AlreadyTriedTimes += 1;
-                        int ProductStartPointShelfBaseIdx = FMath::RandRange(0, ShelfBaseZ.Num() - 1);
-                        ProductStartPoint.Z = ShelfBaseZ[ProductStartPointShelfBaseIdx];
-                        ProductStartPoint.Y = FMath::RandRange(float(BoundingBoxOrigin.Y - BoundingBoxExtent.Y + AUTO_SHUFFLE_Y_TWO_END_OFFSET), float(BoundingBoxOrigin.Y + BoundingBoxExtent.Y - AUTO_SHUFFLE_Y_TWO_END_OFFSET));
-                        ProductStartPoint.X = BoundingBoxOrigin.X - BoundingBoxExtent.X;
-                        ProductIt->SetPosition(ProductStartPoint);
-                        ProductIt->SetShelfOffset(ShelfOffsetZ[ProductStartPointShelfBaseIdx]);
-                        // deal with the offset of the product center and the bottom
-                        FVector ProductOrigin, ProductExtent;
-                        ProductIt->GetObjectActor()->GetActorBounds(false, ProductOrigin, ProductExtent);
-                        float ProductCurrentBottom = ProductOrigin.Z - ProductExtent.Z;
-                        float ProductZLift = ProductStartPoint.Z - ProductCurrentBottom;
-                        float ProductCurrentFront = ProductOrigin.X - ProductExtent.X;
-                        float ProductXlift = ProductStartPoint.X - ProductCurrentFront;
-                        float ProductCurrentOrigin = ProductOrigin.Y;
-                        float ProductYLift = ProductStartPoint.Y - ProductCurrentOrigin;
-                        ProductStartPoint.X += ProductXlift;
-                        ProductStartPoint.Y += ProductYLift;
-                        ProductStartPoint.Z += ProductZLift;
-                        ProductIt->SetPosition(ProductStartPoint);
-                        // find all the overlapped actors
-                        ProductIt->GetObjectActor()->GetOverlappingActors(OverlappingActors);
-                        UE_LOG(LogAutoShuffle, Log, TEXT("%s has %d overlapping actors"), *ProductIt->GetName(), OverlappingActors.Num());
-                        /** @todo consider implementing a collision whitelist, e.g., BP_DemoRoom */
-                        if (/** no collision */ OverlappingActors.Num() == 0)
-                        {
-                            break;
-                        }
-#ifdef VERBOSE_AUTO_SHUFFLE
-                        for (auto OverlappingActorIt = OverlappingActors.CreateIterator(); OverlappingActorIt; ++OverlappingActorIt)
-                        {
-                            UE_LOG(LogAutoShuffle, Log, TEXT("%s is overlapping with %s"), *ProductIt->GetName(), *(*OverlappingActorIt)->GetName());
-                        }
-#endif
-                    }
-                    // if within the maximum try times the product still didn't find the proper place, discard it
-                    if (AlreadyTriedTimes == -1)
-                    {
-#ifdef VERBOSE_AUTO_SHUFFLE
-                        UE_LOG(LogAutoShuffle, Log, TEXT("Product %s has been discarded"), *ProductIt->GetName());
-#endif
-                        ProductIt->SetPosition(DiscardedProductsRegions);
-                        ProductIt->Discard();
-                        ProductIt->ResetOnShelf();
-                        continue;
-                    }
-                    ProductIt->SetOnShelf();
-                    // try to push the item inside, until collided
-                    AlreadyTriedTimes = 0;
-                    while (AlreadyTriedTimes++ < AUTO_SHUFFLE_INC_BOUND)
+                    for (auto ElemIt = StaticMesh->BodySetup->AggGeom.ConvexElems.CreateConstIterator(); ElemIt; ++ElemIt)
                     {
-                        ProductIt->GetObjectActor()->GetOverlappingActors(OverlappingActors);
-                        FVector ProductPosition = ProductIt->GetObjectActor()->GetActorLocation();
-                        if (OverlappingActors.Num() != 0)
-                        {
-                            ProductPosition.X -= AUTO_SHUFFLE_INC_STEP;
-                            ProductIt->SetPosition(ProductPosition);
-                            break;
-                        }
-                        ProductPosition.X += AUTO_SHUFFLE_INC_STEP;
-                        ProductIt->SetPosition(ProductPosition);
+                        HullPoints.Append(ElemIt->VertexData);
                     }
                 }
-                // else place it near the anchor
-                else
+                if (HullPoints.Num() < 3)
                 {
-                    TArray<AActor*> OverlappingActors;
-                    int AlreadyTriedTimes = 0;
-                    // loop
-                    while (AlreadyTriedTimes++ < AUTO_SHUFFLE_MAX_TRY_TIMES)
-                    {
-                        // get the current object's bounding box
-                        ProductIt->SetPosition(Anchor);
-                        FVector ProductOrigin, ProductExtent;
-                        ProductIt->GetObjectActor()->GetActorBounds(false, ProductOrigin, ProductExtent);
-                        float ProductCurrenBottom = ProductOrigin.Z - ProductExtent.Z;
-                        float ProductZLift = Anchor.Z - ProductCurrenBottom;
-                        FVector ProductStartPoint = Anchor;
-                        float ProductCurrentFront = ProductOrigin.X - ProductExtent.X;
-                        float ProductXlift = ProductStartPoint.X - ProductCurrentFront;
-                        float ProductCurrentOrigin = ProductOrigin.Y;
-                        float ProductYLift = ProductStartPoint.Y - ProductCurrentOrigin;
-                        ProductStartPoint.X += ProductXlift;
-                        ProductStartPoint.Y += ProductYLift;
-                        ProductStartPoint.Z += ProductZLift;
-                        ProductIt->SetPosition(ProductStartPoint);
-                        ProductIt->SetShelfOffset(ShelfOffsetZ[ShelfBaseIdx]);
-                        // see if the object could fit the anchor position
-                        ProductIt->GetObjectActor()->GetOverlappingActors(OverlappingActors);
-                        bool bHasCollision = OverlappingActors.Num() != 0;
-                        // see if the product is in the bound of the shelf
-                        ProductIt->GetObjectActor()->GetActorBounds(false, ProductOrigin, ProductExtent);
-                        bool bIsInBound = ProductOrigin.Y - ProductExtent.Y >= BoundingBoxOrigin.Y - BoundingBoxExtent.Y
-                            && ProductOrigin.Y + ProductExtent.Y <= BoundingBoxOrigin.Y + BoundingBoxExtent.Y;
-                        if (/** no collision and inbound */ !bHasCollision && bIsInBound)
-                        {
-                            break;
-                        }
-                        // else if the product still in bound, get another anchor point that follows the perceptual organization
-                        else if (bIsInBound)
-                        {
-                            float ProductWidth = ProductExtent.Y * 2.f;
-                            // place the product to the right
-                            if (AlreadyTriedTimes % 2 == 1)
-                            {
-                                Anchor.Y += AlreadyTriedTimes * (ProductWidth + FMath::RandRange(float(AUTO_SHUFFLE_Y_TWO_END_OFFSET * 0.5f), AUTO_SHUFFLE_Y_TWO_END_OFFSET));
-                            }
-                            // place the product to the left
-                            else
-                            {
-                                Anchor.Y -= AlreadyTriedTimes * (ProductWidth + FMath::RandRange(float(AUTO_SHUFFLE_Y_TWO_END_OFFSET * 0.5f), AUTO_SHUFFLE_Y_TWO_END_OFFSET));
-                            }
-                        }
-                        // else, randomly find another anchor point
-                        else
-                        {
-                            ShelfBaseIdx = FMath::RandRange(0, ShelfBaseZ.Num() - 1);
-                            Anchor.Z = ShelfBaseZ[ShelfBaseIdx];
-                            Anchor.Y = FMath::RandRange(float(BoundingBoxOrigin.Y - BoundingBoxExtent.Y + AUTO_SHUFFLE_Y_TWO_END_OFFSET), float(BoundingBoxOrigin.Y + BoundingBoxExtent.Y - AUTO_SHUFFLE_Y_TWO_END_OFFSET));
-                            Anchor.X = BoundingBoxOrigin.X - BoundingBoxExtent.X;
-                        }
-                    }
-                    // if collision all the time, discard
-                    if (AlreadyTriedTimes >= AUTO_SHUFFLE_MAX_TRY_TIMES)
-                    {
-#ifdef VERBOSE_AUTO_SHUFFLE
-                        UE_LOG(LogAutoShuffle, Log, TEXT("Product %s has been discarded"), *ProductIt->GetName());
-#endif
-                        ProductIt->SetPosition(DiscardedProductsRegions);
-                        ProductIt->Discard();
-                        ProductIt->ResetOnShelf();
-                        continue;
-                    }
-                    // else push the product deep inside
-                    else
+                    // the eight corners of the local bounds
+                    FBox LocalBox = StaticMesh->GetBoundingBox();
+                    for (int32 CornerIdx = 0; CornerIdx < 8; ++CornerIdx)
                     {
-                        // try to push the item inside, until collided
-                        ProductIt->SetOnShelf();
-                        AlreadyTriedTimes = 0;
-                        while (AlreadyTriedTimes++ < AUTO_SHUFFLE_INC_BOUND)
-                        {
-                            ProductIt->GetObjectActor()->GetOverlappingActors(OverlappingActors);
-                            FVector ProductPosition = ProductIt->GetObjectActor()->GetActorLocation();
-                            if (OverlappingActors.Num() != 0)
-                            {
-                                ProductPosition.X -= AUTO_SHUFFLE_INC_STEP;
-                                ProductIt->SetPosition(ProductPosition);
-                                break;
-                            }
-                            ProductPosition.X += AUTO_SHUFFLE_INC_STEP;
-                            ProductIt->SetPosition(ProductPosition);
-                        }
+                        HullPoints.Add(FVector((CornerIdx & 1) ? LocalBox.Max.X : LocalBox.Min.X, (CornerIdx & 2) ? LocalBox.Max.Y : LocalBox.Min.Y, (CornerIdx & 4) ? LocalBox.Max.Z : LocalBox.Min.Z));
                     }
                 }
+                for (auto PointIt = HullPoints.CreateConstIterator(); PointIt; ++PointIt)
+                {
+                    Points.Add(ProjectToRenderingDevice(Transform.TransformPosition(*PointIt), RenderingBorder));
+                }
+                BuildOutlineTriangles(Points, Indices);
             }
-            if (bIsOrganizeChecked && bIsPerGroupChecked)
+        }
+        if (!Geometry && Points.Num() == 0)
+        {
+            continue;
+        }
+        if (Geometry)
+        {
+            // transform and project every vertex once, not once per wedge
+            Points.Reserve(Geometry->Vertices.Num());
+            for (auto VertexIt = Geometry->Vertices.CreateConstIterator(); VertexIt; ++VertexIt)
             {
-                OrganizeProducts();
+                Points.Add(ProjectToRenderingDevice(Transform.TransformPosition(*VertexIt), RenderingBorder));
             }
         }
+        TrianglesNum += RasterizeTriangles(Points, Geometry ? Geometry->Indices : Indices, ActorIdx);
     }
+    return TrianglesNum;
 }
 
-void FAutoShuffleWindowModule::LowerProducts()
+void FAutoShuffleWindowModule::CountOcclusionPixels(int32 ActorsNum, bool bUseProxies, TArray<int32>& OutVisiblePixelCount, TArray<int32>& OutTotalPixelCount)
 {
-    for (auto ProductGroupIt = ProductsWhitelist->CreateIterator(); ProductGroupIt; ++ProductGroupIt)
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_CountOcclusionPixels);
+    FAutoShufflePhaseScope PhaseScope(RunTimings, bUseProxies ? TEXT("CountPixels") : TEXT("CountPixelsFullDetail"));
+    // Organize the pixels: one product can only have one depth at one pixel
+    // the smallest (because we are looking from small to big) product is visible; others are not
+    OutVisiblePixelCount.Init(0, ActorsNum);
+    OutTotalPixelCount.Init(0, ActorsNum);
+    TArray<int> RelatedActorIdxArray;
+    for (int y = 0; y < OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT; ++y)
     {
-        for (auto ProductIt = ProductGroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
+        for (int x = 0; x < OCCLUSION_VISIBILITY_RESOLUTION_WIDTH; ++x)
         {
-            if (!ProductIt->IsDiscarded())
+            TArray<FOcclusionPixel> &PixelArray = RenderingDevice[y][x];
+            if (PixelArray.Num() == 0)
+            {
+                continue;
+            }
+            // Sort the pixel array according to depth (from small to big)
+            PixelArray.Sort(FOcclusionPixel::OrganizePixelPredicateLowToHigh);
+            OutVisiblePixelCount[PixelArray[0].ActorIdx] += 1;
+            RelatedActorIdxArray.Reset();
+            for (int PixelIdx = 0; PixelIdx < PixelArray.Num(); ++PixelIdx)
+            {
+                RelatedActorIdxArray.AddUnique(PixelArray[PixelIdx].ActorIdx);
+            }
+            for (auto RelatedActorIt = RelatedActorIdxArray.CreateIterator(); RelatedActorIt; ++RelatedActorIt)
             {
-                FVector Position = ProductIt->GetPosition();
-                Position.Z -= ProductIt->GetShelfOffset();
-                ProductIt->SetPosition(Position);
+                OutTotalPixelCount[*RelatedActorIt] += 1;
             }
         }
     }
 }
 
-void FAutoShuffleWindowModule::OrganizeProducts()
+int32 FAutoShuffleWindowModule::SelectOcclusionLOD(UStaticMesh* StaticMesh, float TrianglesBudget)
 {
-    // iterate through all the shelves
-    for (auto ShelfIt = ShelvesWhitelist->CreateIterator(); ShelfIt; ++ShelfIt)
+    if (!StaticMesh->RenderData)
     {
-        FString ShelfName = ShelfIt->GetName();
-        FVector ShelfOrigin, ShelfExtent;
-        ShelfIt->GetObjectActor()->GetActorBounds(false, ShelfOrigin, ShelfExtent);
-        // collect all the products' actors which are on shelf and have not been discarded
-        TArray<AActor*> Products;
-        Products.Reset();
-        for (auto ProductGroupIt = ProductsWhitelist->CreateIterator(); ProductGroupIt; ++ProductGroupIt)
+        return INDEX_NONE;
+    }
+    for (int32 LODIdx = 0; LODIdx < StaticMesh->RenderData->LODResources.Num(); ++LODIdx)
+    {
+        if (StaticMesh->RenderData->LODResources[LODIdx].GetNumTriangles() <= TrianglesBudget)
+        {
+            return LODIdx;
+        }
+    }
+    return INDEX_NONE;
+}
+
+F2DPointf FAutoShuffleWindowModule::ProjectToRenderingDevice(const FVector& Position, const FBox& RenderingBorder)
+{
+    // looking from small x to big x: y goes right, z goes up and x is the depth
+    return F2DPointf(
+        (Position.Y - RenderingBorder.Min.Y) / (RenderingBorder.Max.Y - RenderingBorder.Min.Y) * OCCLUSION_VISIBILITY_RESOLUTION_WIDTH,
+        (Position.Z - RenderingBorder.Min.Z) / (RenderingBorder.Max.Z - RenderingBorder.Min.Z) * OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT,
+        Position.X
+    );
+}
+
+void FAutoShuffleWindowModule::BuildOutlineTriangles(TArray<F2DPointf>& Points, TArray<uint32>& OutIndices)
+{
+    // the 2D convex hull of the projected points (monotone chain), kept in Points and fanned into triangles
+    OutIndices.Reset();
+    if (Points.Num() < 3)
+    {
+        return;
+    }
+    Points.Sort([](const F2DPointf& Point1, const F2DPointf& Point2)
+    {
+        return Point1.X < Point2.X || (Point1.X == Point2.X && Point1.Y < Point2.Y);
+    });
+    auto Cross = [](const F2DPointf& O, const F2DPointf& A, const F2DPointf& B)
+    {
+        return (A.X - O.X) * (B.Y - O.Y) - (A.Y - O.Y) * (B.X - O.X);
+    };
+    TArray<F2DPointf> Outline;
+    for (int32 PointIdx = 0; PointIdx < Points.Num(); ++PointIdx)
+    {
+        while (Outline.Num() >= 2 && Cross(Outline[Outline.Num() - 2], Outline.Last(), Points[PointIdx]) <= 0.f)
+        {
+            Outline.Pop(false);
+        }
+        Outline.Add(Points[PointIdx]);
+    }
+    int32 LowerNum = Outline.Num() + 1;
+    for (int32 PointIdx = Points.Num() - 2; PointIdx >= 0; --PointIdx)
+    {
+        while (Outline.Num() >= LowerNum && Cross(Outline[Outline.Num() - 2], Outline.Last(), Points[PointIdx]) <= 0.f)
+        {
+            Outline.Pop(false);
+        }
+        Outline.Add(Points[PointIdx]);
+    }
+    // the first point is repeated at the end
+    Outline.Pop(false);
+    Points = MoveTemp(Outline);
+    for (int32 PointIdx = 1; PointIdx + 1 < Points.Num(); ++PointIdx)
+    {
+        OutIndices.Add(0);
+        OutIndices.Add(PointIdx);
+        OutIndices.Add(PointIdx + 1);
+    }
+}
+
+int32 FAutoShuffleWindowModule::RasterizeTriangles(const TArray<F2DPointf>& Points, const TArray<uint32>& Indices, int32 ActorIdx)
+{
+    // Assumption: this is a triangle mesh; otherwise, don't know how to do
+    for (int WedgeIdx = 0; 3 * WedgeIdx + 2 < Indices.Num(); ++WedgeIdx)
+    {
+        const F2DPointf &Pointf1 = Points[Indices[3 * WedgeIdx + 0]], &Pointf2 = Points[Indices[3 * WedgeIdx + 1]], &Pointf3 = Points[Indices[3 * WedgeIdx + 2]];
+        // the rasterizer takes counter-clockwise triangles, so draw both windings
+        for (int Winding = 0; Winding < 2; ++Winding)
+        {
+            TArray<F2DPoint> *RenderingPoints = Winding == 0 ? TriangleRasterizer(Pointf1, Pointf2, Pointf3) : TriangleRasterizer(Pointf1, Pointf3, Pointf2);
+            // Render them to the device
+            for (auto PointIt = RenderingPoints->CreateIterator(); PointIt; ++PointIt)
+            {
+                if (PointIt->X < 0 || PointIt->X >= OCCLUSION_VISIBILITY_RESOLUTION_WIDTH ||
+                    PointIt->Y < 0 || PointIt->Y >= OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT)
+                {
+                    continue;
+                }
+                RenderingDevice[PointIt->Y][PointIt->X].Add(FOcclusionPixel(ActorIdx, PointIt->Z));
+            }
+            delete RenderingPoints;
+        }
+    }
+    return Indices.Num() / 3;
+}
+
+void FAutoShuffleWindowModule::BatchConvexDecomposition()
+{
+    StartConvexDecomposition(AccuracySpinBox->GetValue(), MaxHullVertsSpinBox->GetValue());
+}
+
+void FAutoShuffleWindowModule::StartConvexDecomposition(float DefaultAccuracy, int32 DefaultMaxHullVerts)
+{
+    // Batch convex decomposition on every product
+    // Reference: https://github.com/EpicGames/UnrealEngine/blob/55c9f3ba0010e2e483d49a4cd378f36a46601fad/Engine/Source/Editor/StaticMeshEditor/Private/StaticMeshEditor.cpp#L1625
+    UE_LOG(LogAutoShuffle, Log, TEXT("Start Batch Convex Decomposition"));
+    if (DecompositionTickerHandle.IsValid())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("A batch convex decomposition is already running."));
+        return;
+    }
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_BatchConvexDecomposition);
+    RunTimings.Reset();
+    DecompositionStartTime = FPlatformTime::Seconds();
+    ReadWhitelist();
+    // the members of a group share their mesh, so each mesh is decomposed once, with the preset of the first group using it
+    TSet<UStaticMesh*> VisitedMeshes;
+    int32 UniqueMeshesNum = 0;
+    DecompositionJobs.Reset();
+    for (auto GroupIt = ProductsWhitelist.CreateConstIterator(); GroupIt; ++GroupIt)
+    {
+        float InAccuracy = GroupIt->GetDecompositionAccuracy(DefaultAccuracy);
+        int32 InMaxHullVerts = GroupIt->GetDecompositionMaxHullVerts(DefaultMaxHullVerts);
+        for (int32 ProductIdx = GroupIt->GetFirstMember(); ProductIdx < GroupIt->GetMembersEnd(); ++ProductIdx)
         {
-            if (ProductGroupIt->GetShelfName() != ShelfName)
+            AStaticMeshActor* StaticMeshActor = Cast<AStaticMeshActor>(ProductStore.GetObjectActor(ProductIdx));
+            if (!StaticMeshActor)
+            {
+                continue;
+            }
+            if (!StaticMeshActor->GetStaticMeshComponent())
             {
                 continue;
             }
-            for (auto ProductIt = ProductGroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
+            UStaticMesh* StaticMesh = StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh();
+            if (!StaticMesh || !StaticMesh->RenderData)
             {
-                if (ProductIt->IsOnShelf() && !ProductIt->IsDiscarded() && ProductIt->GetObjectActor() != nullptr)
+                continue;
+            }
+            if (VisitedMeshes.Contains(StaticMesh))
+            {
+                continue;
+            }
+            VisitedMeshes.Add(StaticMesh);
+            ++UniqueMeshesNum;
+            FString Settings = DescribeConvexDecomposition(StaticMesh, InAccuracy, InMaxHullVerts);
+            if (!IsConvexDecompositionCurrent(StaticMesh, Settings))
+            {
+                FAutoShuffleDecompositionJob& Job = DecompositionJobs[DecompositionJobs.AddDefaulted()];
+                Job.StaticMesh = StaticMesh;
+                Job.Accuracy = InAccuracy;
+                Job.MaxHullVerts = InMaxHullVerts;
+                Job.Settings = Settings;
+                // a mesh rebuilt without a change of its collision geometry keeps its hulls; only the task can tell, from the hash
+                const FString* StoredHullKey = StaticMesh->GetOutermost()->GetMetaData()->FindValue(StaticMesh, ConvexHullKeyMetaDataKey);
+                if (StoredHullKey != nullptr && StaticMesh->bCustomizedCollision && StaticMesh->BodySetup && StaticMesh->BodySetup->AggGeom.ConvexElems.Num() > 0)
                 {
-                    Products.Add(ProductIt->GetObjectActor());
+                    Job.StoredHullKey = *StoredHullKey;
                 }
             }
         }
-        // sort them according to bound.Y from low to high for 001 shelf
-        if (ShelfIt->GetName() == "BP_ShelfMain_001")
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("%d of %d unique meshes of %d products to decompose; the others are up to date"), DecompositionJobs.Num(), UniqueMeshesNum, ProductStore.Num());
+    if (DecompositionJobs.Num() == 0)
+    {
+        return;
+    }
+    NextDecompositionJob = 0;
+    RunningDecompositionJobs = 0;
+    AppliedDecompositionJobs = 0;
+    CachedDecompositionJobs.Reset();
+    bIsDecompositionCancelled = false;
+    FNotificationInfo Info(FText::FromString(TEXT("Decomposing meshes...")));
+    Info.bFireAndForget = false;
+    Info.ButtonDetails.Add(FNotificationButtonInfo(FText::FromString(TEXT("Cancel")), FText::FromString(TEXT("Stop after the meshes being decomposed")),
+        FSimpleDelegate::CreateStatic(&FAutoShuffleWindowModule::CancelConvexDecomposition), SNotificationItem::CS_Pending));
+    DecompositionNotification = FSlateNotificationManager::Get().AddNotification(Info);
+    if (DecompositionNotification.IsValid())
+    {
+        DecompositionNotification->SetCompletionState(SNotificationItem::CS_Pending);
+    }
+    DecompositionTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&FAutoShuffleWindowModule::TickConvexDecomposition));
+}
+
+bool FAutoShuffleWindowModule::TickConvexDecomposition(float DeltaTime)
+{
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_BatchConvexDecomposition);
+    // apply the finished jobs. Only this part touches the meshes
+    for (int32 JobIdx = 0; JobIdx < NextDecompositionJob; ++JobIdx)
+    {
+        FAutoShuffleDecompositionJob& Job = DecompositionJobs[JobIdx];
+        if (!Job.bIsRunning || !Job.Result.IsReady())
+        {
+            continue;
+        }
+        UStaticMesh* StaticMesh = Job.StaticMesh.Get();
+        if (Job.Result.Get() && StaticMesh != nullptr && Job.bIsCurrent)
         {
-            Products.Sort(OrganizeProductsPredicateLowToHigh);
+            UE_LOG(LogAutoShuffle, Log, TEXT("%s: the hulls are current for its geometry (accuracy %g, %d verts)"), *StaticMesh->GetName(), Job.Accuracy, Job.MaxHullVerts);
+            RecordConvexDecomposition(StaticMesh, Job.Settings, Job.HullKey);
+            StaticMesh->MarkPackageDirty();
+            ++AppliedDecompositionJobs;
         }
-        // from high to low for 002 shelf
-        else
+        else if (Job.Result.Get() && StaticMesh != nullptr)
         {
-            Products.Sort(OrganizeProductsPredicateHighToLow);
+            UE_LOG(LogAutoShuffle, Log, TEXT("%s: %d hulls (accuracy %g, %d verts) %s in %.1f ms"), *StaticMesh->GetName(), Job.Hulls.Num(),
+                Job.Accuracy, Job.MaxHullVerts, Job.bIsCached ? TEXT("read from cache") : TEXT("decomposed"), Job.Seconds * 1000.0);
+            FAutoShufflePhaseScope PhaseScope(RunTimings, TEXT("ApplyHulls"));
+            ApplyConvexDecomposition(StaticMesh, Job.Hulls, Job.Settings, Job.HullKey);
+            ++AppliedDecompositionJobs;
         }
-
-        // iterate through all the sorted actors
-        for (auto ProductIt = Products.CreateIterator(); ProductIt; ++ProductIt)
+        RunTimings.Add(TEXT("MeshTasks"), Job.Seconds);
+        Job.Hulls.Empty();
+        Job.bIsRunning = false;
+        --RunningDecompositionJobs;
+    }
+    // start new jobs, at most one per worker thread
+    int32 MaxRunningJobs = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+    while (!bIsDecompositionCancelled && RunningDecompositionJobs < MaxRunningJobs && NextDecompositionJob < DecompositionJobs.Num())
+    {
+        FAutoShuffleDecompositionJob& Job = DecompositionJobs[NextDecompositionJob++];
+        UStaticMesh* StaticMesh = Job.StaticMesh.Get();
+        if (StaticMesh == nullptr)
+        {
+            continue;
+        }
+        Job.bIsRunning = true;
+        // the job stays at the same address: the array is not resized while the batch runs. The task only fills in its
+        // hull vertices; no UObject but the mesh, which is only read, is touched off the game thread
+        FAutoShuffleDecompositionJob* JobPtr = &Job;
+        Job.Result = Async<bool>(EAsyncExecution::ThreadPool, [StaticMesh, JobPtr]()
         {
-            // loop
-            while (true)
+            if (bIsDecompositionCancelled)
             {
-                // try to push them to left for 001 shelf
-                FVector Position = (*ProductIt)->GetActorLocation();
-                if (ShelfIt->GetName() == "BP_ShelfMain_001")
-                {
-                    Position.Y -= AUTO_SHUFFLE_INC_STEP;
-                }
-                // to right for 002 shelf
-                else
-                {
-                    Position.Y += AUTO_SHUFFLE_INC_STEP;
-                }
-                (*ProductIt)->SetActorLocation(Position);
-                // check if the object is still in the bound
-                FVector ProductOrigin, ProductExtent;
-                (*ProductIt)->GetActorBounds(false, ProductOrigin, ProductExtent);
-                bool IsInBound;
-                if (ShelfIt->GetName() == "BP_ShelfMain_001")
+                return false;
+            }
+            SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_DecomposeMesh);
+            double StartTime = FPlatformTime::Seconds();
+            float InAccuracy = JobPtr->Accuracy;
+            int32 InMaxHullVerts = JobPtr->MaxHullVerts;
+            TArray<FVector> Verts;
+            TArray<uint32> CollidingIndices;
+            ExtractCollisionGeometry(StaticMesh, Verts, CollidingIndices);
+            // the same geometry with the same settings always gives the same hulls, so the key is hashed once, here, for the cache and the metadata
+            FString CacheKey = GetConvexHullCacheKey(Verts, CollidingIndices, InAccuracy, InMaxHullVerts);
+            JobPtr->HullKey = CacheKey;
+            if (CacheKey == JobPtr->StoredHullKey)
+            {
+                JobPtr->bIsCurrent = true;
+            }
+            // run actual util to do the work (if we have some valid input)
+            else if (Verts.Num() >= 3 && CollidingIndices.Num() > 3)
+            {
+                if (LoadConvexHullsFromCache(CacheKey, JobPtr->Hulls))
                 {
-                    IsInBound = ProductOrigin.Y - ProductExtent.Y >= ShelfOrigin.Y - ShelfExtent.Y;
+                    CachedDecompositionJobs.Increment();
+                    JobPtr->bIsCached = true;
                 }
                 else
                 {
-                    IsInBound = ProductOrigin.Y + ProductExtent.Y <= ShelfOrigin.Y + ShelfExtent.Y;
-                }
-                // check if there's no collision
-                TArray<AActor*> OverlappingActors;
-                (*ProductIt)->GetOverlappingActors(OverlappingActors);
-                bool HasNoCollision = OverlappingActors.Num() == 0;
-                // if not in the bound or has collision, restore and proceed to the next product
-                if (!IsInBound || !HasNoCollision)
-                {
-                    if (ShelfIt->GetName() == "BP_ShelfMain_001")
-                    {
-                        Position.Y += AUTO_SHUFFLE_INC_STEP;
-                    }
-                    else
-                    {
-                        Position.Y -= AUTO_SHUFFLE_INC_STEP;
-                    }
-                    (*ProductIt)->SetActorLocation(Position);
-                    break;
+                    DecomposeGeometryToHulls(Verts, CollidingIndices, InAccuracy, InMaxHullVerts, JobPtr->Hulls);
+                    SaveConvexHullsToCache(CacheKey, JobPtr->Hulls);
                 }
             }
+            JobPtr->Seconds = FPlatformTime::Seconds() - StartTime;
+            return true;
+        });
+        ++RunningDecompositionJobs;
+    }
+    bool bIsFinished = RunningDecompositionJobs == 0 && (bIsDecompositionCancelled || NextDecompositionJob == DecompositionJobs.Num());
+    if (DecompositionNotification.IsValid())
+    {
+        FString Message = FString::Printf(TEXT("%s %d / %d meshes (%d cached)"), bIsFinished ? TEXT("Decomposed") : TEXT("Decomposing"),
+            AppliedDecompositionJobs, DecompositionJobs.Num(), CachedDecompositionJobs.GetValue());
+        DecompositionNotification->SetText(FText::FromString(Message));
+        if (bIsFinished)
+        {
+            DecompositionNotification->SetCompletionState(bIsDecompositionCancelled ? SNotificationItem::CS_Fail : SNotificationItem::CS_Success);
+            DecompositionNotification->ExpireAndFadeout();
+            DecompositionNotification.Reset();
+        }
+    }
+    if (!bIsFinished)
+    {
+        return true;
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("Batch Convex Decomposition %s: %d of %d meshes decomposed, %d from the hull cache"), bIsDecompositionCancelled ? TEXT("cancelled") : TEXT("done"),
+        AppliedDecompositionJobs, DecompositionJobs.Num(), CachedDecompositionJobs.GetValue());
+    RunTimings.Add(TEXT("Decompose"), FPlatformTime::Seconds() - DecompositionStartTime);
+    WritePhaseTimings(TEXT("ConvexDecomposition"));
+    DecompositionJobs.Reset();
+    DecompositionTickerHandle.Reset();
+    return false;
+}
+
+void FAutoShuffleWindowModule::CancelConvexDecomposition()
+{
+    bIsDecompositionCancelled = true;
+}
+
+void FAutoShuffleWindowModule::ExtractCollisionGeometry(UStaticMesh* StaticMesh, TArray<FVector>& OutVerts, TArray<uint32>& OutIndices)
+{
+    // only reads the render data, so this may run on any thread as long as the mesh isn't rebuilt meanwhile
+    OutVerts.Reset();
+    OutIndices.Reset();
+    if (StaticMesh->RenderData == nullptr || StaticMesh->RenderData->LODResources.Num() == 0)
+    {
+        return;
+    }
+    FStaticMeshLODResources &LODModel = StaticMesh->RenderData->LODResources[0];
+    // make vertex buffer
+    int32 NumVerts = LODModel.VertexBuffer.GetNumVertices();
+    OutVerts.SetNumUninitialized(NumVerts);
+    for (int32 VertIdx = 0; VertIdx < NumVerts; ++VertIdx)
+    {
+        OutVerts[VertIdx] = LODModel.PositionVertexBuffer.VertexPosition(VertIdx);
+    }
+    // only copy indices that have collision enabled, straight from the index buffer
+    int32 NumCollidingIndices = 0;
+    for (const FStaticMeshSection& Section : LODModel.Sections)
+    {
+        if (Section.bEnableCollision)
+        {
+            NumCollidingIndices += Section.NumTriangles * 3;
+        }
+    }
+    OutIndices.Reset(NumCollidingIndices);
+    FIndexArrayView Indices = LODModel.IndexBuffer.GetArrayView();
+    for (const FStaticMeshSection& Section : LODModel.Sections)
+    {
+        if (Section.bEnableCollision)
+        {
+            for (uint32 IndexIdx = Section.FirstIndex; IndexIdx < Section.FirstIndex + (Section.NumTriangles * 3); IndexIdx++)
+            {
+                OutIndices.Add(Indices[IndexIdx]);
+            }
+        }
+    }
+}
+
+FString FAutoShuffleWindowModule::GetConvexHullCacheKey(const TArray<FVector>& Verts, const TArray<uint32>& Indices, float InAccuracy, int32 InMaxHullVerts)
+{
+    FSHA1 HashState;
+    int32 VertsNum = Verts.Num(), IndicesNum = Indices.Num();
+    HashState.Update(reinterpret_cast<const uint8*>(&VertsNum), sizeof(VertsNum));
+    HashState.Update(reinterpret_cast<const uint8*>(Verts.GetData()), Verts.Num() * sizeof(FVector));
+    HashState.Update(reinterpret_cast<const uint8*>(&IndicesNum), sizeof(IndicesNum));
+    HashState.Update(reinterpret_cast<const uint8*>(Indices.GetData()), Indices.Num() * sizeof(uint32));
+    HashState.Update(reinterpret_cast<const uint8*>(&InAccuracy), sizeof(InAccuracy));
+    HashState.Update(reinterpret_cast<const uint8*>(&InMaxHullVerts), sizeof(InMaxHullVerts));
+    HashState.Final();
+    uint8 Hash[20];
+    HashState.GetHash(Hash);
+    return BytesToHex(Hash, sizeof(Hash));
+}
+
+FString FAutoShuffleWindowModule::GetConvexHullCacheFileDir(const FString& CacheKey)
+{
+    return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("AutoShuffle"), TEXT("ConvexHullCache"), *(CacheKey + TEXT(".hulls")));
+}
+
+bool FAutoShuffleWindowModule::LoadConvexHullsFromCache(const FString& CacheKey, TArray<TArray<FVector>>& OutHulls)
+{
+    TUniquePtr<FArchive> FileReader(IFileManager::Get().CreateFileReader(*GetConvexHullCacheFileDir(CacheKey)));
+    if (!FileReader.IsValid())
+    {
+        return false;
+    }
+    uint32 Magic = 0, Version = 0;
+    TArray<TArray<FVector>> Hulls;
+    *FileReader << Magic << Version;
+    if (Magic != 0x48435341 || Version != 1)
+    {
+        return false;
+    }
+    *FileReader << Hulls;
+    if (FileReader->IsError())
+    {
+        return false;
+    }
+    OutHulls = MoveTemp(Hulls);
+    return true;
+}
+
+void FAutoShuffleWindowModule::SaveConvexHullsToCache(const FString& CacheKey, TArray<TArray<FVector>>& Hulls)
+{
+    // written to a temporary file first: another job may be reading or writing the same key
+    FString CacheFileDir = GetConvexHullCacheFileDir(CacheKey);
+    FString TempFileDir = CacheFileDir + FString::Printf(TEXT(".%u.tmp"), FPlatformTLS::GetCurrentThreadId());
+    {
+        TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*TempFileDir));
+        if (!FileWriter.IsValid())
+        {
+            return;
+        }
+        uint32 Magic = 0x48435341, Version = 1;
+        *FileWriter << Magic << Version << Hulls;
+    }
+    IFileManager::Get().Move(*CacheFileDir, *TempFileDir);
+}
+
+void FAutoShuffleWindowModule::DecomposeGeometryToHulls(const TArray<FVector>& Verts, const TArray<uint32>& Indices, float InAccuracy, int32 InMaxHullVerts, TArray<TArray<FVector>>& OutHulls)
+{
+    // The engine's DecomposeMeshToHulls writes into a body setup, invalidates its physics data and opens a slow task
+    // dialog, none of which may happen off the game thread. V-HACD is called here directly with the parameters it uses,
+    // and only the hull vertices come out
+    OutHulls.Reset();
+    // V-HACD often crashes on degenerate input, so a box that is invalid or too thin is skipped
+    FBox VertBox(ForceInit);
+    for (auto VertIt = Verts.CreateConstIterator(); VertIt; ++VertIt)
+    {
+        VertBox += *VertIt;
+    }
+    if (!VertBox.IsValid || VertBox.GetSize().GetMax() < 1.f || VertBox.GetSize().GetMin() < 0.1f)
+    {
+        return;
+    }
+    VHACD::IVHACD::Parameters Params;
+    Params.m_resolution = 1000000;
+    Params.m_maxNumVerticesPerCH = InMaxHullVerts;
+    Params.m_concavity = 0.3f * (1.f - FMath::Clamp(InAccuracy, 0.f, 1.f));
+    Params.m_oclAcceleration = false;
+    Params.m_minVolumePerCH = 0.003f;
+    VHACD::IVHACD* InterfaceVHACD = VHACD::CreateVHACD();
+    if (InterfaceVHACD->Compute(reinterpret_cast<const float*>(Verts.GetData()), 3, Verts.Num(), reinterpret_cast<const int*>(Indices.GetData()), 3, Indices.Num() / 3, Params))
+    {
+        int32 HullsNum = InterfaceVHACD->GetNConvexHulls();
+        OutHulls.SetNum(HullsNum);
+        for (int32 HullIdx = 0; HullIdx < HullsNum; ++HullIdx)
+        {
+            VHACD::IVHACD::ConvexHull Hull;
+            InterfaceVHACD->GetConvexHull(HullIdx, Hull);
+            OutHulls[HullIdx].Reserve(Hull.m_nPoints);
+            for (uint32 VertIdx = 0; VertIdx < Hull.m_nPoints; ++VertIdx)
+            {
+                OutHulls[HullIdx].Add(FVector(Hull.m_points[VertIdx * 3], Hull.m_points[VertIdx * 3 + 1], Hull.m_points[VertIdx * 3 + 2]));
+            }
+        }
+    }
+    InterfaceVHACD->Clean();
+    InterfaceVHACD->Release();
+}
+
+void FAutoShuffleWindowModule::ApplyConvexDecomposition(UStaticMesh* StaticMesh, const TArray<TArray<FVector>>& Hulls, const FString& Settings, const FString& HullKey)
+{
+    // get the bodysetup we are going to put the collision into
+    UBodySetup *BodySetup = StaticMesh->BodySetup;
+    if (BodySetup)
+    {
+        BodySetup->RemoveSimpleCollision();
+    }
+    else
+    {
+        // otherwise, create one here.
+        StaticMesh->CreateBodySetup();
+        BodySetup = StaticMesh->BodySetup;
+    }
+    // the convex elements are only built here, on the game thread, and their physics meshes are cooked for the mesh
+    for (auto HullIt = Hulls.CreateConstIterator(); HullIt; ++HullIt)
+    {
+        FKConvexElem& ConvexElem = BodySetup->AggGeom.ConvexElems[BodySetup->AggGeom.ConvexElems.AddDefaulted()];
+        ConvexElem.VertexData = *HullIt;
+        ConvexElem.UpdateElemBox();
+    }
+    BodySetup->InvalidatePhysicsData();
+    BodySetup->CreatePhysicsMeshes();
+    // refresh collision change back to static mesh components
+    RefreshCollisionChange(StaticMesh);
+    // mark mesh as dirty
+    StaticMesh->MarkPackageDirty();
+    // mark the static mesh for collision customization
+    StaticMesh->bCustomizedCollision = true;
+    RecordConvexDecomposition(StaticMesh, Settings, HullKey);
+}
+
+void FAutoShuffleWindowModule::RecordConvexDecomposition(UStaticMesh* StaticMesh, const FString& Settings, const FString& HullKey)
+{
+    // remember the settings so that the next batch can skip the mesh, and the geometry so that a rebuild of the same geometry keeps the hulls
+    UMetaData* MetaData = StaticMesh->GetOutermost()->GetMetaData();
+    MetaData->SetValue(StaticMesh, ConvexDecompositionMetaDataKey, *Settings);
+    MetaData->SetValue(StaticMesh, ConvexHullKeyMetaDataKey, *HullKey);
+}
+
+FString FAutoShuffleWindowModule::GetConvexDecompositionSettings(float InAccuracy, int32 InMaxHullVerts)
+{
+    return FString::Printf(TEXT("Accuracy=%g;MaxHullVerts=%d"), InAccuracy, InMaxHullVerts);
+}
+
+FString FAutoShuffleWindowModule::DescribeConvexDecomposition(UStaticMesh* StaticMesh, float InAccuracy, int32 InMaxHullVerts)
+{
+    // a mesh reimported with new geometry but decomposed with the same settings must not be taken as current. The derived
+    // data key of the render data changes with the source geometry and costs nothing, unlike hashing the vertices here
+    return GetConvexDecompositionSettings(InAccuracy, InMaxHullVerts) + TEXT(";Mesh=") + StaticMesh->RenderData->DerivedDataKey;
+}
+
+bool FAutoShuffleWindowModule::IsConvexDecompositionCurrent(UStaticMesh* StaticMesh, const FString& DecompositionSettings)
+{
+    // the hulls are current if they were customized by a batch of the same settings on the same geometry and nobody has removed them since
+    if (!StaticMesh->bCustomizedCollision || !StaticMesh->BodySetup || StaticMesh->BodySetup->AggGeom.ConvexElems.Num() == 0)
+    {
+        return false;
+    }
+    const FString* StoredSettings = StaticMesh->GetOutermost()->GetMetaData()->FindValue(StaticMesh, ConvexDecompositionMetaDataKey);
+    return StoredSettings != nullptr && *StoredSettings == DecompositionSettings;
+}
+
+void FAutoShuffleWindowModule::NonProductsVisibilityTogglingImplementation()
+{
+    auto EditorWorld = GetTargetWorld();
+    // the tracked sets are kept from the last whitelist read; only a new level needs reading it again
+    if (VisibilityWorld.Get() != EditorWorld)
+    {
+        ReadWhitelist();
+    }
+    bool bIsHidden = !bIsNonProductsVisible;
+    // collect the actors whose state changes first, then update them in one go
+    TArray<AActor*> ChangedActors;
+    for (auto ActorIt = NonProductActors.CreateConstIterator(); ActorIt; ++ActorIt)
+    {
+        AActor* Actor = ActorIt->Get();
+        if (Actor && Actor->bHidden != bIsHidden)
+        {
+            ChangedActors.Add(Actor);
+        }
+    }
+    int32 NonProductChangedNum = ChangedActors.Num();
+    for (int32 ProductIdx = 0; ProductIdx < ProductStore.Num(); ++ProductIdx)
+    {
+        // discarded products are only shown along with the non-products
+        AActor* ProductActor = ProductStore.GetObjectActor(ProductIdx);
+        bool bIsProductHidden = bIsHidden && ProductStore.IsDiscarded(ProductIdx);
+        if (ProductActor && ProductActor->bHidden != bIsProductHidden)
+        {
+            ChangedActors.Add(ProductActor);
+        }
+    }
+    // every collected actor is in the wrong state, so flipping it is the update
+    for (auto ActorIt = ChangedActors.CreateIterator(); ActorIt; ++ActorIt)
+    {
+        (*ActorIt)->SetActorHiddenInGame(!(*ActorIt)->bHidden);
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("Visibility changed on %d non-products and %d products"), NonProductChangedNum, ChangedActors.Num() - NonProductChangedNum);
+}
+
+void FAutoShuffleWindowModule::TrackNonProductActors()
+{
+    TSet<AActor*> ProductActors;
+    ProductActors.Reserve(ProductStore.Num());
+    for (int32 ProductIdx = 0; ProductIdx < ProductStore.Num(); ++ProductIdx)
+    {
+        ProductActors.Add(ProductStore.GetObjectActor(ProductIdx));
+    }
+    NonProductActors.RemoveAllSwap([&ProductActors](const TWeakObjectPtr<AActor>& Actor)
+    {
+        return ProductActors.Contains(Actor.Get());
+    });
+}
+
+void FAutoShuffleWindowModule::ExportMappingBetweenActorIdAndDisplayName()
+{
+    bool bIsDetailed = DetailedExportCheckBox->IsChecked();
+    bool bIsBinary = BinaryExportCheckBox->IsChecked();
+    FString MappingFileDir = FPaths::Combine(*FPaths::GameDir(), *FString("Data"), bIsBinary ? *FString("ActorNameMapping.bin") : *FString("ActorNameMapping.csv"));
+    auto EditorWorld = GetTargetWorld();
+    double StartTime = FPlatformTime::Seconds();
+    // the group column comes from the whitelist; actors that are not products get an empty group.
+    // The session of the last shuffle is used as it is: reading the whitelist again would reset its flags, levels and ratios
+    TMap<AActor*, int32> ActorGroupIndex;
+    if (bIsDetailed && (IsSessionCurrent() || ReadWhitelist()))
+    {
+        for (int32 GroupIdx = 0; GroupIdx < ProductsWhitelist.Num(); ++GroupIdx)
+        {
+            for (int32 ProductIdx = ProductsWhitelist[GroupIdx].GetFirstMember(); ProductIdx < ProductsWhitelist[GroupIdx].GetMembersEnd(); ++ProductIdx)
+            {
+                ActorGroupIndex.Add(ProductStore.GetObjectActor(ProductIdx), GroupIdx);
+            }
+        }
+    }
+    TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*MappingFileDir));
+    if (!FileWriter.IsValid())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Mapping file '%s' could not be written."), *MappingFileDir);
+        return;
+    }
+    // binary layout: "ASAM", version, detailed flag, actor count, then one record per actor.
+    // A record is the id and the label, followed if detailed by location, rotation (quaternion), scale,
+    // AABB min, AABB max as floats, the mesh and the group. Strings are int32 UTF-8 length and bytes
+    const uint32 BinaryMagic = 0x4D415341;
+    const uint32 BinaryVersion = 1;
+    int64 ActorCountOffset = 0;
+    int32 ActorCount = 0;
+    {
+        FAutoShuffleExportBuffer Buffer(FileWriter.Get());
+        if (bIsBinary)
+        {
+            Buffer.AppendValue(BinaryMagic);
+            Buffer.AppendValue(BinaryVersion);
+            Buffer.AppendValue(uint32(bIsDetailed ? 1 : 0));
+            ActorCountOffset = 3 * sizeof(uint32);
+            Buffer.AppendValue(ActorCount);
+        }
+        else if (bIsDetailed)
+        {
+            Buffer.AppendText(TEXT("Id,Label,LocationX,LocationY,LocationZ,Pitch,Yaw,Roll,ScaleX,ScaleY,ScaleZ,MinX,MinY,MinZ,MaxX,MaxY,MaxZ,Mesh,Group\n"));
+        }
+        FString Row;
+        for (TActorIterator<AActor> ActorIt(EditorWorld); ActorIt; ++ActorIt)
+        {
+            ++ActorCount;
+            FString ActorID = ActorIt->GetName(), ActorLabel = ActorIt->GetActorLabel();
+            if (bIsBinary)
+            {
+                Buffer.AppendString(ActorID);
+                Buffer.AppendString(ActorLabel);
+            }
+            else
+            {
+                Row.Reset();
+                Row += ActorID;
+                Row += TEXT(",");
+                Row += EscapeCsvField(ActorLabel);
+            }
+            if (bIsDetailed)
+            {
+                FTransform Transform = ActorIt->GetActorTransform();
+                FVector ActorOrigin, ActorExtent;
+                ActorIt->GetActorBounds(false, ActorOrigin, ActorExtent);
+                FVector BoundsMin = ActorOrigin - ActorExtent, BoundsMax = ActorOrigin + ActorExtent;
+                FString MeshName;
+                AStaticMeshActor* StaticMeshActor = Cast<AStaticMeshActor>(*ActorIt);
+                if (StaticMeshActor && StaticMeshActor->GetStaticMeshComponent() && StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh())
+                {
+                    MeshName = StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh()->GetName();
+                }
+                int32* GroupIdx = ActorGroupIndex.Find(*ActorIt);
+                FString GroupName = GroupIdx ? ProductsWhitelist[*GroupIdx].GetName() : FString();
+                if (bIsBinary)
+                {
+                    Buffer.AppendValue(Transform.GetLocation());
+                    Buffer.AppendQuat(Transform.GetRotation());
+                    Buffer.AppendValue(Transform.GetScale3D());
+                    Buffer.AppendValue(BoundsMin);
+                    Buffer.AppendValue(BoundsMax);
+                    Buffer.AppendString(MeshName);
+                    Buffer.AppendString(GroupName);
+                }
+                else
+                {
+                    FVector Location = Transform.GetLocation(), Scale = Transform.GetScale3D();
+                    FRotator Rotation = Transform.Rotator();
+                    Row += FString::Printf(TEXT(",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,"),
+                        Location.X, Location.Y, Location.Z, Rotation.Pitch, Rotation.Yaw, Rotation.Roll, Scale.X, Scale.Y, Scale.Z,
+                        BoundsMin.X, BoundsMin.Y, BoundsMin.Z, BoundsMax.X, BoundsMax.Y, BoundsMax.Z);
+                    Row += EscapeCsvField(MeshName);
+                    Row += TEXT(",");
+                    Row += EscapeCsvField(GroupName);
+                }
+            }
+            if (!bIsBinary)
+            {
+                Row += TEXT("\n");
+                Buffer.AppendText(Row);
+            }
+        }
+    }
+    if (bIsBinary)
+    {
+        // the count is only known at the end
+        FileWriter->Seek(ActorCountOffset);
+        *FileWriter << ActorCount;
+    }
+    FileWriter->Close();
+    UE_LOG(LogAutoShuffle, Log, TEXT("Exported %d actors to %s in %.2f ms"), ActorCount, *MappingFileDir, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+FString FAutoShuffleWindowModule::EscapeCsvField(const FString& Field)
+{
+    int32 Dummy;
+    if (!Field.FindChar(TCHAR(','), Dummy) && !Field.FindChar(TCHAR('"'), Dummy) && !Field.FindChar(TCHAR('\n'), Dummy))
+    {
+        return Field;
+    }
+    return FString(TEXT("\"")) + Field.Replace(TEXT("\""), TEXT("\"\"")) + TEXT("\"");
+}
+
+void FAutoShuffleWindowModule::SaveLayoutSnapshot()
+{
+    FString SnapshotName = SnapshotNameTextBox->GetText().ToString();
+    if (SnapshotName.IsEmpty())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Snapshot name is empty."));
+        return;
+    }
+    // the live store keeps the shelf levels, the offsets and the flags of the last shuffle; reading the whitelist would reset them
+    if (!IsSessionCurrent() && !ReadWhitelist())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist read wrong. Module quits."));
+        return;
+    }
+    FAutoShuffleLayoutSnapshot& Snapshot = LayoutSnapshots.FindOrAdd(SnapshotName);
+    Snapshot.Capture(ProductStore);
+    FString SnapshotFileDir = GetLayoutSnapshotFileDir(SnapshotName);
+    if (!Snapshot.SaveToFile(SnapshotFileDir))
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Snapshot file '%s' could not be written."), *SnapshotFileDir);
+        return;
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("Snapshot %s of %d products saved to %s"), *SnapshotName, Snapshot.Num(), *SnapshotFileDir);
+}
+
+void FAutoShuffleWindowModule::RestoreLayoutSnapshot()
+{
+    FString SnapshotName = SnapshotNameTextBox->GetText().ToString();
+    FAutoShuffleLayoutSnapshot* Snapshot = LayoutSnapshots.Find(SnapshotName);
+    if (Snapshot == nullptr)
+    {
+        FAutoShuffleLayoutSnapshot LoadedSnapshot;
+        FString SnapshotFileDir = GetLayoutSnapshotFileDir(SnapshotName);
+        if (!LoadedSnapshot.LoadFromFile(SnapshotFileDir))
+        {
+            UE_LOG(LogAutoShuffle, Warning, TEXT("Snapshot %s not found in memory or in '%s'."), *SnapshotName, *SnapshotFileDir);
+            return;
+        }
+        Snapshot = &LayoutSnapshots.Add(SnapshotName, LoadedSnapshot);
+    }
+    // the actors are resolved again only for another level; Restore writes back every field it keeps anyway
+    if (!IsSessionCurrent() && !ReadWhitelist())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist read wrong. Module quits."));
+        return;
+    }
+    int32 RestoredNum = Snapshot->Restore(ProductStore);
+    UE_LOG(LogAutoShuffle, Log, TEXT("Snapshot %s restored on %d of %d products"), *SnapshotName, RestoredNum, ProductStore.Num());
+}
+
+void FAutoShuffleWindowModule::AppendLayoutManifest()
+{
+    WriteLayoutManifest(FPaths::Combine(*FPaths::GameDir(), *FString("Data"), *FString("LayoutManifest.bin")));
+}
+
+bool FAutoShuffleWindowModule::WriteLayoutManifest(const FString& ManifestFileDir)
+{
+    // The products of the last shuffle are used as they are: reading the whitelist again would lose
+    // the discard bits and the occlusion ratios
+    if (ProductStore.Num() == 0)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("No products in the session. Shuffle before appending to the manifest."));
+        return false;
+    }
+    auto EditorWorld = GetTargetWorld();
+    double StartTime = FPlatformTime::Seconds();
+    // the string table is shared by the id, label and group columns
+    TArray<uint8> StringBytes;
+    TArray<int32> StringOffsets;
+    TMap<FString, int32> StringIndex;
+    auto AddString = [&StringBytes, &StringOffsets, &StringIndex](const FString& String) -> int32
+    {
+        int32* FoundIdx = StringIndex.Find(String);
+        if (FoundIdx)
+        {
+            return *FoundIdx;
+        }
+        FTCHARToUTF8 Converted(*String);
+        int32 StringIdx = StringOffsets.Add(StringBytes.Num());
+        StringBytes.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+        StringIndex.Add(String, StringIdx);
+        return StringIdx;
+    };
+    TArray<int32> GroupOfProducts;
+    GroupOfProducts.Init(INDEX_NONE, ProductStore.Num());
+    for (int32 GroupIdx = 0; GroupIdx < ProductsWhitelist.Num(); ++GroupIdx)
+    {
+        int32 GroupNameIdx = AddString(ProductsWhitelist[GroupIdx].GetName());
+        for (int32 ProductIdx = ProductsWhitelist[GroupIdx].GetFirstMember(); ProductIdx < ProductsWhitelist[GroupIdx].GetMembersEnd(); ++ProductIdx)
+        {
+            GroupOfProducts[ProductIdx] = GroupNameIdx;
+        }
+    }
+    int32 LevelNameIdx = AddString(EditorWorld ? EditorWorld->GetMapName() : FString());
+    // gather the columns
+    TArray<int32> IdColumn, LabelColumn, GroupColumn;
+    TArray<FVector> LocationColumn, ScaleColumn, BoundsMinColumn, BoundsMaxColumn;
+    TArray<FQuat> RotationColumn;
+    TArray<float> OcclusionColumn;
+    TArray<uint8> FlagsColumn;
+    for (int32 ProductIdx = 0; ProductIdx < ProductStore.Num(); ++ProductIdx)
+    {
+        AActor* ProductActor = ProductStore.GetObjectActor(ProductIdx);
+        if (ProductActor == nullptr || ProductActor->IsPendingKill())
+        {
+            continue;
+        }
+        FTransform Transform = ProductActor->GetActorTransform();
+        FVector ProductOrigin, ProductExtent;
+        ProductActor->GetActorBounds(false, ProductOrigin, ProductExtent);
+        IdColumn.Add(AddString(ProductActor->GetName()));
+        LabelColumn.Add(AddString(ProductActor->GetActorLabel()));
+        GroupColumn.Add(GroupOfProducts[ProductIdx]);
+        LocationColumn.Add(Transform.GetLocation());
+        RotationColumn.Add(Transform.GetRotation());
+        ScaleColumn.Add(Transform.GetScale3D());
+        BoundsMinColumn.Add(ProductOrigin - ProductExtent);
+        BoundsMaxColumn.Add(ProductOrigin + ProductExtent);
+        OcclusionColumn.Add(ProductStore.GetOcclusionRatio(ProductIdx));
+        FlagsColumn.Add((ProductStore.IsDiscarded(ProductIdx) ? 1 : 0) | (ProductStore.IsOnShelf(ProductIdx) ? 2 : 0));
+    }
+    StringOffsets.Add(StringBytes.Num());
+    // Record layout, every section 4-byte aligned and every record padded to 8 bytes, so that in a file of records
+    // the ticks are 8-byte aligned and the columns can be mapped directly:
+    // header (32 bytes): "ASLM", version, record size, rows, UTC ticks (int64), level name string, strings
+    // columns: id, label, group (int32, string index or -1), location (3 floats), rotation (quaternion, 4 floats),
+    // scale (3 floats), AABB min, AABB max (3 floats each), occlusion ratio (float, -1 if unknown),
+    // flags (uint8, 1 discarded, 2 on shelf) padded to 4 bytes
+    // string table: offsets (strings + 1 int32) then UTF-8 bytes padded to 4 bytes, then zeros up to the record size.
+    // Version 1 records were not padded to 8 bytes
+    const uint32 ManifestMagic = 0x4D4C5341;
+    const uint32 ManifestVersion = 2;
+    const uint32 HeaderSize = 32;
+    uint32 RowsNum = IdColumn.Num();
+    uint32 StringsNum = StringOffsets.Num() - 1;
+    uint32 FlagsPadding = Align(RowsNum, 4) - RowsNum;
+    uint32 StringsPadding = Align(StringBytes.Num(), 4) - StringBytes.Num();
+    uint32 RecordSize = HeaderSize + RowsNum * (3 * sizeof(int32) + 17 * sizeof(float) + sizeof(uint8)) + FlagsPadding +
+        StringOffsets.Num() * sizeof(int32) + StringBytes.Num() + StringsPadding;
+    uint32 RecordPadding = Align(RecordSize, 8) - RecordSize;
+    RecordSize += RecordPadding;
+    TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*ManifestFileDir, FILEWRITE_Append));
+    if (!FileWriter.IsValid())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Manifest file '%s' could not be written."), *ManifestFileDir);
+        return false;
+    }
+    {
+        FAutoShuffleExportBuffer Buffer(FileWriter.Get());
+        const uint32 Zero = 0;
+        Buffer.AppendValue(ManifestMagic);
+        Buffer.AppendValue(ManifestVersion);
+        Buffer.AppendValue(RecordSize);
+        Buffer.AppendValue(RowsNum);
+        Buffer.AppendValue(FDateTime::UtcNow().GetTicks());
+        Buffer.AppendValue(LevelNameIdx);
+        Buffer.AppendValue(StringsNum);
+        Buffer.AppendBytes(IdColumn.GetData(), IdColumn.Num() * sizeof(int32));
+        Buffer.AppendBytes(LabelColumn.GetData(), LabelColumn.Num() * sizeof(int32));
+        Buffer.AppendBytes(GroupColumn.GetData(), GroupColumn.Num() * sizeof(int32));
+        Buffer.AppendBytes(LocationColumn.GetData(), LocationColumn.Num() * sizeof(FVector));
+        for (auto RotationIt = RotationColumn.CreateConstIterator(); RotationIt; ++RotationIt)
+        {
+            Buffer.AppendQuat(*RotationIt);
+        }
+        Buffer.AppendBytes(ScaleColumn.GetData(), ScaleColumn.Num() * sizeof(FVector));
+        Buffer.AppendBytes(BoundsMinColumn.GetData(), BoundsMinColumn.Num() * sizeof(FVector));
+        Buffer.AppendBytes(BoundsMaxColumn.GetData(), BoundsMaxColumn.Num() * sizeof(FVector));
+        Buffer.AppendBytes(OcclusionColumn.GetData(), OcclusionColumn.Num() * sizeof(float));
+        Buffer.AppendBytes(FlagsColumn.GetData(), FlagsColumn.Num());
+        Buffer.AppendBytes(&Zero, FlagsPadding);
+        Buffer.AppendBytes(StringOffsets.GetData(), StringOffsets.Num() * sizeof(int32));
+        Buffer.AppendBytes(StringBytes.GetData(), StringBytes.Num());
+        Buffer.AppendBytes(&Zero, StringsPadding);
+        Buffer.AppendBytes(&Zero, RecordPadding);
+    }
+    FileWriter->Close();
+    UE_LOG(LogAutoShuffle, Log, TEXT("Appended %d products and %d strings to %s in %.2f ms"), RowsNum, StringsNum, *ManifestFileDir, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+    return true;
+}
+
+FString FAutoShuffleWindowModule::GetLayoutSnapshotFileDir(const FString& SnapshotName)
+{
+    return FPaths::Combine(*FPaths::GameDir(), TEXT("Data"), TEXT("Snapshots"), *(SnapshotName + TEXT(".snapshot")));
+}
+
+void FAutoShuffleWindowModule::BuildActorLabelIndex(UWorld* World)
+{
+    // One pass over the level. Resolving whitelist names is then a hash lookup instead of a walk over all the actors
+    ActorLabelIndex.Reset();
+    // every actor is a non-product until the whitelist is resolved, see TrackNonProductActors
+    NonProductActors.Reset();
+    VisibilityWorld = World;
+    for (TActorIterator<AActor> ActorIt(World); ActorIt; ++ActorIt)
+    {
+        NonProductActors.Add(*ActorIt);
+        FString Label = ActorIt->GetActorLabel();
+        // keep the first actor with the label, which is what the linear search used to find
+        if (ActorLabelIndex.Find(Label) == nullptr)
+        {
+            ActorLabelIndex.Add(Label, *ActorIt);
+        }
+    }
+}
+
+bool FAutoShuffleWindowModule::SkipValueInStream(TJsonReader<ANSICHAR>& Reader, EJsonNotation Notation)
+{
+    if (Notation == EJsonNotation::ObjectStart)
+    {
+        return Reader.SkipObject();
+    }
+    if (Notation == EJsonNotation::ArrayStart)
+    {
+        return Reader.SkipArray();
+    }
+    return Notation != EJsonNotation::Error;
+}
+
+bool FAutoShuffleWindowModule::ReadNumberArrayFromStream(TJsonReader<ANSICHAR>& Reader, TArray<float>& OutNumbers)
+{
+    EJsonNotation Notation;
+    while (Reader.ReadNext(Notation) && Notation != EJsonNotation::ArrayEnd)
+    {
+        if (Notation == EJsonNotation::Number)
+        {
+            OutNumbers.Add(Reader.GetValueAsNumber());
+        }
+        else if (!SkipValueInStream(Reader, Notation))
+        {
+            return false;
+        }
+    }
+    return Notation == EJsonNotation::ArrayEnd;
+}
+
+bool FAutoShuffleWindowModule::ReadShelfFromStream(TJsonReader<ANSICHAR>& Reader, FAutoShuffleShelfDescription& OutShelf)
+{
+    // The fields of a shelf may come in any order, so the shelf is only resolved when the whole whitelist is read
+    EJsonNotation Notation;
+    bool bIsValid = true;
+    while (bIsValid && Reader.ReadNext(Notation) && Notation != EJsonNotation::ObjectEnd)
+    {
+        const FString& Identifier = Reader.GetIdentifier();
+        if (Notation == EJsonNotation::String && Identifier == TEXT("Name"))
+        {
+            OutShelf.Name = Reader.GetValueAsString();
+        }
+        else if (Notation == EJsonNotation::String && Identifier == TEXT("NamePattern"))
+        {
+            OutShelf.NamePattern = Reader.GetValueAsString();
+        }
+        else if (Notation == EJsonNotation::Number && Identifier == TEXT("Scale"))
+        {
+            OutShelf.Scale = Reader.GetValueAsNumber();
+        }
+        else if (Notation == EJsonNotation::ArrayStart && Identifier == TEXT("Shelfbase"))
+        {
+            bIsValid = ReadNumberArrayFromStream(Reader, OutShelf.ShelfBase);
+        }
+        else if (Notation == EJsonNotation::ArrayStart && Identifier == TEXT("Shelfoffset"))
+        {
+            bIsValid = ReadNumberArrayFromStream(Reader, OutShelf.ShelfOffset);
+        }
+        else
+        {
+            bIsValid = SkipValueInStream(Reader, Notation);
+        }
+    }
+    return bIsValid && Notation == EJsonNotation::ObjectEnd;
+}
+
+bool FAutoShuffleWindowModule::ReadProductGroupFromStream(TJsonReader<ANSICHAR>& Reader, FAutoShuffleProductGroupDescription& OutGroup)
+{
+    // Member patterns are kept compact; only explicit members are listed
+    EJsonNotation Notation;
+    bool bIsValid = true;
+    while (bIsValid && Reader.ReadNext(Notation) && Notation != EJsonNotation::ObjectEnd)
+    {
+        const FString& Identifier = Reader.GetIdentifier();
+        if (Notation == EJsonNotation::String && Identifier == TEXT("GroupName"))
+        {
+            OutGroup.GroupName = Reader.GetValueAsString();
+        }
+        else if (Notation == EJsonNotation::String && Identifier == TEXT("ShelfName"))
+        {
+            OutGroup.ShelfName = Reader.GetValueAsString();
+        }
+        else if (Notation == EJsonNotation::Boolean && Identifier == TEXT("Discard"))
+        {
+            OutGroup.bIsDiscarded = Reader.GetValueAsBoolean();
+        }
+        else if (Notation == EJsonNotation::String && Identifier == TEXT("MemberPattern"))
+        {
+            OutGroup.MemberPattern = Reader.GetValueAsString();
+        }
+        else if (Notation == EJsonNotation::ArrayStart && Identifier == TEXT("Indices"))
+        {
+            bIsValid = ReadNumberArrayFromStream(Reader, OutGroup.Indices);
+        }
+        else if (Notation == EJsonNotation::Number && Identifier == TEXT("Scale"))
+        {
+            OutGroup.Scale = Reader.GetValueAsNumber();
+        }
+        else if (Notation == EJsonNotation::ObjectStart && Identifier == TEXT("Decomposition"))
+        {
+            // {"Accuracy": 0.5, "MaxHullVerts": 16}; what is left out follows the window
+            while (bIsValid && Reader.ReadNext(Notation) && Notation != EJsonNotation::ObjectEnd)
+            {
+                if (Notation == EJsonNotation::Number && Reader.GetIdentifier() == TEXT("Accuracy"))
+                {
+                    OutGroup.DecompositionAccuracy = Reader.GetValueAsNumber();
+                }
+                else if (Notation == EJsonNotation::Number && Reader.GetIdentifier() == TEXT("MaxHullVerts"))
+                {
+                    OutGroup.DecompositionMaxHullVerts = FMath::RoundToInt(Reader.GetValueAsNumber());
+                }
+                else
+                {
+                    bIsValid = SkipValueInStream(Reader, Notation);
+                }
+            }
+            bIsValid = bIsValid && Notation == EJsonNotation::ObjectEnd;
+        }
+        else if (Notation == EJsonNotation::ArrayStart && Identifier == TEXT("Members"))
+        {
+            while (bIsValid && Reader.ReadNext(Notation) && Notation != EJsonNotation::ArrayEnd)
+            {
+                if (Notation != EJsonNotation::ObjectStart)
+                {
+                    bIsValid = SkipValueInStream(Reader, Notation);
+                    continue;
+                }
+                FString NewName;
+                float NewScale = 1.f;
+                while (bIsValid && Reader.ReadNext(Notation) && Notation != EJsonNotation::ObjectEnd)
+                {
+                    if (Notation == EJsonNotation::String && Reader.GetIdentifier() == TEXT("Name"))
+                    {
+                        NewName = Reader.GetValueAsString();
+                    }
+                    else if (Notation == EJsonNotation::Number && Reader.GetIdentifier() == TEXT("Scale"))
+                    {
+                        NewScale = Reader.GetValueAsNumber();
+                    }
+                    else
+                    {
+                        bIsValid = SkipValueInStream(Reader, Notation);
+                    }
+                }
+                bIsValid = bIsValid && Notation == EJsonNotation::ObjectEnd;
+                OutGroup.MemberNames.Add(NewName);
+                OutGroup.MemberScales.Add(NewScale);
+            }
+            bIsValid = bIsValid && Notation == EJsonNotation::ArrayEnd;
+        }
+        else
+        {
+            bIsValid = SkipValueInStream(Reader, Notation);
+        }
+    }
+    return bIsValid && Notation == EJsonNotation::ObjectEnd;
+}
+
+void FAutoShuffleWindowModule::ResolveShelf(const FAutoShuffleShelfDescription& Shelf)
+{
+    // a shelf with "NamePattern" stands for all the shelves that the pattern expands to
+    FAutoShuffleNamePattern NamePattern;
+    if (!Shelf.NamePattern.IsEmpty() && !NamePattern.Parse(Shelf.NamePattern))
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Shelf name pattern %s is malformed"), *Shelf.NamePattern);
+        return;
+    }
+    int32 NamesNum = Shelf.NamePattern.IsEmpty() ? 1 : NamePattern.Num();
+    // all the shelves of one object share their levels
+    int32 NewFirstLevel = ProductStore.AddShelfLevels(Shelf.ShelfBase, Shelf.ShelfOffset);
+    for (int32 NameIdx = 0; NameIdx < NamesNum; ++NameIdx)
+    {
+        FString ShelfName = Shelf.NamePattern.IsEmpty() ? Shelf.Name : NamePattern.GetName(NameIdx);
+        AActor** NewObjectActor = ActorLabelIndex.Find(ShelfName);
+        if (NewObjectActor == nullptr)
+        {
+#ifdef VERBOSE_AUTO_SHUFFLE
+            UE_LOG(LogAutoShuffle, Log, TEXT("Found 0 object for %s"), *ShelfName);
+#endif
+            continue;
+        }
+#ifdef VERBOSE_AUTO_SHUFFLE
+        UE_LOG(LogAutoShuffle, Log, TEXT("Found %s for %s"), *(*NewObjectActor)->GetActorLabel(), *ShelfName);
+#endif
+        FVector NewPosition = (*NewObjectActor)->GetActorLocation();
+        ShelvesWhitelist.Add(FAutoShuffleShelf());
+        ShelvesWhitelist.Top().SetLevels(NewFirstLevel, Shelf.ShelfBase.Num());
+        ShelvesWhitelist.Top().SetName(ShelfName);
+        ShelvesWhitelist.Top().SetObjectActor(*NewObjectActor);
+        ShelvesWhitelist.Top().SetPosition(NewPosition);
+        ShelvesWhitelist.Top().SetScale(Shelf.Scale);
+    }
+}
+
+int32 FAutoShuffleWindowModule::ResolveProductGroup(const FAutoShuffleProductGroupDescription& Group)
+{
+    int32 NewFirstMember = ProductStore.Num();
+    int32 DescribedNum = Group.MemberNames.Num();
+    for (int32 MemberIdx = 0; MemberIdx < Group.MemberNames.Num(); ++MemberIdx)
+    {
+        AddProductMember(Group.MemberNames[MemberIdx], Group.MemberScales[MemberIdx]);
+    }
+    // Expand the compact member descriptor. Names are generated one at a time and only resolved members are kept
+    if (!Group.MemberPattern.IsEmpty())
+    {
+        FAutoShuffleNamePattern MemberPattern;
+        if (MemberPattern.Parse(Group.MemberPattern))
+        {
+            if (Group.Indices.Num() > 0)
+            {
+                MemberPattern.SetIndices(Group.Indices);
+            }
+            DescribedNum += MemberPattern.Num();
+            for (int32 NameIdx = 0; NameIdx < MemberPattern.Num(); ++NameIdx)
+            {
+                AddProductMember(MemberPattern.GetName(NameIdx), Group.Scale);
+            }
+        }
+        else
+        {
+            UE_LOG(LogAutoShuffle, Warning, TEXT("Member pattern %s of group %s is malformed"), *Group.MemberPattern, *Group.GroupName);
+        }
+    }
+    if (Group.bIsDiscarded)
+    {
+        for (int32 ProductIdx = NewFirstMember; ProductIdx < ProductStore.Num(); ++ProductIdx)
+        {
+            ProductStore.Discard(ProductIdx);
+        }
+    }
+    FString NewGroupName = Group.GroupName, NewShelfName = Group.ShelfName;
+    ProductsWhitelist.Add(FAutoShuffleProductGroup());
+    ProductsWhitelist.Top().SetName(NewGroupName);
+    ProductsWhitelist.Top().SetMembers(NewFirstMember, ProductStore.Num() - NewFirstMember);
+    ProductsWhitelist.Top().SetShelfName(NewShelfName);
+    ProductsWhitelist.Top().SetDecompositionPreset(Group.DecompositionAccuracy, Group.DecompositionMaxHullVerts);
+    if (Group.bIsDiscarded)
+    {
+        ProductsWhitelist.Top().Discard();
+    }
+    return DescribedNum - (ProductStore.Num() - NewFirstMember);
+}
+
+void FAutoShuffleWindowModule::AddProductMember(const FString& NewName, float NewScale)
+{
+    AActor** NewObjectActor = ActorLabelIndex.Find(NewName);
+    if (NewObjectActor == nullptr)
+    {
+#ifdef VERBOSE_AUTO_SHUFFLE
+        UE_LOG(LogAutoShuffle, Log, TEXT("Found 0 Object for %s"), *NewName);
+#endif
+        return;
+    }
+#ifdef VERBOSE_AUTO_SHUFFLE
+    UE_LOG(LogAutoShuffle, Log, TEXT("Found %s for %s"), *(*NewObjectActor)->GetActorLabel(), *NewName);
+#endif
+    ProductStore.AddProduct(FName(*NewName), *NewObjectActor, NewScale);
+}
+
+bool FAutoShuffleWindowModule::ReadStringArrayFromStream(TJsonReader<ANSICHAR>& Reader, TArray<FString>& OutStrings)
+{
+    EJsonNotation Notation;
+    while (Reader.ReadNext(Notation) && Notation != EJsonNotation::ArrayEnd)
+    {
+        if (Notation == EJsonNotation::String)
+        {
+            OutStrings.Add(Reader.GetValueAsString());
+        }
+        else if (!SkipValueInStream(Reader, Notation))
+        {
+            return false;
+        }
+    }
+    return Notation == EJsonNotation::ArrayEnd;
+}
+
+bool FAutoShuffleWindowModule::ReadDiscoveryFromStream(TJsonReader<ANSICHAR>& Reader, FAutoShuffleDiscoverySettings& OutSettings)
+{
+    OutSettings.bIsEnabled = true;
+    EJsonNotation Notation;
+    bool bIsValid = true;
+    while (bIsValid && Reader.ReadNext(Notation) && Notation != EJsonNotation::ObjectEnd)
+    {
+        const FString& Identifier = Reader.GetIdentifier();
+        if (Notation == EJsonNotation::Boolean && Identifier == TEXT("Enabled"))
+        {
+            OutSettings.bIsEnabled = Reader.GetValueAsBoolean();
+        }
+        else if (Notation == EJsonNotation::String && Identifier == TEXT("GroupBy"))
+        {
+            OutSettings.bGroupByMesh = Reader.GetValueAsString() == TEXT("Mesh");
+        }
+        else if (Notation == EJsonNotation::String && Identifier == TEXT("ShelfAssignment"))
+        {
+            OutSettings.bAssignByRules = Reader.GetValueAsString() == TEXT("Rules");
+        }
+        else if (Notation == EJsonNotation::ArrayStart && Identifier == TEXT("Include"))
+        {
+            bIsValid = ReadStringArrayFromStream(Reader, OutSettings.IncludePrefixes);
+        }
+        else if (Notation == EJsonNotation::ArrayStart && Identifier == TEXT("Rules"))
+        {
+            // each rule is {"Prefix": "chips_pringles", "ShelfName": "BP_ShelfMain_001"}
+            while (bIsValid && Reader.ReadNext(Notation) && Notation != EJsonNotation::ArrayEnd)
+            {
+                if (Notation != EJsonNotation::ObjectStart)
+                {
+                    bIsValid = SkipValueInStream(Reader, Notation);
+                    continue;
+                }
+                FString Prefix, ShelfName;
+                while (bIsValid && Reader.ReadNext(Notation) && Notation != EJsonNotation::ObjectEnd)
+                {
+                    if (Notation == EJsonNotation::String && Reader.GetIdentifier() == TEXT("Prefix"))
+                    {
+                        Prefix = Reader.GetValueAsString();
+                    }
+                    else if (Notation == EJsonNotation::String && Reader.GetIdentifier() == TEXT("ShelfName"))
+                    {
+                        ShelfName = Reader.GetValueAsString();
+                    }
+                    else
+                    {
+                        bIsValid = SkipValueInStream(Reader, Notation);
+                    }
+                }
+                bIsValid = bIsValid && Notation == EJsonNotation::ObjectEnd;
+                OutSettings.RulePrefixes.Add(Prefix);
+                OutSettings.RuleShelfNames.Add(ShelfName);
+            }
+            bIsValid = bIsValid && Notation == EJsonNotation::ArrayEnd;
+        }
+        else if (Notation == EJsonNotation::Number && Identifier == TEXT("MinMembers"))
+        {
+            OutSettings.MinMembers = FMath::RoundToInt(Reader.GetValueAsNumber());
+        }
+        else if (Notation == EJsonNotation::Number && Identifier == TEXT("Scale"))
+        {
+            OutSettings.Scale = Reader.GetValueAsNumber();
+        }
+        else if (Notation == EJsonNotation::String && Identifier == TEXT("Output"))
+        {
+            OutSettings.Output = Reader.GetValueAsString();
+        }
+        else
+        {
+            bIsValid = SkipValueInStream(Reader, Notation);
+        }
+    }
+    return bIsValid && Notation == EJsonNotation::ObjectEnd;
+}
+
+int32 FAutoShuffleWindowModule::DiscoverProductGroups(const FAutoShuffleDiscoverySettings& Settings)
+{
+    /** Group the static mesh actors of the level into product groups and add them to ProductsWhitelist
+     *  @note actors that are already shelves or members of the whitelist are left alone
+     *  @note the pass goes over ActorLabelIndex, so the level itself is not walked again
+     */
+    TSet<AActor*> ClaimedActors;
+    for (auto ShelfIt = ShelvesWhitelist.CreateIterator(); ShelfIt; ++ShelfIt)
+    {
+        ClaimedActors.Add(ShelfIt->GetObjectActor());
+    }
+    for (int32 ProductIdx = 0; ProductIdx < ProductStore.Num(); ++ProductIdx)
+    {
+        ClaimedActors.Add(ProductStore.GetObjectActor(ProductIdx));
+    }
+    TMap<FString, TArray<AStaticMeshActor*>> DiscoveredGroups;
+    for (auto LabelIt = ActorLabelIndex.CreateConstIterator(); LabelIt; ++LabelIt)
+    {
+        AStaticMeshActor* StaticMeshActor = Cast<AStaticMeshActor>(LabelIt.Value());
+        if (!StaticMeshActor || ClaimedActors.Contains(StaticMeshActor))
+        {
+            continue;
+        }
+        const FString& Label = LabelIt.Key();
+        bool bIsIncluded = Settings.IncludePrefixes.Num() == 0;
+        for (auto PrefixIt = Settings.IncludePrefixes.CreateConstIterator(); PrefixIt && !bIsIncluded; ++PrefixIt)
+        {
+            bIsIncluded = Label.StartsWith(*PrefixIt);
+        }
+        if (!bIsIncluded)
+        {
+            continue;
+        }
+        FString GroupName;
+        if (Settings.bGroupByMesh)
+        {
+            UStaticMeshComponent* StaticMeshComponent = StaticMeshActor->GetStaticMeshComponent();
+            if (!StaticMeshComponent || !StaticMeshComponent->GetStaticMesh())
+            {
+                continue;
+            }
+            GroupName = StaticMeshComponent->GetStaticMesh()->GetName();
+        }
+        else
+        {
+            // product instances are labelled GroupName_NNN; anything else is not a product
+            int32 SuffixIdx = Label.Len();
+            while (SuffixIdx > 0 && FChar::IsDigit(Label[SuffixIdx - 1]))
+            {
+                --SuffixIdx;
+            }
+            if (SuffixIdx == Label.Len() || SuffixIdx < 2 || Label[SuffixIdx - 1] != TEXT('_'))
+            {
+                continue;
+            }
+            GroupName = Label.Left(SuffixIdx - 1);
+        }
+        DiscoveredGroups.FindOrAdd(GroupName).Add(StaticMeshActor);
+    }
+    DiscoveredGroups.KeySort(TLess<FString>());
+    int32 DiscoveredGroupsNum = 0, DiscoveredProductsNum = 0;
+    for (auto GroupIt = DiscoveredGroups.CreateIterator(); GroupIt; ++GroupIt)
+    {
+        TArray<AStaticMeshActor*>& GroupActors = GroupIt.Value();
+        if (GroupActors.Num() < Settings.MinMembers)
+        {
+            continue;
+        }
+        GroupActors.Sort([](const AStaticMeshActor& Actor1, const AStaticMeshActor& Actor2)
+        {
+            return Actor1.GetActorLabel() < Actor2.GetActorLabel();
+        });
+        FString ShelfName;
+        if (Settings.bAssignByRules)
+        {
+            for (int32 RuleIdx = 0; RuleIdx < Settings.RulePrefixes.Num(); ++RuleIdx)
+            {
+                if (GroupIt.Key().StartsWith(Settings.RulePrefixes[RuleIdx]))
+                {
+                    ShelfName = Settings.RuleShelfNames[RuleIdx];
+                    break;
+                }
+            }
+        }
+        // by proximity, or for the groups that no rule matches: the shelf closest to the centroid of the group
+        if (ShelfName.IsEmpty())
+        {
+            FVector Centroid(0.f, 0.f, 0.f);
+            for (auto ActorIt = GroupActors.CreateConstIterator(); ActorIt; ++ActorIt)
+            {
+                Centroid += (*ActorIt)->GetActorLocation();
+            }
+            Centroid /= GroupActors.Num();
+            float ClosestDistSquared = BIG_NUMBER;
+            for (auto ShelfIt = ShelvesWhitelist.CreateIterator(); ShelfIt; ++ShelfIt)
+            {
+                FVector ShelfOrigin, ShelfExtent;
+                ShelfIt->GetObjectActor()->GetActorBounds(false, ShelfOrigin, ShelfExtent);
+                float DistSquared = FBox(ShelfOrigin - ShelfExtent, ShelfOrigin + ShelfExtent).ComputeSquaredDistanceToPoint(Centroid);
+                if (DistSquared < ClosestDistSquared)
+                {
+                    ClosestDistSquared = DistSquared;
+                    ShelfName = ShelfIt->GetName();
+                }
+            }
+        }
+        if (ShelfName.IsEmpty())
+        {
+            UE_LOG(LogAutoShuffle, Warning, TEXT("No shelf for discovered group %s"), *GroupIt.Key());
+            continue;
+        }
+        int32 NewFirstMember = ProductStore.Num();
+        for (auto ActorIt = GroupActors.CreateConstIterator(); ActorIt; ++ActorIt)
+        {
+            ProductStore.AddProduct(FName(*(*ActorIt)->GetActorLabel()), *ActorIt, Settings.Scale);
+        }
+        FString NewGroupName = GroupIt.Key();
+        ProductsWhitelist.Add(FAutoShuffleProductGroup());
+        ProductsWhitelist.Top().SetName(NewGroupName);
+        ProductsWhitelist.Top().SetMembers(NewFirstMember, GroupActors.Num());
+        ProductsWhitelist.Top().SetShelfName(ShelfName);
+#ifdef VERBOSE_AUTO_SHUFFLE
+        UE_LOG(LogAutoShuffle, Log, TEXT("Discovered group %s of %d products on %s"), *NewGroupName, GroupActors.Num(), *ShelfName);
+#endif
+        DiscoveredGroupsNum += 1;
+        DiscoveredProductsNum += GroupActors.Num();
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("Discovered %d Products Group with %d Products"), DiscoveredGroupsNum, DiscoveredProductsNum);
+    return DiscoveredGroupsNum;
+}
+
+void FAutoShuffleWindowModule::WriteWhitelist(const FString& FileDir)
+{
+    // Written as plain ASCII so that ReadWhitelist can read the file back
+    TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*FileDir));
+    if (!FileWriter.IsValid())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist file '%s' could not be written."), *FileDir);
+        return;
+    }
+    typedef TJsonWriter<ANSICHAR, TPrettyJsonPrintPolicy<ANSICHAR>> FWhitelistJsonWriter;
+    TSharedRef<FWhitelistJsonWriter> Writer = TJsonWriterFactory<ANSICHAR, TPrettyJsonPrintPolicy<ANSICHAR>>::Create(FileWriter.Get());
+    Writer->WriteObjectStart();
+    Writer->WriteObjectStart(TEXT("Whitelist"));
+    Writer->WriteArrayStart(TEXT("Shelves"));
+    for (auto ShelfIt = ShelvesWhitelist.CreateIterator(); ShelfIt; ++ShelfIt)
+    {
+        Writer->WriteObjectStart();
+        Writer->WriteValue(TEXT("Name"), ShelfIt->GetName());
+        Writer->WriteValue(TEXT("Scale"), ShelfIt->GetScale());
+        Writer->WriteArrayStart(TEXT("Shelfbase"));
+        for (int32 LevelIdx = ShelfIt->GetFirstLevel(); LevelIdx < ShelfIt->GetFirstLevel() + ShelfIt->GetLevelsNum(); ++LevelIdx)
+        {
+            Writer->WriteValue(ProductStore.GetLevelBase(LevelIdx));
+        }
+        Writer->WriteArrayEnd();
+        Writer->WriteArrayStart(TEXT("Shelfoffset"));
+        for (int32 LevelIdx = ShelfIt->GetFirstLevel(); LevelIdx < ShelfIt->GetFirstLevel() + ShelfIt->GetLevelsNum(); ++LevelIdx)
+        {
+            Writer->WriteValue(ProductStore.GetLevelOffset(LevelIdx));
+        }
+        Writer->WriteArrayEnd();
+        Writer->WriteObjectEnd();
+    }
+    Writer->WriteArrayEnd();
+    Writer->WriteArrayStart(TEXT("Products"));
+    for (auto GroupIt = ProductsWhitelist.CreateIterator(); GroupIt; ++GroupIt)
+    {
+        Writer->WriteObjectStart();
+        Writer->WriteValue(TEXT("GroupName"), GroupIt->GetName());
+        Writer->WriteValue(TEXT("ShelfName"), GroupIt->GetShelfName());
+        Writer->WriteValue(TEXT("Discard"), GroupIt->IsDiscarded());
+        if (GroupIt->HasDecompositionPreset())
+        {
+            Writer->WriteObjectStart(TEXT("Decomposition"));
+            if (GroupIt->GetDecompositionAccuracy(-1.f) >= 0.f)
+            {
+                Writer->WriteValue(TEXT("Accuracy"), GroupIt->GetDecompositionAccuracy(-1.f));
+            }
+            if (GroupIt->GetDecompositionMaxHullVerts(0) > 0)
+            {
+                Writer->WriteValue(TEXT("MaxHullVerts"), GroupIt->GetDecompositionMaxHullVerts(0));
+            }
+            Writer->WriteObjectEnd();
+        }
+        Writer->WriteArrayStart(TEXT("Members"));
+        for (int32 ProductIdx = GroupIt->GetFirstMember(); ProductIdx < GroupIt->GetMembersEnd(); ++ProductIdx)
+        {
+            Writer->WriteObjectStart();
+            Writer->WriteValue(TEXT("Name"), ProductStore.GetName(ProductIdx).ToString());
+            Writer->WriteValue(TEXT("Scale"), ProductStore.GetScale(ProductIdx));
+            Writer->WriteObjectEnd();
+        }
+        Writer->WriteArrayEnd();
+        Writer->WriteObjectEnd();
+    }
+    Writer->WriteArrayEnd();
+    Writer->WriteObjectEnd();
+    Writer->WriteObjectEnd();
+    Writer->Close();
+    UE_LOG(LogAutoShuffle, Log, TEXT("Whitelist written to %s"), *FileDir);
+}
+
+bool FAutoShuffleWindowModule::ReadWhitelist()
+{
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_ReadWhitelist);
+    FAutoShufflePhaseScope PhaseScope(RunTimings, TEXT("ReadWhitelist"));
+    // Always read the list even if the whitelists have been initialized
+    // This is to make sure that changes of the configurations can be directly reflected every time the button is clicked
+    FAutoShuffleWhitelistDescription Whitelist;
+    if (!ParseWhitelist(GetWhitelistFileDir(), Whitelist, nullptr))
+    {
+        return false;
+    }
+    return ResolveWhitelist(Whitelist);
+}
+
+bool FAutoShuffleWindowModule::IsSessionCurrent()
+{
+    // the whitelist is resolved against the label index of the world it was last read in
+    return ProductStore.Num() > 0 && VisibilityWorld.IsValid() && VisibilityWorld.Get() == GetTargetWorld();
+}
+
+FString FAutoShuffleWindowModule::GetWhitelistFileDir()
+{
+    FString PluginDir = FPaths::Combine(*FPaths::GamePluginsDir(), TEXT("AutoShuffleWindow"));
+    FString ResourseDir = FPaths::Combine(*PluginDir, TEXT("Resources"));
+    return FPaths::Combine(*ResourseDir, TEXT("Whitelist.json"));
+}
+
+bool FAutoShuffleWindowModule::ParseWhitelist(const FString& FileDir, FAutoShuffleWhitelistDescription& OutWhitelist, FThreadSafeCounter* BytesRead)
+{
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_ParseWhitelist);
+    // Only the file and the description are touched here, so this may run on any thread
+    // The whitelist is read token by token straight from the file. No Json object tree is kept in memory.
+    // @note the whitelist is expected in ASCII (or UTF-8 without multi-byte names), which is what WhitelistGen.py writes
+    TUniquePtr<FArchive> FileReader(IFileManager::Get().CreateFileReader(*FileDir));
+    if (!FileReader.IsValid())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist file '%s' could not be opened. Module quites."), *FileDir);
+        return false;
+    }
+    TSharedRef<TJsonReader<ANSICHAR>> Reader = TJsonReaderFactory<ANSICHAR>::Create(FileReader.Get());
+    
+    // Start reading JsonObject "Whitelist"
+    EJsonNotation Notation;
+    if (!Reader->ReadNext(Notation) || Notation != EJsonNotation::ObjectStart)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Nothing to shuffle. Module quites."));
+        return false;
+    }
+    bool bIsValid = true, bHasWhitelist = false, bHasShelves = false, bHasProducts = false;
+    while (bIsValid && Reader->ReadNext(Notation) && Notation != EJsonNotation::ObjectEnd)
+    {
+        if (Notation != EJsonNotation::ObjectStart || Reader->GetIdentifier() != TEXT("Whitelist"))
+        {
+            bIsValid = SkipValueInStream(*Reader, Notation);
+            continue;
+        }
+        UE_LOG(LogAutoShuffle, Log, TEXT("Reading Whitelist..."));
+        bHasWhitelist = true;
+        while (bIsValid && Reader->ReadNext(Notation) && Notation != EJsonNotation::ObjectEnd)
+        {
+            // Start reading JsonArray "Shelves"
+            if (Notation == EJsonNotation::ArrayStart && Reader->GetIdentifier() == TEXT("Shelves"))
+            {
+                UE_LOG(LogAutoShuffle, Log, TEXT("Reading Shelves..."));
+                bHasShelves = true;
+                while (bIsValid && Reader->ReadNext(Notation) && Notation != EJsonNotation::ArrayEnd)
+                {
+                    if (Notation == EJsonNotation::ObjectStart)
+                    {
+                        bIsValid = ReadShelfFromStream(*Reader, OutWhitelist.Shelves[OutWhitelist.Shelves.AddDefaulted()]);
+                    }
+                    else
+                    {
+                        bIsValid = SkipValueInStream(*Reader, Notation);
+                    }
+                }
+            }
+            // Start reading JsonArray "Products"
+            else if (Notation == EJsonNotation::ArrayStart && Reader->GetIdentifier() == TEXT("Products"))
+            {
+                UE_LOG(LogAutoShuffle, Log, TEXT("Reading Products..."));
+                bHasProducts = true;
+                while (bIsValid && Reader->ReadNext(Notation) && Notation != EJsonNotation::ArrayEnd)
+                {
+                    if (Notation == EJsonNotation::ObjectStart)
+                    {
+                        bIsValid = ReadProductGroupFromStream(*Reader, OutWhitelist.ProductGroups[OutWhitelist.ProductGroups.AddDefaulted()]);
+                        if (BytesRead)
+                        {
+                            BytesRead->Set(FileReader->Tell());
+                        }
+                    }
+                    else
+                    {
+                        bIsValid = SkipValueInStream(*Reader, Notation);
+                    }
+                }
+            }
+            // Start reading JsonObject "Discovery". It is applied after the whole stream because it needs the shelves
+            else if (Notation == EJsonNotation::ObjectStart && Reader->GetIdentifier() == TEXT("Discovery"))
+            {
+                bIsValid = ReadDiscoveryFromStream(*Reader, OutWhitelist.Discovery);
+            }
+            else
+            {
+                bIsValid = SkipValueInStream(*Reader, Notation);
+            }
+        }
+    }
+    if (!bIsValid || Notation == EJsonNotation::Error)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Faled to parse whitelist file '%s'. Error: '%s'"), *FileDir, *Reader->GetErrorMessage());
+        return false;
+    }
+    if (!bHasWhitelist)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist reading failed. Module quites."));
+        return false;
+    }
+    if (!bHasShelves)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Shelves reading failed. Module quits."));
+        return false;
+    }
+    if (!bHasProducts && !OutWhitelist.Discovery.bIsEnabled)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Products reading failed. Module quits."));
+        return false;
+    }
+    if (BytesRead)
+    {
+        BytesRead->Set(FileReader->TotalSize());
+    }
+    return true;
+}
+
+bool FAutoShuffleWindowModule::ResolveWhitelist(const FAutoShuffleWhitelistDescription& Whitelist)
+{
+    // a running shuffle steps through the store; it must not change under it
+    if (ShuffleTickerHandle.IsValid())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("A shuffle is running. Cancel it or wait for it to finish before reading the whitelist."));
+        return false;
+    }
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_ResolveWhitelist);
+    // The whitelists and the store are reset rather than freed, so reading again reuses their memory
+    ShelvesWhitelist.Reset();
+    ProductsWhitelist.Reset();
+    ProductStore.Reset();
+    UnresolvedGroups.Reset();
+    auto EditorWorld = GetTargetWorld();
+    // NOTE: EditorWorld must do InitializeActorsForPlay to make overlapping detection work
+    if (!EditorWorld->AreActorsInitialized())
+    {
+        FURL URL;
+        EditorWorld->InitializeActorsForPlay(URL);
+    }
+    BuildActorLabelIndex(EditorWorld);
+    for (auto ShelfIt = Whitelist.Shelves.CreateConstIterator(); ShelfIt; ++ShelfIt)
+    {
+        ResolveShelf(*ShelfIt);
+    }
+    ProductStore.SetDiscardPool(GetDiscardPoolOrigin());
+    for (auto GroupIt = Whitelist.ProductGroups.CreateConstIterator(); GroupIt; ++GroupIt)
+    {
+        int32 MissingNum = ResolveProductGroup(*GroupIt);
+        if (MissingNum > 0)
+        {
+            UnresolvedGroups.Add(GroupIt->GroupName);
+            UE_LOG(LogAutoShuffle, Warning, TEXT("%d members of product group %s not found in the level"), MissingNum, *GroupIt->GroupName);
+        }
+    }
+    int32 ProductsNum = Whitelist.ProductGroups.Num();
+    if (Whitelist.Discovery.bIsEnabled)
+    {
+        ProductsNum += DiscoverProductGroups(Whitelist.Discovery);
+        if (!Whitelist.Discovery.Output.IsEmpty())
+        {
+            WriteWhitelist(FPaths::Combine(*FPaths::GetPath(GetWhitelistFileDir()), *Whitelist.Discovery.Output));
+        }
+    }
+    
+#ifdef VERBOSE_AUTO_SHUFFLE
+    for (auto ShelfIt = ShelvesWhitelist.CreateIterator(); ShelfIt; ++ShelfIt)
+    {
+        UE_LOG(LogAutoShuffle, Log, TEXT("Shelf: %s in Scale: %f"), *(ShelfIt->GetName()), ShelfIt->GetScale());
+        for (int32 LevelIdx = ShelfIt->GetFirstLevel(); LevelIdx < ShelfIt->GetFirstLevel() + ShelfIt->GetLevelsNum(); ++LevelIdx)
+        {
+            UE_LOG(LogAutoShuffle, Log, TEXT("Shelfbase: %f"), ProductStore.GetLevelBase(LevelIdx));
+        }
+    }
+    for (auto GroupIt = ProductsWhitelist.CreateIterator(); GroupIt; ++GroupIt)
+    {
+        UE_LOG(LogAutoShuffle, Log, TEXT("Product Group: %s"), *(GroupIt->GetName()));
+        for (int32 ProductIdx = GroupIt->GetFirstMember(); ProductIdx < GroupIt->GetMembersEnd(); ++ProductIdx)
+        {
+            UE_LOG(LogAutoShuffle, Log, TEXT("Product Name: %s in Scale: %f"), *ProductStore.GetName(ProductIdx).ToString(), ProductStore.GetScale(ProductIdx));
+        }
+    }
+#endif
+    
+    // the products of discarded groups go to the discard pool now rather than at the next shuffle
+    ProductStore.CommitTransforms();
+    TrackNonProductActors();
+    UE_LOG(LogAutoShuffle, Log, TEXT("Collected %d Shelves and %d Products Group"), Whitelist.Shelves.Num(), ProductsNum);
+    
+    return true;
+}
+
+FVector FAutoShuffleWindowModule::GetDiscardPoolOrigin()
+{
+    // The pool grid grows in x and y, so lying under all the shelves keeps it out of the rendering border of the occlusion
+    FBox ShelvesBounds(ForceInit);
+    for (auto ShelfIt = ShelvesWhitelist.CreateIterator(); ShelfIt; ++ShelfIt)
+    {
+        FVector ShelfOrigin, ShelfExtent;
+        ShelfIt->GetObjectActor()->GetActorBounds(false, ShelfOrigin, ShelfExtent);
+        ShelvesBounds += FBox(ShelfOrigin - ShelfExtent, ShelfOrigin + ShelfExtent);
+    }
+    FVector PoolOrigin = DiscardedProductsRegions;
+    if (ShelvesBounds.IsValid)
+    {
+        PoolOrigin.Z = FMath::Min(PoolOrigin.Z, ShelvesBounds.Min.Z - AUTO_SHUFFLE_DISCARD_POOL_SPACING);
+    }
+    return PoolOrigin;
+}
+
+void FAutoShuffleWindowModule::ReadWhitelistAsync(FSimpleDelegate OnResolved)
+{
+    if (WhitelistTickerHandle.IsValid())
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("The whitelist is already being read."));
+        return;
+    }
+    FString FileDir = GetWhitelistFileDir();
+    RunTimings.Reset();
+    WhitelistReadStartTime = FPlatformTime::Seconds();
+    WhitelistFileSize = FMath::Max<int64>(IFileManager::Get().FileSize(*FileDir), 1);
+    WhitelistBytesRead.Reset();
+    PendingWhitelist = MakeShareable(new FAutoShuffleWhitelistDescription());
+    OnWhitelistResolved = OnResolved;
+    FNotificationInfo Info(FText::FromString(TEXT("Reading whitelist...")));
+    Info.bFireAndForget = false;
+    WhitelistNotification = FSlateNotificationManager::Get().AddNotification(Info);
+    if (WhitelistNotification.IsValid())
+    {
+        WhitelistNotification->SetCompletionState(SNotificationItem::CS_Pending);
+    }
+    // the description is owned by both the task and the module until the task ends
+    TSharedPtr<FAutoShuffleWhitelistDescription, ESPMode::ThreadSafe> Whitelist = PendingWhitelist;
+    WhitelistParseResult = Async<bool>(EAsyncExecution::ThreadPool, [FileDir, Whitelist]()
+    {
+        return ParseWhitelist(FileDir, *Whitelist, &WhitelistBytesRead);
+    });
+    WhitelistTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&FAutoShuffleWindowModule::TickWhitelistAsync));
+}
+
+bool FAutoShuffleWindowModule::TickWhitelistAsync(float DeltaTime)
+{
+    if (!WhitelistParseResult.IsReady())
+    {
+        if (WhitelistNotification.IsValid())
+        {
+            int32 Percent = FMath::Clamp<int32>(100 * (int64)WhitelistBytesRead.GetValue() / WhitelistFileSize, 0, 100);
+            WhitelistNotification->SetText(FText::FromString(FString::Printf(TEXT("Reading whitelist... %d%%"), Percent)));
+        }
+        return true;
+    }
+    // only the actor resolution runs on the game thread
+    bool Result = WhitelistParseResult.Get() && ResolveWhitelist(*PendingWhitelist);
+    RunTimings.Add(TEXT("ReadWhitelist"), FPlatformTime::Seconds() - WhitelistReadStartTime);
+    PendingWhitelist.Reset();
+    WhitelistTickerHandle.Reset();
+    if (WhitelistNotification.IsValid())
+    {
+        FString Message;
+        if (!Result)
+        {
+            Message = TEXT("Whitelist read wrong. See the log.");
+        }
+        else if (UnresolvedGroups.Num() > 0)
+        {
+            Message = FString::Printf(TEXT("%d groups not fully resolved: %s"), UnresolvedGroups.Num(), *FString::Join(UnresolvedGroups, TEXT(", ")));
+        }
+        else
+        {
+            Message = FString::Printf(TEXT("Whitelist read: %d shelves, %d products"), ShelvesWhitelist.Num(), ProductStore.Num());
+        }
+        WhitelistNotification->SetText(FText::FromString(Message));
+        WhitelistNotification->SetCompletionState(Result && UnresolvedGroups.Num() == 0 ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
+        WhitelistNotification->ExpireAndFadeout();
+        WhitelistNotification.Reset();
+    }
+    if (!Result)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Whitelist read wrong. Module quits."));
+        return false;
+    }
+    OnWhitelistResolved.ExecuteIfBound();
+    return false;
+}
+
+void FAutoShuffleWindowModule::AddNoiseToShelf(const FString& ShelfName, float NoiseScale)
+{
+    // Get the first shelf's name and its presumably fixed Position.Z
+    if (FAutoShuffleWindowModule::ShelvesWhitelist.Num() < 1)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("No shelves loaded."));
+        return;
+    }
+    FAutoShuffleShelf& FirstShelf = FAutoShuffleWindowModule::ShelvesWhitelist.operator[](0);
+    FString Name = FirstShelf.GetName();
+    FVector RefPosition = FirstShelf.GetPosition();
+    if (Name == ShelfName)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Shelf %s is fixed."), *Name);
+        return;
+    }
+    FAutoShuffleShelf* ShelfToChange = nullptr;
+    for (auto ShelfIt = ShelvesWhitelist.CreateIterator(); ShelfIt; ++ShelfIt)
+    {
+        if (ShelfIt->GetName() == ShelfName)
+        {
+            ShelfToChange = &*ShelfIt;
+            break;
+        }
+    }
+    if (ShelfToChange == nullptr)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("No shelf matches the name %s"), *ShelfName);
+        return;
+    }
+    FVector NewPosition = ShelfToChange->GetPosition();
+    NewPosition.Z = RefPosition.Z - NoiseScale * (float(FMath::Rand()) / RAND_MAX);
+    ShelfToChange->SetPosition(NewPosition);
+}
+
+TSharedPtr<FJsonObject> FAutoShuffleWindowModule::ParseJSON(const FString& FileContents, const FString& NameForErrors, bool bSilent)
+{
+    // Parsing source code from:
+    // https://github.com/EpicGames/UnrealEngine/blob/master/Engine/Plugins/2D/Paper2D/Source/PaperSpriteSheetImporter/Private/PaperJsonSpriteSheetImporter.cpp
+    if (!FileContents.IsEmpty())
+    {
+        const TSharedRef<TJsonReader<>>& Reader = TJsonReaderFactory<>::Create(FileContents);
+        TSharedPtr<FJsonObject> SpriteDescriptorObject;
+        if (FJsonSerializer::Deserialize(Reader, SpriteDescriptorObject) && SpriteDescriptorObject.IsValid())
+        {
+            // File was loaded and deserialized OK!
+            return SpriteDescriptorObject;
+        }
+        else
+        {
+            if (!bSilent)
+            {
+                UE_LOG(LogAutoShuffle, Warning, TEXT("Faled to parse sprite descriptor file '%s'. Error: '%s'"), *NameForErrors, *Reader->GetErrorMessage());
+            }
+            return nullptr;
+        }
+    }
+    else
+    {
+        if (!bSilent)
+        {
+            UE_LOG(LogAutoShuffle, Warning, TEXT("Sprite descriptor file '%s' was empty. This sprite cannot be imported."), *NameForErrors);
+        }
+        return nullptr;
+    }
+}
+
+bool FAutoShuffleWindowModule::StepPlaceProductGroup(int32 ShelfIdx, int32 GroupIdx, float Density, float Proxmity)
+{
+    // the first step sets the group up, or finds that it is not placed on the shelf
+    if (GroupPlacement.ShelfIdx != ShelfIdx || GroupPlacement.GroupIdx != GroupIdx)
+    {
+        return !BeginPlaceProductGroup(ShelfIdx, GroupIdx, Density);
+    }
+    FAutoShuffleProductGroup& Group = ProductsWhitelist[GroupIdx];
+    if (GroupPlacement.NextMemberIdx < Group.GetMembersEnd() - Group.GetFirstMember())
+    {
+        PlaceNextProduct(Proxmity);
+        return false;
+    }
+    // the products are pushed together after the last member, one product a step
+    if (bIsOrganizeChecked && bIsPerGroupChecked && !StepOrganizeProducts())
+    {
+        return false;
+    }
+    GroupPlacement.Reset();
+    return true;
+}
+
+bool FAutoShuffleWindowModule::BeginPlaceProductGroup(int32 ShelfIdx, int32 GroupIdx, float Density)
+{
+    FAutoShuffleShelf& Shelf = ShelvesWhitelist[ShelfIdx];
+    FAutoShuffleProductGroup& Group = ProductsWhitelist[GroupIdx];
+    // check if the name of the shelf that this group belongs to match the current shelf name
+    if (Group.GetShelfName() != Shelf.GetName())
+    {
+        return false;
+    }
+    // check if the whole group of products have been discarded in whitelist
+    if (Group.IsDiscarded())
+    {
+        return false;
+    }
+    // find the bounding box of the shelf and the longest between x and y as the places for products to enter from
+    FAutoShuffleGroupPlacement& Placement = GroupPlacement;
+    Placement.Reset();
+    Placement.ShelfIdx = ShelfIdx;
+    Placement.GroupIdx = GroupIdx;
+    FVector& BoundingBoxOrigin = Placement.BoundingBoxOrigin;
+    FVector& BoundingBoxExtent = Placement.BoundingBoxExtent;
+    Shelf.GetObjectActor()->GetActorBounds(false, BoundingBoxOrigin, BoundingBoxExtent);
+#ifdef VERBOSE_AUTO_SHUFFLE
+    UE_LOG(LogAutoShuffle, Log, TEXT("Shelf %s has bounding box %s, %s"), *Shelf.GetName(), *BoundingBoxOrigin.ToString(), *BoundingBoxExtent.ToString());
+#endif
+    // find the Z-values of shelf bases
+    TArray<float>& ShelfBaseZ = Placement.ShelfBaseZ;
+    for (int32 LevelIdx = Shelf.GetFirstLevel(); LevelIdx < Shelf.GetFirstLevel() + Shelf.GetLevelsNum(); ++LevelIdx)
+    {
+        ShelfBaseZ.Add(ProductStore.GetLevelBase(LevelIdx) * BoundingBoxExtent.Z * 2.f + BoundingBoxOrigin.Z - BoundingBoxExtent.Z);
+    }
+    // find the Z offset of shelf bases
+    TArray<float>& ShelfOffsetZ = Placement.ShelfOffsetZ;
+    for (int32 LevelIdx = Shelf.GetFirstLevel(); LevelIdx < Shelf.GetFirstLevel() + Shelf.GetLevelsNum(); ++LevelIdx)
+    {
+        ShelfOffsetZ.Add(ProductStore.GetLevelOffset(LevelIdx) * BoundingBoxExtent.Z * 2.f);
+    }
+#ifdef VERBOSE_AUTO_SHUFFLE
+    for (auto ShelfBaseIt = ShelfBaseZ.CreateIterator(); ShelfBaseIt; ++ShelfBaseIt)
+    {
+        UE_LOG(LogAutoShuffle, Log, TEXT("The real Z values of shelf %s: %f"), *Shelf.GetName(), *ShelfBaseIt);
+    }
+#endif
+    // the footprint of each member, and the exact number of members the density asks for,
+    // no more than the share of the group of the area left on the levels of the shelf can hold
+    TArray<float>& LevelFreeAreas = ShelfLevelFreeAreas[ShelfIdx];
+    int32 MembersNum = Group.GetMembersEnd() - Group.GetFirstMember();
+    TArray<float>& Footprints = Placement.Footprints;
+    TArray<FVector2D>& FootprintExtents = Placement.FootprintExtents;
+    Footprints.Reserve(MembersNum);
+    FootprintExtents.Reserve(MembersNum);
+    float FootprintsSum = 0.f;
+    for (int32 ProductIdx = Group.GetFirstMember(); ProductIdx < Group.GetMembersEnd(); ++ProductIdx)
+    {
+        FVector ProductOrigin, ProductExtent;
+        ProductStore.GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+        Footprints.Add(ProductExtent.X * ProductExtent.Y * 4.f);
+        FootprintExtents.Add(FVector2D(ProductExtent.X, ProductExtent.Y));
+        FootprintsSum += Footprints.Last();
+    }
+    float ShelfFreeArea = 0.f;
+    for (auto LevelIt = LevelFreeAreas.CreateConstIterator(); LevelIt; ++LevelIt)
+    {
+        ShelfFreeArea += FMath::Max(*LevelIt, 0.f);
+    }
+    // The area left is shared among the groups still to be placed on the shelf in proportion to their footprints,
+    // so the groups placed first cannot take it all. The cap only binds when the shelf cannot hold what the density
+    // asks of all of them, and what a group leaves unused goes to the groups after it
+    if (ShelfPendingFootprints[ShelfIdx] < 0.f)
+    {
+        ShelfPendingFootprints[ShelfIdx] = GetPendingFootprints(ShelfIdx, GroupIdx);
+    }
+    float PendingFootprints = FMath::Max(ShelfPendingFootprints[ShelfIdx], FootprintsSum);
+    ShelfPendingFootprints[ShelfIdx] = FMath::Max(ShelfPendingFootprints[ShelfIdx] - FootprintsSum, 0.f);
+    int32 BudgetNum = FMath::RoundToInt(Density * MembersNum);
+    if (PendingFootprints > 0.f)
+    {
+        BudgetNum = FMath::Min(BudgetNum, FMath::FloorToInt(ShelfFreeArea * MembersNum / PendingFootprints));
+    }
+    BudgetNum = FMath::Clamp(BudgetNum, 0, MembersNum);
+    TArray<bool>& bIsSelected = Placement.bIsSelected;
+    bIsSelected.Init(false, MembersNum);
+    TArray<int32> MemberOrder;
+    MemberOrder.Reserve(MembersNum);
+    for (int32 MemberIdx = 0; MemberIdx < MembersNum; ++MemberIdx)
+    {
+        MemberOrder.Add(MemberIdx);
+    }
+    for (int32 SelectedIdx = 0; SelectedIdx < BudgetNum; ++SelectedIdx)
+    {
+        MemberOrder.Swap(SelectedIdx, FMath::RandRange(SelectedIdx, MembersNum - 1));
+        bIsSelected[MemberOrder[SelectedIdx]] = true;
+    }
+    // In the row stacking mode a product placed at the front goes to the deepest facing free for it, and the next
+    // picked members fill the row in front of it: one query per product instead of pushing each back step by step
+    Placement.bIsStacked.Init(false, MembersNum);
+    // get a centerilized anchor for placing products
+    Placement.ShelfBaseIdx = FMath::RandRange(0, ShelfBaseZ.Num() - 1);
+    Placement.Anchor.Z = ShelfBaseZ[Placement.ShelfBaseIdx];
+    Placement.Anchor.Y = FMath::RandRange(float(BoundingBoxOrigin.Y - BoundingBoxExtent.Y + AUTO_SHUFFLE_Y_TWO_END_OFFSET), float(BoundingBoxOrigin.Y + BoundingBoxExtent.Y - AUTO_SHUFFLE_Y_TWO_END_OFFSET));
+    Placement.Anchor.X = BoundingBoxOrigin.X - BoundingBoxExtent.X;
+    return true;
+}
+
+void FAutoShuffleWindowModule::PlaceNextProduct(float Proxmity)
+{
+    FAutoShuffleGroupPlacement& Placement = GroupPlacement;
+    int32 ShelfIdx = Placement.ShelfIdx;
+    FAutoShuffleShelf& Shelf = ShelvesWhitelist[ShelfIdx];
+    FAutoShuffleProductGroup& Group = ProductsWhitelist[Placement.GroupIdx];
+    FAutoShufflePlacementStats& Stats = GroupPlacementStats[Placement.GroupIdx];
+    TArray<float>& LevelFreeAreas = ShelfLevelFreeAreas[ShelfIdx];
+    const FVector& BoundingBoxOrigin = Placement.BoundingBoxOrigin;
+    const FVector& BoundingBoxExtent = Placement.BoundingBoxExtent;
+    const TArray<float>& ShelfBaseZ = Placement.ShelfBaseZ;
+    const TArray<float>& ShelfOffsetZ = Placement.ShelfOffsetZ;
+    const TArray<float>& Footprints = Placement.Footprints;
+    const TArray<FVector2D>& FootprintExtents = Placement.FootprintExtents;
+    // the anchor moves on from one member to the next
+    int32& ShelfBaseIdx = Placement.ShelfBaseIdx;
+    FVector& Anchor = Placement.Anchor;
+    TArray<int32> RoomyLevels;
+    TArray<int32> LevelTriesNum;
+    int32 ProductIdx = Group.GetFirstMember() + Placement.NextMemberIdx++;
+    // only the members picked for the density budget are placed, and those stacked behind another are placed already
+    int32 MemberIdx = ProductIdx - Group.GetFirstMember();
+    if (Placement.bIsStacked[MemberIdx])
+    {
+        return;
+    }
+    if (!Placement.bIsSelected[MemberIdx])
+    {
+#ifdef VERBOSE_AUTO_SHUFFLE
+        UE_LOG(LogAutoShuffle, Log, TEXT("Product %s has been discarded"), *ProductStore.GetName(ProductIdx).ToString());
+#endif
+        ProductStore.Discard(ProductIdx);
+        ProductStore.ResetOnShelf(ProductIdx);
+        ++Stats.DiscardedByDensityNum;
+        return;
+    }
+    // the levels with room left for the product, leaving out those where no smaller product could be placed
+    // since the space last freed up. Without any, the product goes without a single query
+    float Footprint = Footprints[MemberIdx];
+    bool bHasArea = false;
+    RoomyLevels.Reset();
+    for (int32 LevelIdx = 0; LevelIdx < LevelFreeAreas.Num(); ++LevelIdx)
+    {
+        if (LevelFreeAreas[LevelIdx] >= Footprint)
+        {
+            bHasArea = true;
+            if (!IsFootprintKnownToFail(ShelfIdx, LevelIdx, FootprintExtents[MemberIdx]))
+            {
+                RoomyLevels.Add(LevelIdx);
+            }
+        }
+    }
+    if (RoomyLevels.Num() == 0)
+    {
+        ProductStore.Discard(ProductIdx);
+        ProductStore.ResetOnShelf(ProductIdx);
+        if (bHasArea)
+        {
+            ++Stats.DiscardedKnownToFailNum;
+        }
+        else
+        {
+            ++Stats.DiscardedNoCapacityNum;
+        }
+        return;
+    }
+    LevelTriesNum.Init(0, LevelFreeAreas.Num());
+    // take the product out of the discard pool before looking for a place for it
+    ProductStore.ResetDiscard(ProductIdx);
+    // if rand() >= Proxmity place it randomly
+    if (FMath::RandRange(0.f, 1.f) >= Proxmity)
+    {
+        // randomly get a start point on the boundary of the shelf; if collided get another one
+        FVector ProductStartPoint;
+        int AlreadyTriedTimes = 0;
+        int ProductStartPointShelfBaseIdx = 0;
+        TArray<AActor*> OverlappingActors;
+        while (true)
+        {
+            if (AlreadyTriedTimes >= AUTO_SHUFFLE_MAX_TRY_TIMES)
+            {
+                AlreadyTriedTimes = -1;
+                break;
+            }
+            Stats.RetriesNum += AlreadyTriedTimes > 0 ? 1 : 0;
+            AlreadyTriedTimes += 1;
+            ProductStartPointShelfBaseIdx = RoomyLevels[FMath::RandRange(0, RoomyLevels.Num() - 1)];
+            ++LevelTriesNum[ProductStartPointShelfBaseIdx];
+            ProductStartPoint.Z = ShelfBaseZ[ProductStartPointShelfBaseIdx];
+            ProductStartPoint.Y = FMath::RandRange(float(BoundingBoxOrigin.Y - BoundingBoxExtent.Y + AUTO_SHUFFLE_Y_TWO_END_OFFSET), float(BoundingBoxOrigin.Y + BoundingBoxExtent.Y - AUTO_SHUFFLE_Y_TWO_END_OFFSET));
+            ProductStartPoint.X = BoundingBoxOrigin.X - BoundingBoxExtent.X;
+            ProductStore.SetPosition(ProductIdx, ProductStartPoint);
+            ProductStore.SetShelfOffset(ProductIdx, ShelfOffsetZ[ProductStartPointShelfBaseIdx]);
+            // deal with the offset of the product center and the bottom
+            FVector ProductOrigin, ProductExtent;
+            ProductStore.GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+            float ProductCurrentBottom = ProductOrigin.Z - ProductExtent.Z;
+            float ProductZLift = ProductStartPoint.Z - ProductCurrentBottom;
+            float ProductCurrentFront = ProductOrigin.X - ProductExtent.X;
+            float ProductXlift = ProductStartPoint.X - ProductCurrentFront;
+            float ProductCurrentOrigin = ProductOrigin.Y;
+            float ProductYLift = ProductStartPoint.Y - ProductCurrentOrigin;
+            ProductStartPoint.X += ProductXlift;
+            ProductStartPoint.Y += ProductYLift;
+            ProductStartPoint.Z += ProductZLift;
+            ProductStore.SetPosition(ProductIdx, ProductStartPoint);
+            // find all the overlapped actors
+            QueryOverlappingProducts(ProductIdx, OverlappingActors, Stats);
+            /** @todo consider implementing a collision whitelist, e.g., BP_DemoRoom */
+            if (/** no collision */ OverlappingActors.Num() == 0)
+            {
+                break;
+            }
+#ifdef VERBOSE_AUTO_SHUFFLE
+            UE_LOG(LogAutoShuffle, Log, TEXT("%s has %d overlapping actors"), *ProductStore.GetName(ProductIdx).ToString(), OverlappingActors.Num());
+            for (auto OverlappingActorIt = OverlappingActors.CreateIterator(); OverlappingActorIt; ++OverlappingActorIt)
+            {
+                UE_LOG(LogAutoShuffle, Log, TEXT("%s is overlapping with %s"), *ProductStore.GetName(ProductIdx).ToString(), *(*OverlappingActorIt)->GetName());
+            }
+#endif
+        }
+        // if within the maximum try times the product still didn't find the proper place, discard it
+        if (AlreadyTriedTimes == -1)
+        {
+#ifdef VERBOSE_AUTO_SHUFFLE
+            UE_LOG(LogAutoShuffle, Log, TEXT("Product %s has been discarded"), *ProductStore.GetName(ProductIdx).ToString());
+#endif
+            ProductStore.Discard(ProductIdx);
+            ProductStore.ResetOnShelf(ProductIdx);
+            RecordFailedFootprint(ShelfIdx, LevelTriesNum, FootprintExtents[MemberIdx]);
+            ++Stats.RetryBoundHitsNum;
+            ++Stats.DiscardedNoRoomNum;
+            return;
+        }
+        ProductStore.SetOnShelf(ProductIdx);
+        ProductStore.SetShelfLevel(ProductIdx, Shelf.GetFirstLevel() + ProductStartPointShelfBaseIdx);
+        LevelFreeAreas[ProductStartPointShelfBaseIdx] -= Footprint;
+        if (bIsRowStackingChecked)
+        {
+            StackRow(ProductIdx, ProductStartPointShelfBaseIdx);
+            return;
+        }
+        // try to push the item inside, until collided
+        PushProduct(ProductIdx, Stats);
+    }
+    // else place it near the anchor
+    else
+    {
+        TArray<AActor*> OverlappingActors;
+        int AlreadyTriedTimes = 0;
+        // a full level gets no more products; the anchor moves to a level with room
+        if (LevelFreeAreas[ShelfBaseIdx] < Footprint)
+        {
+            ShelfBaseIdx = RoomyLevels[FMath::RandRange(0, RoomyLevels.Num() - 1)];
+            Anchor.Z = ShelfBaseZ[ShelfBaseIdx];
+            Anchor.Y = FMath::RandRange(float(BoundingBoxOrigin.Y - BoundingBoxExtent.Y + AUTO_SHUFFLE_Y_TWO_END_OFFSET), float(BoundingBoxOrigin.Y + BoundingBoxExtent.Y - AUTO_SHUFFLE_Y_TWO_END_OFFSET));
+        }
+        // loop
+        while (AlreadyTriedTimes++ < AUTO_SHUFFLE_MAX_TRY_TIMES)
+        {
+            ++LevelTriesNum[ShelfBaseIdx];
+            // get the current object's bounding box
+            ProductStore.SetPosition(ProductIdx, Anchor);
+            FVector ProductOrigin, ProductExtent;
+            ProductStore.GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+            float ProductCurrenBottom = ProductOrigin.Z - ProductExtent.Z;
+            float ProductZLift = Anchor.Z - ProductCurrenBottom;
+            FVector ProductStartPoint = Anchor;
+            float ProductCurrentFront = ProductOrigin.X - ProductExtent.X;
+            float ProductXlift = ProductStartPoint.X - ProductCurrentFront;
+            float ProductCurrentOrigin = ProductOrigin.Y;
+            float ProductYLift = ProductStartPoint.Y - ProductCurrentOrigin;
+            ProductStartPoint.X += ProductXlift;
+            ProductStartPoint.Y += ProductYLift;
+            ProductStartPoint.Z += ProductZLift;
+            ProductStore.SetPosition(ProductIdx, ProductStartPoint);
+            ProductStore.SetShelfOffset(ProductIdx, ShelfOffsetZ[ShelfBaseIdx]);
+            // see if the object could fit the anchor position
+            Stats.RetriesNum += AlreadyTriedTimes > 1 ? 1 : 0;
+            QueryOverlappingProducts(ProductIdx, OverlappingActors, Stats);
+            bool bHasCollision = OverlappingActors.Num() != 0;
+            // see if the product is in the bound of the shelf
+            ProductStore.GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+            bool bIsInBound = ProductOrigin.Y - ProductExtent.Y >= BoundingBoxOrigin.Y - BoundingBoxExtent.Y
+                && ProductOrigin.Y + ProductExtent.Y <= BoundingBoxOrigin.Y + BoundingBoxExtent.Y;
+            if (/** no collision and inbound */ !bHasCollision && bIsInBound)
+            {
+                break;
+            }
+            // else if the product still in bound, get another anchor point that follows the perceptual organization
+            else if (bIsInBound)
+            {
+                float ProductWidth = ProductExtent.Y * 2.f;
+                // place the product to the right
+                if (AlreadyTriedTimes % 2 == 1)
+                {
+                    Anchor.Y += AlreadyTriedTimes * (ProductWidth + FMath::RandRange(float(AUTO_SHUFFLE_Y_TWO_END_OFFSET * 0.5f), AUTO_SHUFFLE_Y_TWO_END_OFFSET));
+                }
+                // place the product to the left
+                else
+                {
+                    Anchor.Y -= AlreadyTriedTimes * (ProductWidth + FMath::RandRange(float(AUTO_SHUFFLE_Y_TWO_END_OFFSET * 0.5f), AUTO_SHUFFLE_Y_TWO_END_OFFSET));
+                }
+            }
+            // else, randomly find another anchor point
+            else
+            {
+                ShelfBaseIdx = RoomyLevels[FMath::RandRange(0, RoomyLevels.Num() - 1)];
+                Anchor.Z = ShelfBaseZ[ShelfBaseIdx];
+                Anchor.Y = FMath::RandRange(float(BoundingBoxOrigin.Y - BoundingBoxExtent.Y + AUTO_SHUFFLE_Y_TWO_END_OFFSET), float(BoundingBoxOrigin.Y + BoundingBoxExtent.Y - AUTO_SHUFFLE_Y_TWO_END_OFFSET));
+                Anchor.X = BoundingBoxOrigin.X - BoundingBoxExtent.X;
+            }
+        }
+        // if collision all the time, discard
+        if (AlreadyTriedTimes >= AUTO_SHUFFLE_MAX_TRY_TIMES)
+        {
+#ifdef VERBOSE_AUTO_SHUFFLE
+            UE_LOG(LogAutoShuffle, Log, TEXT("Product %s has been discarded"), *ProductStore.GetName(ProductIdx).ToString());
+#endif
+            ProductStore.Discard(ProductIdx);
+            ProductStore.ResetOnShelf(ProductIdx);
+            RecordFailedFootprint(ShelfIdx, LevelTriesNum, FootprintExtents[MemberIdx]);
+            ++Stats.RetryBoundHitsNum;
+            ++Stats.DiscardedNoRoomNearAnchorNum;
+            return;
+        }
+        // else push the product deep inside
+        else
+        {
+            // try to push the item inside, until collided
+            ProductStore.SetOnShelf(ProductIdx);
+            ProductStore.SetShelfLevel(ProductIdx, Shelf.GetFirstLevel() + ShelfBaseIdx);
+            LevelFreeAreas[ShelfBaseIdx] -= Footprint;
+            if (bIsRowStackingChecked)
+            {
+                StackRow(ProductIdx, ShelfBaseIdx);
+                return;
+            }
+            PushProduct(ProductIdx, Stats);
+        }
+    }
+}
+
+void FAutoShuffleWindowModule::PushProduct(int32 ProductIdx, FAutoShufflePlacementStats& Stats)
+{
+    TArray<AActor*> OverlappingActors;
+    int32 StepsNum = 0;
+    while (StepsNum++ < AUTO_SHUFFLE_INC_BOUND)
+    {
+        QueryOverlappingProducts(ProductIdx, OverlappingActors, Stats);
+        FVector ProductPosition = ProductStore.GetPosition(ProductIdx);
+        if (OverlappingActors.Num() != 0)
+        {
+            ProductPosition.X -= AUTO_SHUFFLE_INC_STEP;
+            ProductStore.SetPosition(ProductIdx, ProductPosition);
+            break;
+        }
+        ProductPosition.X += AUTO_SHUFFLE_INC_STEP;
+        ProductStore.SetPosition(ProductIdx, ProductPosition);
+    }
+    Stats.AddPush(StepsNum - 1);
+}
+
+void FAutoShuffleWindowModule::StackRow(int32 LeadIdx, int32 LevelIdx)
+{
+    FAutoShuffleGroupPlacement& Placement = GroupPlacement;
+    FAutoShuffleShelf& Shelf = ShelvesWhitelist[Placement.ShelfIdx];
+    FAutoShuffleProductGroup& Group = ProductsWhitelist[Placement.GroupIdx];
+    FAutoShufflePlacementStats& Stats = GroupPlacementStats[Placement.GroupIdx];
+    TArray<float>& LevelFreeAreas = ShelfLevelFreeAreas[Placement.ShelfIdx];
+    const FVector& BoundingBoxOrigin = Placement.BoundingBoxOrigin;
+    const FVector& BoundingBoxExtent = Placement.BoundingBoxExtent;
+    const TArray<float>& ShelfOffsetZ = Placement.ShelfOffsetZ;
+    const TArray<float>& Footprints = Placement.Footprints;
+    const TArray<bool>& bIsSelected = Placement.bIsSelected;
+    TArray<bool>& bIsStacked = Placement.bIsStacked;
+    float ShelfFrontX = BoundingBoxOrigin.X - BoundingBoxExtent.X;
+    TArray<AActor*> OverlappingActors;
+    FVector LeadOrigin, LeadExtent;
+    ProductStore.GetBounds(LeadIdx, LeadOrigin, LeadExtent);
+    float FacingDepth = LeadExtent.X * 2.f + AUTO_SHUFFLE_INC_STEP;
+    int32 FacingsNum = FMath::Max(FMath::FloorToInt(BoundingBoxExtent.X * 2.f / FacingDepth), 1);
+    // the front facing is already known to be free
+    FVector FrontPosition = ProductStore.GetPosition(LeadIdx);
+    int32 FacingIdx = FacingsNum - 1;
+    for (; FacingIdx > 0; --FacingIdx)
+    {
+        ProductStore.SetPosition(LeadIdx, FrontPosition + FVector(FacingIdx * FacingDepth, 0.f, 0.f));
+        QueryOverlappingProducts(LeadIdx, OverlappingActors, Stats);
+        if (OverlappingActors.Num() == 0)
+        {
+            break;
+        }
+    }
+    // no whole facing is free behind the front one: the lead goes as deep as it can, as without the row stacking, and has no row
+    if (FacingIdx == 0)
+    {
+        ProductStore.SetPosition(LeadIdx, FrontPosition);
+        PushProduct(LeadIdx, Stats);
+        return;
+    }
+    float RowFrontX = LeadOrigin.X - LeadExtent.X + FacingIdx * FacingDepth;
+    for (int32 FollowerIdx = LeadIdx + 1; FollowerIdx < Group.GetMembersEnd() && FacingIdx > 0; ++FollowerIdx)
+    {
+        int32 FollowerMemberIdx = FollowerIdx - Group.GetFirstMember();
+        if (!bIsSelected[FollowerMemberIdx] || bIsStacked[FollowerMemberIdx])
+        {
+            continue;
+        }
+        if (LevelFreeAreas[LevelIdx] < Footprints[FollowerMemberIdx])
+        {
+            break;
+        }
+        // the back of the follower against the front of the row, on the level and centered on the lead
+        ProductStore.ResetDiscard(FollowerIdx);
+        ProductStore.SetPosition(FollowerIdx, FrontPosition);
+        ProductStore.SetShelfOffset(FollowerIdx, ShelfOffsetZ[LevelIdx]);
+        FVector FollowerOrigin, FollowerExtent;
+        ProductStore.GetBounds(FollowerIdx, FollowerOrigin, FollowerExtent);
+        FVector FollowerLift(RowFrontX - AUTO_SHUFFLE_INC_STEP - (FollowerOrigin.X + FollowerExtent.X), LeadOrigin.Y - FollowerOrigin.Y,
+            (LeadOrigin.Z - LeadExtent.Z) - (FollowerOrigin.Z - FollowerExtent.Z));
+        float FollowerFrontX = FollowerOrigin.X + FollowerLift.X - FollowerExtent.X;
+        // a follower wider than the lead may hang over an end of the shelf
+        bool bIsInBound = LeadOrigin.Y - FollowerExtent.Y >= BoundingBoxOrigin.Y - BoundingBoxExtent.Y
+            && LeadOrigin.Y + FollowerExtent.Y <= BoundingBoxOrigin.Y + BoundingBoxExtent.Y;
+        bool bIsPlaced = FollowerFrontX >= ShelfFrontX && bIsInBound;
+        if (bIsPlaced)
+        {
+            ProductStore.SetPosition(FollowerIdx, FrontPosition + FollowerLift);
+            QueryOverlappingProducts(FollowerIdx, OverlappingActors, Stats);
+            bIsPlaced = OverlappingActors.Num() == 0;
+        }
+        // a follower that does not fit waits in the pool for its own turn
+        if (!bIsPlaced)
+        {
+            ProductStore.Discard(FollowerIdx);
+            break;
+        }
+        ProductStore.SetOnShelf(FollowerIdx);
+        ProductStore.SetShelfLevel(FollowerIdx, Shelf.GetFirstLevel() + LevelIdx);
+        LevelFreeAreas[LevelIdx] -= Footprints[FollowerMemberIdx];
+        bIsStacked[FollowerMemberIdx] = true;
+        ++Stats.StackedNum;
+        RowFrontX = FollowerFrontX;
+        --FacingIdx;
+    }
+}
+
+void FAutoShuffleWindowModule::LowerProducts()
+{
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_LowerProducts);
+    for (int32 ProductIdx = 0; ProductIdx < ProductStore.Num(); ++ProductIdx)
+    {
+        if (!ProductStore.IsDiscarded(ProductIdx))
+        {
+            FVector Position = ProductStore.GetPosition(ProductIdx);
+            Position.Z -= ProductStore.GetShelfOffset(ProductIdx);
+            ProductStore.SetPosition(ProductIdx, Position);
+        }
+    }
+}
+
+bool FAutoShuffleWindowModule::StepOrganizeProducts()
+{
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_OrganizeProducts);
+    if (OrganizeShelfIdx == INDEX_NONE)
+    {
+        // the products are moved through their actors here, so the actors must be where the store says
+        ProductStore.CommitTransforms();
+        // pushing the products together opens up gaps that were too small before
+        InvalidateFailedFootprints();
+        OrganizedProducts.Reset();
+        NextOrganizedProduct = 0;
+    }
+    // move on to the next shelf with products left to push
+    while (NextOrganizedProduct >= OrganizedProducts.Num())
+    {
+        if (OrganizeShelfIdx + 1 >= ShelvesWhitelist.Num())
+        {
+            // update the positions in the product store
+            for (int32 ProductIdx = 0; ProductIdx < ProductStore.Num(); ++ProductIdx)
+            {
+                if (ProductStore.GetObjectActor(ProductIdx) != nullptr)
+                {
+                    FVector Position = ProductStore.GetObjectActor(ProductIdx)->GetActorLocation();
+                    ProductStore.SetPosition(ProductIdx, Position);
+                }
+            }
+            OrganizeShelfIdx = INDEX_NONE;
+            return true;
+        }
+        CollectOrganizedProducts(++OrganizeShelfIdx);
+        NextOrganizedProduct = 0;
+    }
+    OrganizeProduct(OrganizeShelfIdx, OrganizedProducts[NextOrganizedProduct++]);
+    return false;
+}
+
+void FAutoShuffleWindowModule::CollectOrganizedProducts(int32 ShelfIdx)
+{
+    FAutoShuffleShelf& Shelf = ShelvesWhitelist[ShelfIdx];
+    FString ShelfName = Shelf.GetName();
+    // collect all the products' actors which are on shelf and have not been discarded
+    OrganizedProducts.Reset();
+    for (auto ProductGroupIt = ProductsWhitelist.CreateIterator(); ProductGroupIt; ++ProductGroupIt)
+    {
+        if (ProductGroupIt->GetShelfName() != ShelfName)
+        {
+            continue;
+        }
+        for (int32 ProductIdx = ProductGroupIt->GetFirstMember(); ProductIdx < ProductGroupIt->GetMembersEnd(); ++ProductIdx)
+        {
+            if (ProductStore.IsOnShelf(ProductIdx) && !ProductStore.IsDiscarded(ProductIdx) && ProductStore.GetObjectActor(ProductIdx) != nullptr)
+            {
+                OrganizedProducts.Add(ProductStore.GetObjectActor(ProductIdx));
+            }
+        }
+    }
+    // sort them according to bound.Y from low to high for 001 shelf
+    if (ShelfName == "BP_ShelfMain_001")
+    {
+        OrganizedProducts.Sort(OrganizeProductsPredicateLowToHigh);
+    }
+    // from high to low for 002 shelf
+    else
+    {
+        OrganizedProducts.Sort(OrganizeProductsPredicateHighToLow);
+    }
+}
+
+void FAutoShuffleWindowModule::OrganizeProduct(int32 ShelfIdx, AActor* ProductActor)
+{
+    FAutoShuffleShelf& Shelf = ShelvesWhitelist[ShelfIdx];
+    FVector ShelfOrigin, ShelfExtent;
+    Shelf.GetObjectActor()->GetActorBounds(false, ShelfOrigin, ShelfExtent);
+    // loop
+    while (true)
+    {
+        // try to push them to left for 001 shelf
+        FVector Position = ProductActor->GetActorLocation();
+        if (Shelf.GetName() == "BP_ShelfMain_001")
+        {
+            Position.Y -= AUTO_SHUFFLE_INC_STEP;
+        }
+        // to right for 002 shelf
+        else
+        {
+            Position.Y += AUTO_SHUFFLE_INC_STEP;
+        }
+        ProductActor->SetActorLocation(Position);
+        // check if the object is still in the bound
+        FVector ProductOrigin, ProductExtent;
+        ProductActor->GetActorBounds(false, ProductOrigin, ProductExtent);
+        bool IsInBound;
+        if (Shelf.GetName() == "BP_ShelfMain_001")
+        {
+            IsInBound = ProductOrigin.Y - ProductExtent.Y >= ShelfOrigin.Y - ShelfExtent.Y;
+        }
+        else
+        {
+            IsInBound = ProductOrigin.Y + ProductExtent.Y <= ShelfOrigin.Y + ShelfExtent.Y;
+        }
+        // check if there's no collision
+        TArray<AActor*> OverlappingActors;
+        QueryOverlappingActors(ProductActor, OverlappingActors, ShelfPlacementStats[ShelfIdx]);
+        bool HasNoCollision = OverlappingActors.Num() == 0;
+        // if not in the bound or has collision, restore and proceed to the next product
+        if (!IsInBound || !HasNoCollision)
+        {
+            if (Shelf.GetName() == "BP_ShelfMain_001")
+            {
+                Position.Y += AUTO_SHUFFLE_INC_STEP;
+            }
+            else
+            {
+                Position.Y -= AUTO_SHUFFLE_INC_STEP;
+            }
+            ProductActor->SetActorLocation(Position);
+            break;
+        }
+    }
+}
+
+bool FAutoShuffleWindowModule::OrganizeProductsPredicateLowToHigh(const AActor &Actor1, const AActor &Actor2)
+{
+    FVector Actor1Origin, Actor1Extent, Actor2Origin, Actor2Extent;
+    Actor1.GetActorBounds(false, Actor1Origin, Actor1Extent);
+    Actor2.GetActorBounds(false, Actor2Origin, Actor2Extent);
+    return Actor1Origin.Y - Actor1Extent.Y < Actor2Origin.Y - Actor2Extent.Y;
+}
+
+bool FAutoShuffleWindowModule::OrganizeProductsPredicateHighToLow(const AActor &Actor1, const AActor &Actor2)
+{
+    FVector Actor1Origin, Actor1Extent, Actor2Origin, Actor2Extent;
+    Actor1.GetActorBounds(false, Actor1Origin, Actor1Extent);
+    Actor2.GetActorBounds(false, Actor2Origin, Actor2Extent);
+    return Actor1Origin.Y - Actor1Extent.Y > Actor2Origin.Y - Actor2Extent.Y;
+}
+
+TArray<class F2DPoint>* FAutoShuffleWindowModule::TriangleRasterizer(const class F2DPointf &V1, const class F2DPointf &V2, const class F2DPointf &V3)
+{
+    // Reference: http://forum.devmaster.net/t/advanced-rasterization/6145
+    // The pixel (x, y) is sampled at its center (x + 0.5, y + 0.5). Only a counter-clockwise triangle, with y going down
+    // the rows, is drawn, and a center right on an edge is drawn only if it is a top or a left edge of the triangle,
+    // so that the triangles sharing an edge draw each pixel along it once
+    TArray<class F2DPoint> *PointArray = new TArray<class F2DPoint>;
+
+    double X1 = V1.X, X2 = V2.X, X3 = V3.X;
+    double Y1 = V1.Y, Y2 = V2.Y, Y3 = V3.Y;
+
+    // The signed area of triangle by cross product a x b = a1b2 - a2b1, negative when counter-clockwise
+    double TriangleArea = (X2 - X1) * (Y3 - Y1) - (Y2 - Y1) * (X3 - X1);
+
+    // An empty triangle, or the other winding
+    if (TriangleArea >= 0.0)
+    {
+        return PointArray;
+    }
+    TriangleArea = -TriangleArea;
+
+    // Half-edge functions E(x, y) = DY * (x - X) - DX * (y - Y), positive inside. Each edge is evaluated from its end with
+    // the smaller x, then y, and negated in the other direction, so that the two triangles sharing the edge get exactly
+    // opposite values at every pixel center and the fill rule decides the centers right on it
+    const F2DPointf* Vertices[] = { &V1, &V2, &V3 };
+    double EdgeX[3], EdgeY[3], EdgeDX[3], EdgeDY[3], EdgeSign[3];
+    bool bIsTopLeftEdge[3];
+    for (int32 EdgeIdx = 0; EdgeIdx < 3; ++EdgeIdx)
+    {
+        const F2DPointf *From = Vertices[EdgeIdx], *To = Vertices[(EdgeIdx + 1) % 3];
+        // a left edge goes down the rows, and a top edge goes left along a row
+        bIsTopLeftEdge[EdgeIdx] = To->Y > From->Y || (To->Y == From->Y && To->X < From->X);
+        EdgeSign[EdgeIdx] = 1.0;
+        if (To->X < From->X || (To->X == From->X && To->Y < From->Y))
+        {
+            Swap(From, To);
+            EdgeSign[EdgeIdx] = -1.0;
+        }
+        EdgeX[EdgeIdx] = From->X;
+        EdgeY[EdgeIdx] = From->Y;
+        EdgeDX[EdgeIdx] = (double)To->X - From->X;
+        EdgeDY[EdgeIdx] = (double)To->Y - From->Y;
+    }
+
+    // Bounding rectangle of the pixel centers
+    int MinX = FMath::CeilToInt(FMath::Min3(V1.X, V2.X, V3.X) - 0.5f), MaxX = FMath::FloorToInt(FMath::Max3(V1.X, V2.X, V3.X) - 0.5f);
+    int MinY = FMath::CeilToInt(FMath::Min3(V1.Y, V2.Y, V3.Y) - 0.5f), MaxY = FMath::FloorToInt(FMath::Max3(V1.Y, V2.Y, V3.Y) - 0.5f);
+
+    // Scan through bounding rectangle
+    for (int y = MinY; y <= MaxY; ++y)
+    {
+        // The part of the half-edge functions constant along the row
+        double CenterY = y + 0.5;
+        double RowTerms[3];
+        for (int32 EdgeIdx = 0; EdgeIdx < 3; ++EdgeIdx)
+        {
+            RowTerms[EdgeIdx] = -EdgeDX[EdgeIdx] * (CenterY - EdgeY[EdgeIdx]);
+        }
+
+        for (int x = MinX; x <= MaxX; ++x)
+        {
+            double CenterX = x + 0.5;
+            double E[3];
+            bool bIsInside = true;
+            for (int32 EdgeIdx = 0; EdgeIdx < 3 && bIsInside; ++EdgeIdx)
+            {
+                E[EdgeIdx] = EdgeSign[EdgeIdx] * (EdgeDY[EdgeIdx] * (CenterX - EdgeX[EdgeIdx]) + RowTerms[EdgeIdx]);
+                bIsInside = E[EdgeIdx] > 0.0 || (E[EdgeIdx] == 0.0 && bIsTopLeftEdge[EdgeIdx]);
+            }
+            if (bIsInside)
+            {
+                // calculate intepolated z: each vertex weighs as much as the slide across from it
+                double z = (E[1] * V1.Z + E[2] * V2.Z + E[0] * V3.Z) / TriangleArea;
+                PointArray->Add(F2DPoint(x, y, (float)z));
+            }
+        }
+    }
+    return PointArray;
+}
+
+FAutoShuffleObject::FAutoShuffleObject()
+{
+    Scale = 1.f;
+    Name = TEXT("Uninitialized Object Name");
+    Position = FVector(0.f, 0.f, 0.f);
+    ObjectActor = nullptr;
+}
+
+FAutoShuffleObject::~FAutoShuffleObject()
+{
+}
+
+void FAutoShuffleObject::SetName(FString& NewName)
+{
+    Name = NewName;
+}
+
+FString FAutoShuffleObject::GetName() const
+{
+    return Name;
+}
+
+void FAutoShuffleObject::SetPosition(FVector& NewPosition)
+{
+    Position = NewPosition;
+    ObjectActor->SetActorLocation(Position);
+}
+
+FVector FAutoShuffleObject::GetPosition() const
+{
+    return Position;
+}
+
+void FAutoShuffleObject::SetScale(float NewScale)
+{
+    Scale = NewScale;
+    if (ObjectActor != nullptr)
+    {
+        ObjectActor->SetActorScale3D(FVector(Scale, Scale, Scale));
+    }
+}
+
+float FAutoShuffleObject::GetScale() const
+{
+    return Scale;
+}
+
+void FAutoShuffleObject::SetObjectActor(AActor* NewObjectActor)
+{
+    // We don't delete anything
+    ObjectActor = NewObjectActor;
+}
+
+AActor* FAutoShuffleObject::GetObjectActor() const
+{
+    return ObjectActor;
+}
+
+FAutoShuffleShelf::FAutoShuffleShelf() : FAutoShuffleObject()
+{
+    FirstLevel = 0;
+    LevelsNum = 0;
+}
+
+FAutoShuffleShelf::~FAutoShuffleShelf()
+{
+}
+
+void FAutoShuffleShelf::SetLevels(int32 NewFirstLevel, int32 NewLevelsNum)
+{
+    FirstLevel = NewFirstLevel;
+    LevelsNum = NewLevelsNum;
+}
+
+int32 FAutoShuffleShelf::GetFirstLevel() const
+{
+    return FirstLevel;
+}
+
+int32 FAutoShuffleShelf::GetLevelsNum() const
+{
+    return LevelsNum;
+}
+
+FAutoShuffleProductGroup::FAutoShuffleProductGroup()
+{
+    FirstMember = 0;
+    MembersNum = 0;
+    Name = TEXT("Uninitialized Object Name");
+    ShelfName = TEXT("Unintialized Object Name");
+    bIsDiscarded = false;
+    DecompositionAccuracy = -1.f;
+    DecompositionMaxHullVerts = 0;
+}
+
+FAutoShuffleProductGroup::~FAutoShuffleProductGroup()
+{
+}
+
+void FAutoShuffleProductGroup::SetMembers(int32 NewFirstMember, int32 NewMembersNum)
+{
+    FirstMember = NewFirstMember;
+    MembersNum = NewMembersNum;
+}
+
+int32 FAutoShuffleProductGroup::GetFirstMember() const
+{
+    return FirstMember;
+}
+
+int32 FAutoShuffleProductGroup::GetMembersEnd() const
+{
+    return FirstMember + MembersNum;
+}
+
+int32 FAutoShuffleProductGroup::GetMembersNum() const
+{
+    return MembersNum;
+}
+
+void FAutoShuffleProductGroup::SetName(FString& NewName)
+{
+    Name = NewName;
+}
+
+FString FAutoShuffleProductGroup::GetName() const
+{
+    return Name;
+}
+
+void FAutoShuffleProductGroup::SetShelfName(FString& NewShelfName)
+{
+    ShelfName = NewShelfName;
+}
+
+FString FAutoShuffleProductGroup::GetShelfName() const
+{
+    return ShelfName;
+}
+
+void FAutoShuffleProductGroup::Discard()
+{
+    bIsDiscarded = true;
+}
+
+void FAutoShuffleProductGroup::ResetDiscard()
+{
+    bIsDiscarded = false;
+}
+
+bool FAutoShuffleProductGroup::IsDiscarded()
+{
+    return bIsDiscarded;
+}
+
+void FAutoShuffleProductGroup::SetDecompositionPreset(float NewAccuracy, int32 NewMaxHullVerts)
+{
+    DecompositionAccuracy = NewAccuracy;
+    DecompositionMaxHullVerts = NewMaxHullVerts;
+}
+
+float FAutoShuffleProductGroup::GetDecompositionAccuracy(float DefaultAccuracy) const
+{
+    return DecompositionAccuracy >= 0.f ? DecompositionAccuracy : DefaultAccuracy;
+}
+
+int32 FAutoShuffleProductGroup::GetDecompositionMaxHullVerts(int32 DefaultMaxHullVerts) const
+{
+    return DecompositionMaxHullVerts > 0 ? DecompositionMaxHullVerts : DefaultMaxHullVerts;
+}
+
+bool FAutoShuffleProductGroup::HasDecompositionPreset() const
+{
+    return DecompositionAccuracy >= 0.f || DecompositionMaxHullVerts > 0;
+}
+
+FAutoShuffleProductStore::FAutoShuffleProductStore()
+{
+    DiscardPoolOrigin = FVector(0.f, 0.f, 0.f);
+}
+
+FAutoShuffleProductStore::~FAutoShuffleProductStore()
+{
+}
+
+void FAutoShuffleProductStore::Reset()
+{
+    Positions.Reset();
+    Scales.Reset();
+    StagedScales.Reset();
+    TransformDirtyBits.Reset();
+    ShelfOffsets.Reset();
+    States.Reset();
+    ShelfLevels.Reset();
+    ObjectActors.Reset();
+    Names.Reset();
+    OcclusionRatios.Reset();
+    LevelBases.Reset();
+    LevelOffsets.Reset();
+}
+
+int32 FAutoShuffleProductStore::AddProduct(const FName& NewName, AActor* NewObjectActor, float NewScale)
+{
+    Positions.Add(FVector(0.f, 0.f, 0.f));
+    Scales.Add(NewScale);
+    StagedScales.Add(FVector(NewScale, NewScale, NewScale));
+    TransformDirtyBits.Add(0);
+    ShelfOffsets.Add(0.f);
+    States.Add(0);
+    ShelfLevels.Add(INDEX_NONE);
+    ObjectActors.Add(NewObjectActor);
+    OcclusionRatios.Add(-1.f);
+    int32 ProductIdx = Names.Add(NewName);
+    if (NewObjectActor != nullptr)
+    {
+        NewObjectActor->SetActorScale3D(FVector(NewScale, NewScale, NewScale));
+        // a product left in the discard pool by an earlier run stays there until it is placed
+        if (!NewObjectActor->GetActorEnableCollision())
+        {
+            States[ProductIdx] |= PS_Discarded;
+        }
+    }
+    return ProductIdx;
+}
+
+int32 FAutoShuffleProductStore::Num() const
+{
+    return Names.Num();
+}
+
+int32 FAutoShuffleProductStore::AddShelfLevels(const TArray<float>& NewLevelBases, const TArray<float>& NewLevelOffsets)
+{
+    // a level without an offset in the whitelist gets no offset
+    int32 FirstLevel = LevelBases.Num();
+    LevelBases.Append(NewLevelBases);
+    LevelOffsets.Append(NewLevelOffsets);
+    LevelOffsets.SetNumZeroed(LevelBases.Num());
+    return FirstLevel;
+}
+
+float FAutoShuffleProductStore::GetLevelBase(int32 LevelIdx) const
+{
+    return LevelBases[LevelIdx];
+}
+
+float FAutoShuffleProductStore::GetLevelOffset(int32 LevelIdx) const
+{
+    return LevelOffsets[LevelIdx];
+}
+
+FName FAutoShuffleProductStore::GetName(int32 ProductIdx) const
+{
+    return Names[ProductIdx];
+}
+
+void FAutoShuffleProductStore::SetPosition(int32 ProductIdx, const FVector& NewPosition)
+{
+    Positions[ProductIdx] = NewPosition;
+    TransformDirtyBits[ProductIdx] |= TD_Position;
+}
+
+FVector FAutoShuffleProductStore::GetPosition(int32 ProductIdx) const
+{
+    return Positions[ProductIdx];
+}
+
+void FAutoShuffleProductStore::SetScale(int32 ProductIdx, float NewScale)
+{
+    Scales[ProductIdx] = NewScale;
+    StageScale(ProductIdx, FVector(NewScale, NewScale, NewScale));
+}
+
+float FAutoShuffleProductStore::GetScale(int32 ProductIdx) const
+{
+    return Scales[ProductIdx];
+}
+
+void FAutoShuffleProductStore::ShrinkScale(int32 ProductIdx)
+{
+    // shrink the scale on z to 1/3 of x and/or y
+    float Scale = Scales[ProductIdx];
+    StageScale(ProductIdx, FVector(Scale, Scale, Scale * 0.3f));
+}
+
+int32 FAutoShuffleProductStore::ExpandScale(int32 ProductIdx)
+{
+    /** This function restores the object scale up to the scale indicated by Scales.
+     *  The goal is to expand the scale while the bottom is kept. So it's like the product growing up
+     *  from the shelf 
+     *  @note the scaling process does not guarantee the position unchanged
+     */
+    SCOPE_CYCLE_COUNTER(STAT_AutoShuffle_ExpandScale);
+    int32 StepsNum = 0;
+    AActor* ObjectActor = ObjectActors[ProductIdx];
+    if (ObjectActor != nullptr)
+    {
+        float Scale = Scales[ProductIdx];
+        FVector Position = Positions[ProductIdx];
+        // get the bottom and the Origin.XY of the product. These are the variables that the product must keep
+        FVector ProductOrigin, ProductExtent;
+        GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+        float ConstBottomLine = ProductOrigin.Z - ProductExtent.Z;
+        float ProductOriginX = ProductOrigin.X;
+        float ProductOriginY = ProductOrigin.Y;
+        // change the scale.x and scale.y to scale.z to start the expansion
+        float CurrentScale = StagedScales[ProductIdx].Z;
+        StageScale(ProductIdx, FVector(CurrentScale, CurrentScale, CurrentScale));
+        // loop
+        while (true)
+        {
+            // Get the overlapping actors
+            TArray<AActor*> OverlappingActors;
+            GetOverlappingActors(ProductIdx, OverlappingActors);
+            ++StepsNum;
+            // if overlapped, we stop
+            if (OverlappingActors.Num() != 0)
+            {
+                CurrentScale -= 0.1;
+                StageScale(ProductIdx, FVector(CurrentScale, CurrentScale, CurrentScale));
+                GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+                float CurrentBottomLine = ProductOrigin.Z - ProductExtent.Z;
+                float ProductZLift = ConstBottomLine - CurrentBottomLine;
+                Position.Z += ProductZLift;
+                Position.X += ProductOriginX - ProductOrigin.X;
+                Position.Y += ProductOriginY - ProductOrigin.Y;
+                SetPosition(ProductIdx, Position);
+                break;
+            }
+            // if the currentscale is already the Scale specified in the whitelist, we stop
+            if (CurrentScale >= Scale)
+            {
+                StageScale(ProductIdx, FVector(Scale, Scale, Scale));
+                GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+                float CurrentBottomLine = ProductOrigin.Z - ProductExtent.Z;
+                float ProductZLift = ConstBottomLine - CurrentBottomLine;
+                Position.Z += ProductZLift;
+                Position.X += ProductOriginX - ProductOrigin.X;
+                Position.Y += ProductOriginY - ProductOrigin.Y;
+                SetPosition(ProductIdx, Position);
+                break;
+            }
+            // otherwise, we increase the scale wholely, then adjust the bottom to the ConstBottomLine and the origin.XY to the original Origin.XY
+            CurrentScale += 0.1;
+            StageScale(ProductIdx, FVector(CurrentScale, CurrentScale, CurrentScale));
+            GetBounds(ProductIdx, ProductOrigin, ProductExtent);
+            float CurrentBottomLine = ProductOrigin.Z - ProductExtent.Z;
+            float ProductZLift = ConstBottomLine - CurrentBottomLine;
+            Position.Z += ProductZLift;
+            Position.X += ProductOriginX - ProductOrigin.X;
+            Position.Y += ProductOriginY - ProductOrigin.Y;
+            SetPosition(ProductIdx, Position);
+        }
+    }
+    return StepsNum;
+}
+
+AActor* FAutoShuffleProductStore::GetObjectActor(int32 ProductIdx) const
+{
+    return ObjectActors[ProductIdx];
+}
+
+void FAutoShuffleProductStore::SetDiscardPool(const FVector& NewDiscardPoolOrigin)
+{
+    DiscardPoolOrigin = NewDiscardPoolOrigin;
+}
+
+void FAutoShuffleProductStore::Discard(int32 ProductIdx)
+{
+    if (IsDiscarded(ProductIdx))
+    {
+        return;
+    }
+    States[ProductIdx] |= PS_Discarded;
+    if (ObjectActors[ProductIdx] != nullptr)
+    {
+        SetParked(ProductIdx, true);
+        // every product has its own slot so the parked products never pile up on one another
+        FVector Slot(float(ProductIdx % AUTO_SHUFFLE_DISCARD_POOL_ROW), float(ProductIdx / AUTO_SHUFFLE_DISCARD_POOL_ROW), 0.f);
+        SetPosition(ProductIdx, DiscardPoolOrigin + Slot * AUTO_SHUFFLE_DISCARD_POOL_SPACING);
+    }
+}
+
+bool FAutoShuffleProductStore::IsDiscarded(int32 ProductIdx) const
+{
+    return (States[ProductIdx] & PS_Discarded) != 0;
+}
+
+void FAutoShuffleProductStore::ResetDiscard(int32 ProductIdx)
+{
+    if (!IsDiscarded(ProductIdx))
+    {
+        return;
+    }
+    States[ProductIdx] &= ~PS_Discarded;
+    if (ObjectActors[ProductIdx] != nullptr)
+    {
+        SetParked(ProductIdx, false);
+    }
+}
+
+void FAutoShuffleProductStore::SetShelfOffset(int32 ProductIdx, float NewShelfOffset)
+{
+    ShelfOffsets[ProductIdx] = NewShelfOffset;
+}
+
+float FAutoShuffleProductStore::GetShelfOffset(int32 ProductIdx) const
+{
+    return ShelfOffsets[ProductIdx];
+}
+
+void FAutoShuffleProductStore::SetShelfLevel(int32 ProductIdx, int32 NewShelfLevel)
+{
+    ShelfLevels[ProductIdx] = NewShelfLevel;
+}
+
+int32 FAutoShuffleProductStore::GetShelfLevel(int32 ProductIdx) const
+{
+    return ShelfLevels[ProductIdx];
+}
+
+bool FAutoShuffleProductStore::IsOnShelf(int32 ProductIdx) const
+{
+    return (States[ProductIdx] & PS_OnShelf) != 0;
+}
+
+void FAutoShuffleProductStore::SetOnShelf(int32 ProductIdx)
+{
+    States[ProductIdx] |= PS_OnShelf;
+}
+
+void FAutoShuffleProductStore::ResetOnShelf(int32 ProductIdx)
+{
+    States[ProductIdx] &= ~PS_OnShelf;
+    ShelfLevels[ProductIdx] = INDEX_NONE;
+}
+
+uint8 FAutoShuffleProductStore::GetStates(int32 ProductIdx) const
+{
+    return States[ProductIdx];
+}
+
+void FAutoShuffleProductStore::SetStates(int32 ProductIdx, uint8 NewStates)
+{
+    bool bWasDiscarded = IsDiscarded(ProductIdx);
+    States[ProductIdx] = NewStates;
+    if (bWasDiscarded != IsDiscarded(ProductIdx) && ObjectActors[ProductIdx] != nullptr)
+    {
+        SetParked(ProductIdx, !bWasDiscarded);
+    }
+}
+
+void FAutoShuffleProductStore::SetTransform(int32 ProductIdx, const FTransform& NewTransform)
+{
+    // applied at once, so whatever was staged is dropped
+    Positions[ProductIdx] = NewTransform.GetLocation();
+    StagedScales[ProductIdx] = NewTransform.GetScale3D();
+    TransformDirtyBits[ProductIdx] = 0;
+    ObjectActors[ProductIdx]->SetActorTransform(NewTransform);
+}
+
+void FAutoShuffleProductStore::GetBounds(int32 ProductIdx, FVector& OutOrigin, FVector& OutExtent)
+{
+    // A staged move, or a staged scale that is the same on all the axes, moves and scales the bounds around the pivot.
+    // Those are worked out from the committed bounds without touching the actor; any other change is committed first
+    AActor* ObjectActor = ObjectActors[ProductIdx];
+    float BoundsScale = 1.f;
+    if ((TransformDirtyBits[ProductIdx] & TD_Scale) != 0)
+    {
+        FVector CommittedScale = ObjectActor->GetActorScale3D();
+        bool bIsUniform = false;
+        if (CommittedScale.GetAbsMin() > KINDA_SMALL_NUMBER)
+        {
+            FVector ScaleRatio = StagedScales[ProductIdx] / CommittedScale;
+            bIsUniform = FMath::IsNearlyEqual(ScaleRatio.X, ScaleRatio.Y) && FMath::IsNearlyEqual(ScaleRatio.X, ScaleRatio.Z);
+            BoundsScale = ScaleRatio.X;
         }
+        if (!bIsUniform)
+        {
+            BoundsScale = 1.f;
+            CommitTransform(ProductIdx);
+        }
+    }
+    ObjectActor->GetActorBounds(false, OutOrigin, OutExtent);
+    if (TransformDirtyBits[ProductIdx] != 0)
+    {
+        FVector CommittedPosition = ObjectActor->GetActorLocation();
+        FVector StagedPosition = (TransformDirtyBits[ProductIdx] & TD_Position) != 0 ? Positions[ProductIdx] : CommittedPosition;
+        OutOrigin = StagedPosition + (OutOrigin - CommittedPosition) * BoundsScale;
+        OutExtent *= BoundsScale;
+    }
+}
+
+void FAutoShuffleProductStore::GetOverlappingActors(int32 ProductIdx, TArray<AActor*>& OutOverlappingActors)
+{
+    CommitTransform(ProductIdx);
+    ObjectActors[ProductIdx]->GetOverlappingActors(OutOverlappingActors);
+}
+
+void FAutoShuffleProductStore::CommitTransform(int32 ProductIdx)
+{
+    uint8 DirtyBits = TransformDirtyBits[ProductIdx];
+    AActor* ObjectActor = ObjectActors[ProductIdx];
+    TransformDirtyBits[ProductIdx] = 0;
+    if (DirtyBits == 0 || ObjectActor == nullptr)
+    {
+        return;
+    }
+    // the move and the scale cost one update of the bounds, the overlaps and the render state
+    FScopedMovementUpdate ScopedUpdate(ObjectActor->GetRootComponent(), EScopedUpdate::DeferredUpdates);
+    FTransform Transform = ObjectActor->GetActorTransform();
+    if ((DirtyBits & TD_Position) != 0)
+    {
+        Transform.SetLocation(Positions[ProductIdx]);
+    }
+    if ((DirtyBits & TD_Scale) != 0)
+    {
+        Transform.SetScale3D(StagedScales[ProductIdx]);
     }
-    // update the class FAUtoSHuffleObject
-    for (auto ProductGroupIt = ProductsWhitelist->CreateIterator(); ProductGroupIt; ++ProductGroupIt)
+    ObjectActor->SetActorTransform(Transform);
+}
+
+int32 FAutoShuffleProductStore::CommitTransforms()
+{
+    int32 CommittedNum = 0;
+    for (int32 ProductIdx = 0; ProductIdx < TransformDirtyBits.Num(); ++ProductIdx)
     {
-        for (auto ProductIt = ProductGroupIt->GetMembers()->CreateIterator(); ProductIt; ++ProductIt)
+        if (TransformDirtyBits[ProductIdx] != 0)
         {
-            if (ProductIt->GetObjectActor() != nullptr)
-            {
-                FVector Position = ProductIt->GetObjectActor()->GetActorLocation();
-                ProductIt->SetPosition(Position);
-            }
+            CommitTransform(ProductIdx);
+            ++CommittedNum;
         }
     }
+    return CommittedNum;
 }
 
-bool FAutoShuffleWindowModule::OrganizeProductsPredicateLowToHigh(const AActor &Actor1, const AActor &Actor2)
+void FAutoShuffleProductStore::StageScale(int32 ProductIdx, const FVector& NewScale3D)
 {
-    FVector Actor1Origin, Actor1Extent, Actor2Origin, Actor2Extent;
-    Actor1.GetActorBounds(false, Actor1Origin, Actor1Extent);
-    Actor2.GetActorBounds(false, Actor2Origin, Actor2Extent);
-    return Actor1Origin.Y - Actor1Extent.Y < Actor2Origin.Y - Actor2Extent.Y;
+    StagedScales[ProductIdx] = NewScale3D;
+    TransformDirtyBits[ProductIdx] |= TD_Scale;
 }
 
-bool FAutoShuffleWindowModule::OrganizeProductsPredicateHighToLow(const AActor &Actor1, const AActor &Actor2)
+void FAutoShuffleProductStore::SetOcclusionRatio(int32 ProductIdx, float NewOcclusionRatio)
 {
-    FVector Actor1Origin, Actor1Extent, Actor2Origin, Actor2Extent;
-    Actor1.GetActorBounds(false, Actor1Origin, Actor1Extent);
-    Actor2.GetActorBounds(false, Actor2Origin, Actor2Extent);
-    return Actor1Origin.Y - Actor1Extent.Y > Actor2Origin.Y - Actor2Extent.Y;
+    OcclusionRatios[ProductIdx] = NewOcclusionRatio;
 }
 
-TArray<class F2DPoint>* FAutoShuffleWindowModule::TriangleRasterizer(const class F2DPointf &V1, const class F2DPointf &V2, const class F2DPointf &V3)
+float FAutoShuffleProductStore::GetOcclusionRatio(int32 ProductIdx) const
 {
-    // Reference: http://forum.devmaster.net/t/advanced-rasterization/6145
-    // Reference: http://answers.unity3d.com/questions/383804/calculate-uv-coordinates-of-3d-point-on-plane-of-m.html
-    // The 3rd implementation
-    TArray<class F2DPoint> *PointArray = new TArray<class F2DPoint>;
+    return OcclusionRatios[ProductIdx];
+}
 
-    float Y1 = V1.Y, Y2 = V2.Y, Y3 = V3.Y;
-    float X1 = V1.X, X2 = V2.X, X3 = V3.X;
-    
-    // Deltas
-    float DX12 = X1 - X2, DX23 = X2 - X3, DX31 = X3 - X1;
-    float DY12 = Y1 - Y2, DY23 = Y2 - Y3, DY31 = Y3 - Y1;
+void FAutoShuffleProductStore::SetParked(int32 ProductIdx, bool bIsParked)
+{
+    // without collision a parked product generates no overlap work and never shows up in GetOverlappingActors
+    AActor* ObjectActor = ObjectActors[ProductIdx];
+    ObjectActor->SetActorEnableCollision(!bIsParked);
+    ObjectActor->SetActorHiddenInGame(bIsParked);
+}
 
-    // Bounding rectangle
-    int MinX = (int)FMath::Min3(X1, X2, X3), MaxX = (int)FMath::Max3(X1, X2, X3);
-    int MinY = (int)FMath::Min3(Y1, Y2, Y3), MaxY = (int)FMath::Max3(Y1, Y2, Y3);
+FAutoShuffleLayoutSnapshot::FAutoShuffleLayoutSnapshot()
+{
+}
 
-    // The area of triangle by cross product a x b = a1b2 - a2b1
-    float TriangleArea = FMath::Abs(DX12 * DY31 - DY12 * DX31);
+FAutoShuffleLayoutSnapshot::~FAutoShuffleLayoutSnapshot()
+{
+}
 
-    // An empty triangle
-    if (TriangleArea < 1e-20f)
+void FAutoShuffleLayoutSnapshot::Capture(const FAutoShuffleProductStore& Store)
+{
+    int32 ProductsNum = Store.Num();
+    Names.Reset(ProductsNum);
+    Transforms.Reset(ProductsNum);
+    States.Reset(ProductsNum);
+    ShelfLevels.Reset(ProductsNum);
+    ShelfOffsets.Reset(ProductsNum);
+    for (int32 ProductIdx = 0; ProductIdx < ProductsNum; ++ProductIdx)
     {
-        return PointArray;
+        Names.Add(Store.GetName(ProductIdx).ToString());
+        Transforms.Add(Store.GetObjectActor(ProductIdx)->GetActorTransform());
+        States.Add(Store.GetStates(ProductIdx));
+        ShelfLevels.Add(Store.GetShelfLevel(ProductIdx));
+        ShelfOffsets.Add(Store.GetShelfOffset(ProductIdx));
     }
+}
 
-    // Constant part of half-edge functions
-    float C1 = DY12 * X1 - DX12 * Y1;
-    float C2 = DY23 * X2 - DX23 * Y2;
-    float C3 = DY31 * X3 - DX31 * Y3;
-
-    float CY1 = C1 + DX12 * MinY - DY12 * MinX;
-    float CY2 = C2 + DX23 * MinY - DY23 * MinX;
-    float CY3 = C3 + DX31 * MinY - DY31 * MinX;
-
-    // Scan through bounding rectangle
-    for (int y = MinY; y <= MaxY; ++y)
+int32 FAutoShuffleLayoutSnapshot::Restore(FAutoShuffleProductStore& Store) const
+{
+    // the products are in the same order unless the whitelist has changed or shuffled its members,
+    // so only fall back to the names when the order doesn't match
+    TMap<FString, int32> SnapshotIndex;
+    int32 RestoredNum = 0;
+    for (int32 ProductIdx = 0; ProductIdx < Store.Num(); ++ProductIdx)
     {
-        // Start value for horizontal scan
-        float CX1 = CY1, CX2 = CY2, CX3 = CY3;
-
-        for (int x = MinX; x <= MaxX; ++x)
+        FString Name = Store.GetName(ProductIdx).ToString();
+        int32 SnapshotIdx = ProductIdx;
+        if (!Names.IsValidIndex(SnapshotIdx) || Names[SnapshotIdx] != Name)
         {
-            if (CX1 > 0 && CX2 > 0 && CX3 > 0)
+            if (SnapshotIndex.Num() == 0)
+            {
+                SnapshotIndex.Reserve(Names.Num());
+                for (int32 NameIdx = 0; NameIdx < Names.Num(); ++NameIdx)
+                {
+                    SnapshotIndex.Add(Names[NameIdx], NameIdx);
+                }
+            }
+            int32* FoundIdx = SnapshotIndex.Find(Name);
+            if (FoundIdx == nullptr)
             {
-                // calculate intepolated z
-                float DXP1 = x - V1.X, DXP2 = x - V2.X, DXP3 = x - V3.X;
-                float DYP1 = y - V1.Y, DYP2 = y - V2.Y, DYP3 = y - V3.Y;
-                // The area of slides by cross product a x b = a1b2 - a2b1
-                float A1 = FMath::Abs(DXP2 * DYP3 - DXP3 * DYP2) / TriangleArea;
-                float A2 = FMath::Abs(DXP1 * DYP3 - DXP3 * DYP1) / TriangleArea;
-                float A3 = FMath::Abs(DXP1 * DYP2 - DXP2 * DYP1) / TriangleArea;
-                float z = A1 * V1.Z + A2 * V2.Z + A3 * V3.Z;
-                PointArray->Add(F2DPoint(x, y, z));
+                continue;
             }
-            CX1 -= DY12;
-            CX2 -= DY23;
-            CX3 -= DY31;
+            SnapshotIdx = *FoundIdx;
         }
-        CY1 += DX12;
-        CY2 += DX23;
-        CY3 += DX31;
+        Store.SetTransform(ProductIdx, Transforms[SnapshotIdx]);
+        Store.SetStates(ProductIdx, States[SnapshotIdx]);
+        Store.SetShelfLevel(ProductIdx, ShelfLevels[SnapshotIdx]);
+        Store.SetShelfOffset(ProductIdx, ShelfOffsets[SnapshotIdx]);
+        ++RestoredNum;
     }
-    return PointArray;
+    return RestoredNum;
 }
 
-FAutoShuffleObject::FAutoShuffleObject()
+bool FAutoShuffleLayoutSnapshot::SaveToFile(const FString& FileDir)
 {
-    Scale = 1.f;
-    Name = TEXT("Uninitialized Object Name");
-    Position = FVector(0.f, 0.f, 0.f);
-    Rotation = FVector(0.f, 0.f, 0.f);
-    ObjectActor = nullptr;
-    bIsDiscarded = false;
-    bIsOnShelf = false;
-    fShelfOffset = 0.f;
+    TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*FileDir));
+    if (!FileWriter.IsValid())
+    {
+        return false;
+    }
+    Serialize(*FileWriter);
+    return FileWriter->Close();
 }
 
-FAutoShuffleObject::~FAutoShuffleObject()
+bool FAutoShuffleLayoutSnapshot::LoadFromFile(const FString& FileDir)
 {
+    TUniquePtr<FArchive> FileReader(IFileManager::Get().CreateFileReader(*FileDir));
+    if (!FileReader.IsValid())
+    {
+        return false;
+    }
+    Serialize(*FileReader);
+    return !FileReader->IsError() && Names.Num() == Transforms.Num() && Names.Num() == States.Num() &&
+        Names.Num() == ShelfLevels.Num() && Names.Num() == ShelfOffsets.Num();
 }
 
-void FAutoShuffleObject::SetName(FString& NewName)
+int32 FAutoShuffleLayoutSnapshot::Num() const
 {
-    Name = NewName;
+    return Names.Num();
 }
 
-FString FAutoShuffleObject::GetName() const
+void FAutoShuffleLayoutSnapshot::Serialize(FArchive& Ar)
 {
-    return Name;
+    uint32 Magic = 0x534C5341, Version = 1;
+    Ar << Magic << Version;
+    if (Magic != 0x534C5341 || Version != 1)
+    {
+        Ar.SetError();
+        return;
+    }
+    Ar << Names << Transforms << States << ShelfLevels << ShelfOffsets;
 }
 
-void FAutoShuffleObject::SetPosition(FVector& NewPosition)
+FAutoShuffleNamePattern::FAutoShuffleNamePattern()
 {
-    Position = NewPosition;
-    ObjectActor->SetActorLocation(Position);
+    Width = 0;
 }
 
-FVector FAutoShuffleObject::GetPosition() const
+FAutoShuffleNamePattern::~FAutoShuffleNamePattern()
 {
-    return Position;
 }
 
-void FAutoShuffleObject::SetRotation(FVector& NewRotation)
+bool FAutoShuffleNamePattern::Parse(const FString& Pattern)
+{
+    Ranges.Reset();
+    Width = 0;
+    int32 OpenIdx, CloseIdx;
+    if (!Pattern.FindChar(TEXT('{'), OpenIdx) || !Pattern.FindLastChar(TEXT('}'), CloseIdx) || CloseIdx < OpenIdx)
+    {
+        return false;
+    }
+    Prefix = Pattern.Left(OpenIdx);
+    Suffix = Pattern.Mid(CloseIdx + 1);
+    TArray<FString> Items;
+    Pattern.Mid(OpenIdx + 1, CloseIdx - OpenIdx - 1).ParseIntoArray(Items, TEXT(","), true);
+    for (auto ItemIt = Items.CreateIterator(); ItemIt; ++ItemIt)
+    {
+        // each item is either a single index or an inclusive range First..Last
+        FString Item = ItemIt->Trim().TrimTrailing(), First, Last;
+        if (!Item.Split(TEXT(".."), &First, &Last))
+        {
+            First = Item;
+            Last = Item;
+        }
+        First = First.Trim().TrimTrailing();
+        Last = Last.Trim().TrimTrailing();
+        // only plain digits: a sign or a decimal point would end up inside the padded names
+        if (!IsIndex(First) || !IsIndex(Last))
+        {
+            Ranges.Reset();
+            return false;
+        }
+        if (Width == 0)
+        {
+            Width = First.Len();
+        }
+        int32 FirstIndex = FCString::Atoi(*First), LastIndex = FCString::Atoi(*Last);
+        Ranges.Add(FIntPoint(FMath::Min(FirstIndex, LastIndex), FMath::Max(FirstIndex, LastIndex)));
+    }
+    // every name is looked up in the level while the whitelist is read, so a typo like {0..2000000000} is refused
+    int64 NamesNum = GetNamesNum();
+    if (NamesNum > AUTO_SHUFFLE_NAME_PATTERN_MAX_NAMES)
+    {
+        UE_LOG(LogAutoShuffle, Warning, TEXT("Name pattern %s expands to %lld names, more than %d"), *Pattern, NamesNum, AUTO_SHUFFLE_NAME_PATTERN_MAX_NAMES);
+        Ranges.Reset();
+        return false;
+    }
+    return Ranges.Num() > 0;
+}
+
+void FAutoShuffleNamePattern::SetIndices(const TArray<float>& NewIndices)
 {
-    Rotation = NewRotation;
+    Ranges.Reset(NewIndices.Num());
+    for (auto IndexIt = NewIndices.CreateConstIterator(); IndexIt; ++IndexIt)
+    {
+        int32 Index = FMath::RoundToInt(*IndexIt);
+        if (Index < 0)
+        {
+            UE_LOG(LogAutoShuffle, Warning, TEXT("Negative index %d of %s{...}%s is skipped"), Index, *Prefix, *Suffix);
+            continue;
+        }
+        Ranges.Add(FIntPoint(Index, Index));
+    }
 }
 
-FVector FAutoShuffleObject::GetRotation() const
+int32 FAutoShuffleNamePattern::Num() const
 {
-    return Rotation;
+    return int32(FMath::Min(GetNamesNum(), int64(MAX_int32)));
 }
 
-void FAutoShuffleObject::SetScale(float NewScale)
+int64 FAutoShuffleNamePattern::GetNamesNum() const
 {
-    Scale = NewScale;
-    if (ObjectActor != nullptr)
+    int64 NamesNum = 0;
+    for (auto RangeIt = Ranges.CreateConstIterator(); RangeIt; ++RangeIt)
     {
-        ObjectActor->SetActorScale3D(FVector(Scale, Scale, Scale));
+        NamesNum += int64(RangeIt->Y) - RangeIt->X + 1;
     }
+    return NamesNum;
 }
 
-void FAutoShuffleObject::ShrinkScale()
+bool FAutoShuffleNamePattern::IsIndex(const FString& Item)
 {
-    // shrink the scale on z to 1/3 of x and/or y
-    if (ObjectActor != nullptr)
+    if (Item.IsEmpty())
+    {
+        return false;
+    }
+    for (int32 CharIdx = 0; CharIdx < Item.Len(); ++CharIdx)
     {
-        ObjectActor->SetActorScale3D(FVector(Scale, Scale, Scale * 0.3f));
+        if (!FChar::IsDigit(Item[CharIdx]))
+        {
+            return false;
+        }
     }
+    return FCString::Atoi64(*Item) <= MAX_int32;
 }
 
-void FAutoShuffleObject::ExpandScale()
+FString FAutoShuffleNamePattern::GetName(int32 NameIdx) const
 {
-    /** This function restores the object scale up to the scale indicated by private variable Scale.
-     *  The goal is to expand the scale while the bottom is kept. So it's like the product growing up
-     *  from the shelf 
-     *  @note the scaling process does not guarantee the position unchanged
-     */
-    if (ObjectActor != nullptr)
+    for (auto RangeIt = Ranges.CreateConstIterator(); RangeIt; ++RangeIt)
     {
-        // get the bottom and the Origin.XY of the product. These are the variables that the product must keep
-        FVector ProductOrigin, ProductExtent;
-        ObjectActor->GetActorBounds(false, ProductOrigin, ProductExtent);
-        float ConstBottomLine = ProductOrigin.Z - ProductExtent.Z;
-        float ProductOriginX = ProductOrigin.X;
-        float ProductOriginY = ProductOrigin.Y;
-        // change the scale.x and scale.y to scale.z to start the expansion
-        float CurrentScale = ObjectActor->GetActorScale3D().Z;
-        ObjectActor->SetActorScale3D(FVector(CurrentScale, CurrentScale, CurrentScale));
-        // loop
-        while (true)
+        int32 RangeNum = RangeIt->Y - RangeIt->X + 1;
+        if (NameIdx < RangeNum)
         {
-            // Get the overlapping actors
-            TArray<AActor*> OverlappingActors;
-            ObjectActor->GetOverlappingActors(OverlappingActors);
-            // if overlapped, we stop
-            if (OverlappingActors.Num() != 0)
-            {
-                CurrentScale -= 0.1;
-                ObjectActor->SetActorScale3D(FVector(CurrentScale, CurrentScale, CurrentScale));
-                ObjectActor->GetActorBounds(false, ProductOrigin, ProductExtent);
-                float CurrentBottomLine = ProductOrigin.Z - ProductExtent.Z;
-                float ProductZLift = ConstBottomLine - CurrentBottomLine;
-                Position.Z += ProductZLift;
-                Position.X += ProductOriginX - ProductOrigin.X;
-                Position.Y += ProductOriginY - ProductOrigin.Y;
-                this->SetPosition(Position);
-                break;
-            }
-            // if the currentscale is already the Scale specified in the whitelist, we stop
-            if (CurrentScale >= Scale)
+            FString Digits = FString::FromInt(RangeIt->X + NameIdx);
+            if (Digits.Len() < Width)
             {
-                ObjectActor->SetActorScale3D(FVector(Scale, Scale, Scale));
-                ObjectActor->GetActorBounds(false, ProductOrigin, ProductExtent);
-                float CurrentBottomLine = ProductOrigin.Z - ProductExtent.Z;
-                float ProductZLift = ConstBottomLine - CurrentBottomLine;
-                Position.Z += ProductZLift;
-                Position.X += ProductOriginX - ProductOrigin.X;
-                Position.Y += ProductOriginY - ProductOrigin.Y;
-                this->SetPosition(Position);
-                break;
+                Digits = FString::ChrN(Width - Digits.Len(), TEXT('0')) + Digits;
             }
-            // otherwise, we increase the scale wholely, then adjust the bottom to the ConstBottomLine and the origin.XY to the original Origin.XY
-            CurrentScale += 0.1;
-            ObjectActor->SetActorScale3D(FVector(CurrentScale, CurrentScale, CurrentScale));
-            ObjectActor->GetActorBounds(false, ProductOrigin, ProductExtent);
-            float CurrentBottomLine = ProductOrigin.Z - ProductExtent.Z;
-            float ProductZLift = ConstBottomLine - CurrentBottomLine;
-            Position.Z += ProductZLift;
-            Position.X += ProductOriginX - ProductOrigin.X;
-            Position.Y += ProductOriginY - ProductOrigin.Y;
-            this->SetPosition(Position);
+            return Prefix + Digits + Suffix;
         }
+        NameIdx -= RangeNum;
     }
+    return FString();
 }
 
-float FAutoShuffleObject::GetScale() const
+FAutoShuffleDiscoverySettings::FAutoShuffleDiscoverySettings()
 {
-    return Scale;
+    bIsEnabled = false;
+    bGroupByMesh = false;
+    bAssignByRules = false;
+    MinMembers = 2;
+    Scale = 1.f;
 }
 
-void FAutoShuffleObject::SetObjectActor(AActor* NewObjectActor)
+FAutoShuffleShelfDescription::FAutoShuffleShelfDescription()
 {
-    // We don't delete anything
-    ObjectActor = NewObjectActor;
+    Scale = 1.f;
 }
 
-AActor* FAutoShuffleObject::GetObjectActor() const
+FAutoShuffleProductGroupDescription::FAutoShuffleProductGroupDescription()
 {
-    return ObjectActor;
+    bIsDiscarded = false;
+    Scale = 1.f;
+    DecompositionAccuracy = -1.f;
+    DecompositionMaxHullVerts = 0;
 }
 
-void FAutoShuffleObject::Discard()
+FAutoShuffleOcclusionMesh::FAutoShuffleOcclusionMesh()
 {
-    bIsDiscarded = true;
+    bIsFullDetailLoaded = false;
 }
 
-bool FAutoShuffleObject::IsDiscarded()
+const FAutoShuffleOcclusionGeometry* FAutoShuffleOcclusionMesh::GetFullDetail(UStaticMesh* StaticMesh)
 {
-    return bIsDiscarded;
+    if (!bIsFullDetailLoaded)
+    {
+        bIsFullDetailLoaded = true;
+        if (StaticMesh->SourceModels.Num() > 0)
+        {
+            FRawMesh RawMesh;
+            StaticMesh->SourceModels[0].RawMeshBulkData->LoadRawMesh(RawMesh);
+            FullDetail.Vertices = MoveTemp(RawMesh.VertexPositions);
+            FullDetail.Indices = MoveTemp(RawMesh.WedgeIndices);
+        }
+    }
+    return FullDetail.Indices.Num() > 0 ? &FullDetail : nullptr;
 }
 
-void FAutoShuffleObject::ResetDiscard()
+const FAutoShuffleOcclusionGeometry* FAutoShuffleOcclusionMesh::GetRenderLOD(UStaticMesh* StaticMesh, int32 LODIdx)
 {
-    bIsDiscarded = false;
+    if (RenderLODs.Num() <= LODIdx)
+    {
+        RenderLODs.SetNum(LODIdx + 1);
+    }
+    FAutoShuffleOcclusionGeometry& Geometry = RenderLODs[LODIdx];
+    if (Geometry.Indices.Num() == 0)
+    {
+        FStaticMeshLODResources& LODModel = StaticMesh->RenderData->LODResources[LODIdx];
+        int32 NumVerts = LODModel.PositionVertexBuffer.GetNumVertices();
+        Geometry.Vertices.SetNumUninitialized(NumVerts);
+        for (int32 VertIdx = 0; VertIdx < NumVerts; ++VertIdx)
+        {
+            Geometry.Vertices[VertIdx] = LODModel.PositionVertexBuffer.VertexPosition(VertIdx);
+        }
+        LODModel.IndexBuffer.GetCopy(Geometry.Indices);
+    }
+    return &Geometry;
 }
 
-void FAutoShuffleObject::SetShelfOffset(float NewShelfOffset)
+FAutoShuffleDecompositionJob::FAutoShuffleDecompositionJob()
 {
-    fShelfOffset = NewShelfOffset;
+    bIsRunning = false;
+    Accuracy = 1.f;
+    MaxHullVerts = 32;
+    bIsCurrent = false;
+    bIsCached = false;
+    Seconds = 0.0;
 }
 
-float FAutoShuffleObject::GetShelfOffset() const
+FAutoShuffleExportBuffer::FAutoShuffleExportBuffer(FArchive* NewArchive, int32 NewChunkSize)
 {
-    return fShelfOffset;
+    Archive = NewArchive;
+    ChunkSize = NewChunkSize;
+    Buffer.Reserve(ChunkSize);
 }
 
-bool FAutoShuffleObject::IsContainedIn(FVector &BoundOrigin, FVector &BoundExtent)
+FAutoShuffleExportBuffer::~FAutoShuffleExportBuffer()
 {
-    if (ObjectActor != nullptr)
-    {
-        FVector ObjectOrigin, ObjectExtent;
-        ObjectActor->GetActorBounds(false, ObjectOrigin, ObjectExtent);
-        if (BoundOrigin.X - BoundExtent.X > ObjectOrigin.X - ObjectExtent.X)
-            return false;
-        if (BoundOrigin.X + BoundExtent.X < ObjectOrigin.X + ObjectExtent.X)
-            return false;
-        if (BoundOrigin.Y - BoundExtent.Y > ObjectOrigin.Y - ObjectOrigin.Y)
-            return false;
-        if (BoundOrigin.Y + BoundExtent.Y < ObjectOrigin.Y + ObjectExtent.Y)
-            return false;
-        if (BoundOrigin.Z - BoundExtent.Z > ObjectOrigin.Z - ObjectExtent.Z)
-            return false;
-        if (BoundOrigin.Z + BoundExtent.Z < ObjectOrigin.Z + ObjectExtent.Z)
-            return false;
-        return true;
-    }
-    else
-    {
-        return false;
-    }
+    Flush();
 }
 
-bool FAutoShuffleObject::IsOnShelf() const
+void FAutoShuffleExportBuffer::AppendText(const FString& Text)
 {
-    return bIsOnShelf;
+    FTCHARToUTF8 Converted(*Text);
+    AppendBytes(Converted.Get(), Converted.Length());
 }
 
-void FAutoShuffleObject::SetOnShelf()
+void FAutoShuffleExportBuffer::AppendString(const FString& Text)
 {
-    bIsOnShelf = true;
+    FTCHARToUTF8 Converted(*Text);
+    int32 Length = Converted.Length();
+    AppendValue(Length);
+    AppendBytes(Converted.Get(), Length);
 }
 
-void FAutoShuffleObject::ResetOnShelf()
+void FAutoShuffleExportBuffer::AppendBytes(const void* Data, int32 Num)
 {
-    bIsOnShelf = false;
+    Buffer.Append(static_cast<const uint8*>(Data), Num);
+    if (Buffer.Num() >= ChunkSize)
+    {
+        Flush();
+    }
 }
 
-FAutoShuffleShelf::FAutoShuffleShelf() : FAutoShuffleObject()
+void FAutoShuffleExportBuffer::AppendQuat(const FQuat& Quat)
 {
-    ShelfBase = nullptr;
-    ShelfOffset = nullptr;
+    AppendValue(Quat.X);
+    AppendValue(Quat.Y);
+    AppendValue(Quat.Z);
+    AppendValue(Quat.W);
 }
 
-FAutoShuffleShelf::~FAutoShuffleShelf()
+void FAutoShuffleExportBuffer::Flush()
 {
-    if (ShelfBase != nullptr)
-    {
-        delete ShelfBase;
-    }
-    if (ShelfOffset != nullptr)
+    if (Buffer.Num() > 0)
     {
-        delete ShelfOffset;
+        Archive->Serialize(Buffer.GetData(), Buffer.Num());
+        Buffer.Reset();
     }
 }
 
-void FAutoShuffleShelf::SetShelfBase(TArray<float>* NewShelfBase)
+FAutoShuffleSettings::FAutoShuffleSettings()
 {
-    if (ShelfBase != nullptr)
-    {
-        delete ShelfBase;
-    }
-    ShelfBase = NewShelfBase;
+    Density = 0.5f;
+    Proxmity = 0.5f;
+    bIsOrganizing = false;
+    bIsPerGroup = false;
+    bIsRowStacking = false;
+    OcclusionThreshold = 0.9f;
+    bIsProxyErrorReported = false;
 }
 
-TArray<float>* FAutoShuffleShelf::GetShelfBase() const
+FAutoShuffleGroupPlacement::FAutoShuffleGroupPlacement()
 {
-    return ShelfBase;
+    Reset();
 }
 
-void FAutoShuffleShelf::SetShelfOffset(TArray<float> *NewShelfOffset)
+void FAutoShuffleGroupPlacement::Reset()
 {
-    if (ShelfOffset != nullptr)
-    {
-        delete ShelfOffset;
-    }
-    ShelfOffset = NewShelfOffset;
+    ShelfIdx = INDEX_NONE;
+    GroupIdx = INDEX_NONE;
+    NextMemberIdx = 0;
+    BoundingBoxOrigin = FVector::ZeroVector;
+    BoundingBoxExtent = FVector::ZeroVector;
+    ShelfBaseZ.Reset();
+    ShelfOffsetZ.Reset();
+    Footprints.Reset();
+    FootprintExtents.Reset();
+    bIsSelected.Reset();
+    bIsStacked.Reset();
+    ShelfBaseIdx = 0;
+    Anchor = FVector::ZeroVector;
 }
 
-TArray<float>* FAutoShuffleShelf::GetShelfOffset() const
+FAutoShufflePlacementStats::FAutoShufflePlacementStats()
 {
-    return ShelfOffset;
+    ProductsNum = 0;
+    PlacedNum = 0;
+    QueriesNum = 0;
+    RetriesNum = 0;
+    RetryBoundHitsNum = 0;
+    DiscardedByDensityNum = 0;
+    DiscardedNoRoomNum = 0;
+    DiscardedNoRoomNearAnchorNum = 0;
+    DiscardedNoCapacityNum = 0;
+    DiscardedKnownToFailNum = 0;
+    StackedNum = 0;
+    PushedNum = 0;
+    PushStepsNum = 0;
+    ExpansionStepsNum = 0;
 }
 
-FAutoShuffleProductGroup::FAutoShuffleProductGroup()
+FAutoShufflePlacementStats& FAutoShufflePlacementStats::operator+=(const FAutoShufflePlacementStats& Other)
 {
-    Members = nullptr;
-    Name = TEXT("Uninitialized Object Name");
-    ShelfName = TEXT("Unintialized Object Name");
-    bIsDiscarded = false;
+    ProductsNum += Other.ProductsNum;
+    PlacedNum += Other.PlacedNum;
+    QueriesNum += Other.QueriesNum;
+    RetriesNum += Other.RetriesNum;
+    RetryBoundHitsNum += Other.RetryBoundHitsNum;
+    DiscardedByDensityNum += Other.DiscardedByDensityNum;
+    DiscardedNoRoomNum += Other.DiscardedNoRoomNum;
+    DiscardedNoRoomNearAnchorNum += Other.DiscardedNoRoomNearAnchorNum;
+    DiscardedNoCapacityNum += Other.DiscardedNoCapacityNum;
+    DiscardedKnownToFailNum += Other.DiscardedKnownToFailNum;
+    StackedNum += Other.StackedNum;
+    PushedNum += Other.PushedNum;
+    PushStepsNum += Other.PushStepsNum;
+    ExpansionStepsNum += Other.ExpansionStepsNum;
+    return *this;
 }
 
-FAutoShuffleProductGroup::~FAutoShuffleProductGroup()
+void FAutoShufflePlacementStats::AddPush(int32 StepsNum)
 {
-    if (Members != nullptr)
-    {
-        delete Members;
-    }
+    ++PushedNum;
+    PushStepsNum += StepsNum;
 }
 
-void FAutoShuffleProductGroup::SetMembers(TArray<FAutoShuffleObject>* NewMembers)
+float FAutoShufflePlacementStats::GetAveragePushDistance() const
 {
-    if (Members != nullptr)
-    {
-        delete Members;
-    }
-    Members = NewMembers;
+    return PushedNum > 0 ? PushStepsNum * AUTO_SHUFFLE_INC_STEP / PushedNum : 0.f;
 }
 
-TArray<FAutoShuffleObject>* FAutoShuffleProductGroup::GetMembers() const
+FString FAutoShufflePlacementStats::ToString() const
 {
-    return Members;
+    return FString::Printf(TEXT("%d / %d placed, %d queries, %d retries (%d hit the bound), discarded %d by density, %d without room, %d without room near the anchor, %d on a full shelf, %d known not to fit, %d stacked in rows, push %.1f on average, %d expansion steps"),
+        PlacedNum, ProductsNum, QueriesNum, RetriesNum, RetryBoundHitsNum, DiscardedByDensityNum, DiscardedNoRoomNum, DiscardedNoRoomNearAnchorNum, DiscardedNoCapacityNum, DiscardedKnownToFailNum, StackedNum, GetAveragePushDistance(), ExpansionStepsNum);
 }
 
-void FAutoShuffleProductGroup::SetName(FString& NewName)
+FString FAutoShufflePlacementStats::GetCsvHeader()
 {
-    Name = NewName;
+    return TEXT("Products,Placed,Queries,Retries,RetryBoundHits,DiscardedByDensity,DiscardedNoRoom,DiscardedNoRoomNearAnchor,DiscardedNoCapacity,DiscardedKnownToFail,Stacked,AveragePushDistance,ExpansionSteps");
 }
 
-FString FAutoShuffleProductGroup::GetName() const
+FString FAutoShufflePlacementStats::ToCsvRow() const
 {
-    return Name;
+    return FString::Printf(TEXT("%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%f,%d"), ProductsNum, PlacedNum, QueriesNum, RetriesNum, RetryBoundHitsNum,
+        DiscardedByDensityNum, DiscardedNoRoomNum, DiscardedNoRoomNearAnchorNum, DiscardedNoCapacityNum, DiscardedKnownToFailNum, StackedNum, GetAveragePushDistance(), ExpansionStepsNum);
 }
 
-void FAutoShuffleProductGroup::SetShelfName(FString& NewShelfName)
+FAutoShufflePhaseTimings::FAutoShufflePhaseTimings()
 {
-    ShelfName = NewShelfName;
 }
 
-FString FAutoShuffleProductGroup::GetShelfName() const
+FAutoShufflePhaseTimings::~FAutoShufflePhaseTimings()
 {
-    return ShelfName;
 }
 
-void FAutoShuffleProductGroup::Discard()
+void FAutoShufflePhaseTimings::Reset()
 {
-    bIsDiscarded = true;
+    Phases.Reset();
+    PhaseSeconds.Reset();
 }
 
-void FAutoShuffleProductGroup::ResetDiscard()
+void FAutoShufflePhaseTimings::Add(const FString& Phase, double Seconds)
 {
-    bIsDiscarded = false;
+    // phases keep the order they first ran in; a run has a handful of them
+    int32 PhaseIdx = Phases.Find(Phase);
+    if (PhaseIdx == INDEX_NONE)
+    {
+        PhaseIdx = Phases.Add(Phase);
+        PhaseSeconds.Add(0.0);
+    }
+    PhaseSeconds[PhaseIdx] += Seconds;
 }
 
-bool FAutoShuffleProductGroup::IsDiscarded()
+double FAutoShufflePhaseTimings::GetTotalSeconds() const
 {
-    return bIsDiscarded;
+    double TotalSeconds = 0.0;
+    for (auto SecondsIt = PhaseSeconds.CreateConstIterator(); SecondsIt; ++SecondsIt)
+    {
+        TotalSeconds += *SecondsIt;
+    }
+    return TotalSeconds;
+}
+
+FString FAutoShufflePhaseTimings::ToString() const
+{
+    TArray<FString> Entries;
+    for (int32 PhaseIdx = 0; PhaseIdx < Phases.Num(); ++PhaseIdx)
+    {
+        Entries.Add(FString::Printf(TEXT("%s %.1f ms"), *Phases[PhaseIdx], PhaseSeconds[PhaseIdx] * 1000.0));
+    }
+    return FString::Join(Entries, TEXT(", "));
+}
+
+bool FAutoShufflePhaseTimings::AppendToFile(const FString& FileDir, const FString& RunName) const
+{
+    bool bIsNewFile = !IFileManager::Get().FileExists(*FileDir);
+    TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*FileDir, FILEWRITE_Append));
+    if (!FileWriter.IsValid())
+    {
+        return false;
+    }
+    FAutoShuffleExportBuffer Buffer(FileWriter.Get());
+    if (bIsNewFile)
+    {
+        Buffer.AppendText(TEXT("Date,Run,Phase,Milliseconds\n"));
+    }
+    // one row per phase, so that runs over time can be compared phase by phase
+    FString Date = FDateTime::Now().ToString();
+    for (int32 PhaseIdx = 0; PhaseIdx < Phases.Num(); ++PhaseIdx)
+    {
+        Buffer.AppendText(FString::Printf(TEXT("%s,%s,%s,%.3f\n"), *Date, *RunName, *Phases[PhaseIdx], PhaseSeconds[PhaseIdx] * 1000.0));
+    }
+    Buffer.Flush();
+    return FileWriter->Close();
+}
+
+FAutoShufflePhaseScope::FAutoShufflePhaseScope(FAutoShufflePhaseTimings& NewTimings, const TCHAR* NewPhase)
+    : Timings(NewTimings)
+{
+    Phase = NewPhase;
+    StartTime = FPlatformTime::Seconds();
+}
+
+FAutoShufflePhaseScope::~FAutoShufflePhaseScope()
+{
+    Timings.Add(Phase, FPlatformTime::Seconds() - StartTime);
 }
 
 F2DPoint::F2DPoint(int NewX, int NewY, float NewZ)
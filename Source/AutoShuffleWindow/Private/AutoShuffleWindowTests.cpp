@@ -0,0 +1,686 @@
+// Copyright 1998-2016 Epic Games, Inc. All Rights Reserved.
+
+#include "AutoShuffleWindowPrivatePCH.h"
+
+#include "Engine.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#define AUTO_SHUFFLE_RASTERIZER_TEST_TRIANGLES 2000
+#define AUTO_SHUFFLE_RASTERIZER_TEST_QUADS 1000
+#define AUTO_SHUFFLE_RASTERIZER_TEST_PERF_TRIANGLES 20000
+#define AUTO_SHUFFLE_RASTERIZER_TEST_DEPTH_TOLERANCE 1e-3f
+#define AUTO_SHUFFLE_BENCHMARK_SHELF_HEIGHT 200.f
+#define AUTO_SHUFFLE_BENCHMARK_SHELF_DEPTH 50.f
+#define AUTO_SHUFFLE_BENCHMARK_PLATE_THICKNESS 2.f
+#define AUTO_SHUFFLE_BENCHMARK_PRODUCT_SCALE 0.1f
+
+/** A rasterizer of counter-clockwise triangles into new pixels, as TriangleRasterizer */
+typedef TArray<F2DPoint>* (*FAutoShuffleTriangleRasterizer)(const F2DPointf &V1, const F2DPointf &V2, const F2DPointf &V3);
+
+class FAutoShuffleRasterizerReport
+{
+public:
+    /** Construct with all the counters zeroed */
+    FAutoShuffleRasterizerReport();
+
+    /** Get the coverage counters in one line for the log */
+    FString ToString() const;
+
+    /** Whether the rasterizer drew anything else than the reference, or left holes or overlaps along the shared edges */
+    bool HasErrors() const;
+
+    /** The triangles checked, the pixels the reference drew for them, and the triangles with any difference */
+    int32 TrianglesNum;
+    int64 PixelsNum;
+    int32 MismatchedTrianglesNum;
+
+    /** The pixels only the reference drew, only the rasterizer drew, and the rasterizer drew twice */
+    int32 MissingPixelsNum;
+    int32 ExtraPixelsNum;
+    int32 DuplicatePixelsNum;
+
+    /** The pixels whose relative depth error is over the tolerance, and the largest relative depth error */
+    int32 DepthErrorsNum;
+    float MaxDepthError;
+
+    /** The shared edges checked, and the pixels next to them drawn never and more than once */
+    int32 SharedEdgesNum;
+    int32 HolesNum;
+    int32 OverlapsNum;
+};
+
+/** The checks and the benchmark behind the AutoShuffle automation tests, on the private steps of the module */
+class FAutoShuffleWindowTests
+{
+public:
+    /** Check TriangleRasterizer against the reference on random and degenerate triangles */
+    static void TestRasterizerCoverage(FAutomationTestBase& Test);
+
+    /** Check that TriangleRasterizer draws every pixel of random convex quads split in two triangles once */
+    static void TestRasterizerWatertightness(FAutomationTestBase& Test);
+
+    /** Measure the throughput of TriangleRasterizer and of the reference on small, medium and large triangles */
+    static void TestRasterizerThroughput(FAutomationTestBase& Test);
+
+    /** Shuffle and compute the occlusion of a synthetic scene of the given number of products, and append the time and the memory of the run to the benchmark report.
+     *  The scene is built in a transient world, and the run refuses to replace a whitelist already read in the window.
+     *  The shelves, the levels, the members of a group and the seed can be set on the command line, e.g. -AutoShuffleBenchmarkShelves=20 */
+    static void RunBenchmark(FAutomationTestBase& Test, int32 ProductsNum);
+
+private:
+    /** A slow rasterizer spelling out the fill convention of TriangleRasterizer pixel by pixel, to check it against */
+    static TArray<F2DPoint>* ReferenceTriangleRasterizer(const F2DPointf &V1, const F2DPointf &V2, const F2DPointf &V3);
+
+    /** Compare the pixels and the depths a rasterizer draws for a triangle, in each winding, to the reference */
+    static void CheckRasterizerCoverage(FAutoShuffleTriangleRasterizer Rasterizer, const F2DPointf &V1, const F2DPointf &V2, const F2DPointf &V3, FAutoShuffleRasterizerReport& Report);
+
+    /** Count the pixels inside a convex quad that a rasterizer misses or draws twice when the quad is split along V1 V3 */
+    static void CheckRasterizerWatertightness(FAutoShuffleTriangleRasterizer Rasterizer, const F2DPointf &V1, const F2DPointf &V2, const F2DPointf &V3, const F2DPointf &V4, FAutoShuffleRasterizerReport& Report);
+
+    /** Rasterize every three vertices in both windings and return the seconds it took */
+    static double MeasureRasterizerThroughput(FAutoShuffleTriangleRasterizer Rasterizer, const TArray<F2DPointf>& Vertices, int64& OutPixelsNum);
+
+    /** Spawn the shelves and the products of a synthetic scene made of basic shapes, and describe them as a whitelist */
+    static void BuildBenchmarkScene(UWorld* World, int32 ShelvesNum, int32 LevelsNum, int32 GroupsNum, int32 MembersNum, FAutoShuffleWhitelistDescription& OutWhitelist);
+
+    /** Get the CSV file the benchmark results are appended to */
+    static FString GetBenchmarkFileDir();
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAutoShuffleRasterizerCoverageTest, "AutoShuffle.Rasterizer.Coverage", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAutoShuffleRasterizerCoverageTest::RunTest(const FString& Parameters)
+{
+    FAutoShuffleWindowTests::TestRasterizerCoverage(*this);
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAutoShuffleRasterizerWatertightnessTest, "AutoShuffle.Rasterizer.Watertightness", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FAutoShuffleRasterizerWatertightnessTest::RunTest(const FString& Parameters)
+{
+    FAutoShuffleWindowTests::TestRasterizerWatertightness(*this);
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAutoShuffleRasterizerThroughputTest, "AutoShuffle.Rasterizer.Throughput", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FAutoShuffleRasterizerThroughputTest::RunTest(const FString& Parameters)
+{
+    FAutoShuffleWindowTests::TestRasterizerThroughput(*this);
+    return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FAutoShuffleBenchmarkTest, "AutoShuffle.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+void FAutoShuffleBenchmarkTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+    // one test per scene size, so that a headless editor can run them all, e.g.
+    // -nullrhi -ExecCmds="Automation RunTests AutoShuffle.Benchmark; Quit" -AutoShuffleBenchmarkSizes=1000,50000
+    FString SizesParam = TEXT("1000,5000,20000,50000");
+    FParse::Value(FCommandLine::Get(), TEXT("AutoShuffleBenchmarkSizes="), SizesParam);
+    TArray<FString> Sizes;
+    SizesParam.ParseIntoArray(Sizes, TEXT(","), true);
+    for (auto SizeIt = Sizes.CreateConstIterator(); SizeIt; ++SizeIt)
+    {
+        OutBeautifiedNames.Add(*SizeIt);
+        OutTestCommands.Add(*SizeIt);
+    }
+}
+
+bool FAutoShuffleBenchmarkTest::RunTest(const FString& Parameters)
+{
+    FAutoShuffleWindowTests::RunBenchmark(*this, FCString::Atoi(*Parameters));
+    return true;
+}
+
+void FAutoShuffleWindowTests::TestRasterizerCoverage(FAutomationTestBase& Test)
+{
+    FRandomStream Stream(0);
+    float Width = OCCLUSION_VISIBILITY_RESOLUTION_WIDTH, Height = OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT;
+
+    // coverage and depth on random triangles of all sizes, half of them with the vertices on the pixel grid
+    FAutoShuffleRasterizerReport RandomReport;
+    for (int32 TriangleIdx = 0; TriangleIdx < AUTO_SHUFFLE_RASTERIZER_TEST_TRIANGLES; ++TriangleIdx)
+    {
+        F2DPointf Center(Stream.FRandRange(0.f, Width), Stream.FRandRange(0.f, Height), 0.f);
+        float Size = FMath::Pow(2.f, Stream.FRandRange(-1.f, 7.f));
+        TArray<F2DPointf> Vertices;
+        for (int32 VertexIdx = 0; VertexIdx < 3; ++VertexIdx)
+        {
+            F2DPointf Vertex(Center.X + Stream.FRandRange(-Size, Size), Center.Y + Stream.FRandRange(-Size, Size), Stream.FRandRange(100.f, 10000.f));
+            if (TriangleIdx % 2 == 1)
+            {
+                Vertex.X = FMath::RoundToFloat(Vertex.X);
+                Vertex.Y = FMath::RoundToFloat(Vertex.Y);
+            }
+            Vertices.Add(Vertex);
+        }
+        CheckRasterizerCoverage(&FAutoShuffleWindowModule::TriangleRasterizer, Vertices[0], Vertices[1], Vertices[2], RandomReport);
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("Rasterizer coverage on random triangles: %s"), *RandomReport.ToString());
+    if (RandomReport.HasErrors())
+    {
+        Test.AddError(FString::Printf(TEXT("Rasterizer coverage differs from the reference on random triangles: %s"), *RandomReport.ToString()));
+    }
+
+    // coverage and depth on the triangles that are easy to get wrong
+    FAutoShuffleRasterizerReport DegenerateReport;
+    const float DegenerateVertices[][9] = {
+        // collinear, two equal vertices, all equal
+        { 10.f, 10.f, 100.f, 20.f, 20.f, 200.f, 40.f, 40.f, 300.f },
+        { 10.f, 10.f, 100.f, 10.f, 10.f, 200.f, 40.f, 50.f, 300.f },
+        { 10.f, 10.f, 100.f, 10.f, 10.f, 100.f, 10.f, 10.f, 100.f },
+        // slivers along and across the rows
+        { 0.f, 100.f, 100.f, 900.f, 100.3f, 200.f, 450.f, 100.1f, 300.f },
+        { 100.f, 0.f, 100.f, 100.2f, 390.f, 200.f, 100.4f, 10.f, 300.f },
+        // smaller than a pixel, inside and around a pixel center
+        { 10.4f, 10.4f, 100.f, 10.6f, 10.5f, 200.f, 10.5f, 10.7f, 300.f },
+        { 9.9f, 9.9f, 100.f, 10.1f, 9.9f, 200.f, 10.f, 10.1f, 300.f },
+        // edges along the pixel centers: a top, a left and a diagonal edge through them
+        { 10.5f, 10.5f, 100.f, 50.5f, 10.5f, 200.f, 10.5f, 50.5f, 300.f },
+        { 10.f, 10.f, 100.f, 50.f, 50.f, 200.f, 10.f, 90.f, 300.f },
+        // vertices on the pixel centers, and on the pixel corners
+        { 10.5f, 10.5f, 100.f, 60.5f, 20.5f, 200.f, 30.5f, 70.5f, 300.f },
+        { 10.f, 10.f, 100.f, 60.f, 20.f, 200.f, 30.f, 70.f, 300.f },
+        // over the borders of the device, and larger than the device
+        { -50.5f, -30.5f, 100.f, 80.f, 20.f, 200.f, 10.f, 90.f, 300.f },
+        { -200.f, -200.f, 100.f, 1200.f, -100.f, 200.f, 500.f, 600.f, 300.f },
+        // very different depths
+        { 100.f, 100.f, 1.f, 300.f, 120.f, 100000.f, 180.f, 300.f, 10.f }
+    };
+    for (int32 TriangleIdx = 0; TriangleIdx < ARRAY_COUNT(DegenerateVertices); ++TriangleIdx)
+    {
+        const float* Vertex = DegenerateVertices[TriangleIdx];
+        int32 MismatchesNum = DegenerateReport.MismatchedTrianglesNum;
+        CheckRasterizerCoverage(&FAutoShuffleWindowModule::TriangleRasterizer,
+            F2DPointf(Vertex[0], Vertex[1], Vertex[2]), F2DPointf(Vertex[3], Vertex[4], Vertex[5]), F2DPointf(Vertex[6], Vertex[7], Vertex[8]), DegenerateReport);
+        if (DegenerateReport.MismatchedTrianglesNum != MismatchesNum)
+        {
+            Test.AddError(FString::Printf(TEXT("Rasterizer coverage differs from the reference on degenerate triangle %d"), TriangleIdx));
+        }
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("Rasterizer coverage on degenerate triangles: %s"), *DegenerateReport.ToString());
+}
+
+void FAutoShuffleWindowTests::TestRasterizerWatertightness(FAutomationTestBase& Test)
+{
+    FRandomStream Stream(0);
+    float Width = OCCLUSION_VISIBILITY_RESOLUTION_WIDTH, Height = OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT;
+
+    // the diagonals of random convex quads, half of them with the vertices on the pixel grid so that the diagonal goes through pixel centers
+    FAutoShuffleRasterizerReport Report;
+    for (int32 QuadIdx = 0; QuadIdx < AUTO_SHUFFLE_RASTERIZER_TEST_QUADS; ++QuadIdx)
+    {
+        F2DPointf Center(Stream.FRandRange(0.f, Width), Stream.FRandRange(0.f, Height), 0.f);
+        float Radius = FMath::Pow(2.f, Stream.FRandRange(1.f, 7.f));
+        TArray<float> Angles;
+        for (int32 VertexIdx = 0; VertexIdx < 4; ++VertexIdx)
+        {
+            Angles.Add(Stream.FRandRange(0.f, 2.f * PI));
+        }
+        Angles.Sort();
+        TArray<F2DPointf> Vertices;
+        for (int32 VertexIdx = 0; VertexIdx < 4; ++VertexIdx)
+        {
+            F2DPointf Vertex(Center.X + Radius * FMath::Cos(Angles[VertexIdx]), Center.Y + Radius * FMath::Sin(Angles[VertexIdx]), Stream.FRandRange(100.f, 10000.f));
+            if (QuadIdx % 2 == 1)
+            {
+                Vertex.X = FMath::RoundToFloat(Vertex.X);
+                Vertex.Y = FMath::RoundToFloat(Vertex.Y);
+            }
+            Vertices.Add(Vertex);
+        }
+        CheckRasterizerWatertightness(&FAutoShuffleWindowModule::TriangleRasterizer, Vertices[0], Vertices[1], Vertices[2], Vertices[3], Report);
+    }
+    UE_LOG(LogAutoShuffle, Log, TEXT("Rasterizer watertightness on %d shared edges: %d holes, %d pixels drawn twice"), Report.SharedEdgesNum, Report.HolesNum, Report.OverlapsNum);
+    if (Report.HasErrors())
+    {
+        Test.AddError(FString::Printf(TEXT("Rasterizer is not watertight on %d shared edges: %d holes, %d pixels drawn twice"), Report.SharedEdgesNum, Report.HolesNum, Report.OverlapsNum));
+    }
+}
+
+void FAutoShuffleWindowTests::TestRasterizerThroughput(FAutomationTestBase& Test)
+{
+    FRandomStream Stream(0);
+    float Width = OCCLUSION_VISIBILITY_RESOLUTION_WIDTH, Height = OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT;
+
+    // small, medium and large triangles, drawn in both windings as the occlusion does
+    const float PerfSizes[] = { 4.f, 32.f, 256.f };
+    for (int32 SizeIdx = 0; SizeIdx < ARRAY_COUNT(PerfSizes); ++SizeIdx)
+    {
+        TArray<F2DPointf> Vertices;
+        Vertices.Reserve(3 * AUTO_SHUFFLE_RASTERIZER_TEST_PERF_TRIANGLES);
+        for (int32 TriangleIdx = 0; TriangleIdx < AUTO_SHUFFLE_RASTERIZER_TEST_PERF_TRIANGLES; ++TriangleIdx)
+        {
+            float CenterX = Stream.FRandRange(0.f, Width), CenterY = Stream.FRandRange(0.f, Height);
+            for (int32 VertexIdx = 0; VertexIdx < 3; ++VertexIdx)
+            {
+                Vertices.Add(F2DPointf(CenterX + Stream.FRandRange(-PerfSizes[SizeIdx], PerfSizes[SizeIdx]), CenterY + Stream.FRandRange(-PerfSizes[SizeIdx], PerfSizes[SizeIdx]), Stream.FRandRange(100.f, 10000.f)));
+            }
+        }
+        int64 PixelsNum = 0, ReferencePixelsNum = 0;
+        double Seconds = MeasureRasterizerThroughput(&FAutoShuffleWindowModule::TriangleRasterizer, Vertices, PixelsNum);
+        double ReferenceSeconds = MeasureRasterizerThroughput(&FAutoShuffleWindowTests::ReferenceTriangleRasterizer, Vertices, ReferencePixelsNum);
+        UE_LOG(LogAutoShuffle, Log, TEXT("Rasterizer throughput on %d triangles of size %.0f: %.0f triangles/s, %.0f pixels/s (reference %.0f triangles/s, %.0f pixels/s)"),
+            AUTO_SHUFFLE_RASTERIZER_TEST_PERF_TRIANGLES, PerfSizes[SizeIdx], AUTO_SHUFFLE_RASTERIZER_TEST_PERF_TRIANGLES / FMath::Max(Seconds, 1e-9), PixelsNum / FMath::Max(Seconds, 1e-9),
+            AUTO_SHUFFLE_RASTERIZER_TEST_PERF_TRIANGLES / FMath::Max(ReferenceSeconds, 1e-9), ReferencePixelsNum / FMath::Max(ReferenceSeconds, 1e-9));
+        if (PixelsNum != ReferencePixelsNum)
+        {
+            Test.AddError(FString::Printf(TEXT("Rasterizer drew %lld pixels for triangles of size %.0f, the reference %lld"), PixelsNum, PerfSizes[SizeIdx], ReferencePixelsNum));
+        }
+    }
+}
+
+TArray<F2DPoint>* FAutoShuffleWindowTests::ReferenceTriangleRasterizer(const F2DPointf &V1, const F2DPointf &V2, const F2DPointf &V3)
+{
+    // The fill convention written out for every pixel around the triangle, with nothing carried over from one pixel to the next:
+    // the pixel (x, y) is drawn when its center (x + 0.5, y + 0.5) has no negative barycentric coordinate in a counter-clockwise
+    // triangle, with y going down the rows, and any zero one is across a top edge (along a row, the triangle under it) or
+    // a left edge (going down, the triangle on its right). The depth interpolates the vertices by the same coordinates
+    TArray<F2DPoint> *PointArray = new TArray<F2DPoint>;
+
+    const F2DPointf* Vertices[] = { &V1, &V2, &V3 };
+    double Area = ((double)V2.X - V1.X) * ((double)V3.Y - V1.Y) - ((double)V2.Y - V1.Y) * ((double)V3.X - V1.X);
+    // flat, or clockwise
+    if (Area >= 0.0)
+    {
+        return PointArray;
+    }
+
+    int32 MinX = FMath::FloorToInt(FMath::Min3(V1.X, V2.X, V3.X)) - 1, MaxX = FMath::CeilToInt(FMath::Max3(V1.X, V2.X, V3.X)) + 1;
+    int32 MinY = FMath::FloorToInt(FMath::Min3(V1.Y, V2.Y, V3.Y)) - 1, MaxY = FMath::CeilToInt(FMath::Max3(V1.Y, V2.Y, V3.Y)) + 1;
+    for (int32 y = MinY; y <= MaxY; ++y)
+    {
+        for (int32 x = MinX; x <= MaxX; ++x)
+        {
+            double CenterX = x + 0.5, CenterY = y + 0.5;
+            double Weights[3];
+            bool bIsDrawn = true;
+            for (int32 VertexIdx = 0; VertexIdx < 3 && bIsDrawn; ++VertexIdx)
+            {
+                // the coordinate of a vertex is the area the center spans with the edge across from it, over the area of the triangle
+                const F2DPointf &From = *Vertices[(VertexIdx + 1) % 3], &To = *Vertices[(VertexIdx + 2) % 3];
+                Weights[VertexIdx] = ((From.X - CenterX) * (To.Y - CenterY) - (From.Y - CenterY) * (To.X - CenterX)) / Area;
+                if (Weights[VertexIdx] == 0.0)
+                {
+                    bIsDrawn = (From.Y == To.Y && To.X < From.X) || To.Y > From.Y;
+                }
+                else
+                {
+                    bIsDrawn = Weights[VertexIdx] > 0.0;
+                }
+            }
+            if (bIsDrawn)
+            {
+                double z = Weights[0] * V1.Z + Weights[1] * V2.Z + Weights[2] * V3.Z;
+                PointArray->Add(F2DPoint(x, y, (float)z));
+            }
+        }
+    }
+    return PointArray;
+}
+
+void FAutoShuffleWindowTests::CheckRasterizerCoverage(FAutoShuffleTriangleRasterizer Rasterizer, const F2DPointf &V1, const F2DPointf &V2, const F2DPointf &V3, FAutoShuffleRasterizerReport& Report)
+{
+    // each winding on its own, so that drawing the wrong winding is caught as well
+    int32 MismatchesNum = Report.MissingPixelsNum + Report.ExtraPixelsNum + Report.DuplicatePixelsNum + Report.DepthErrorsNum;
+    for (int Winding = 0; Winding < 2; ++Winding)
+    {
+        TMap<FIntPoint, float> ExpectedPixels, ActualPixels;
+        TArray<F2DPoint> *ExpectedPoints = Winding == 0 ? ReferenceTriangleRasterizer(V1, V2, V3) : ReferenceTriangleRasterizer(V1, V3, V2);
+        for (auto PointIt = ExpectedPoints->CreateConstIterator(); PointIt; ++PointIt)
+        {
+            ExpectedPixels.Add(FIntPoint(PointIt->X, PointIt->Y), PointIt->Z);
+        }
+        delete ExpectedPoints;
+        TArray<F2DPoint> *ActualPoints = Winding == 0 ? Rasterizer(V1, V2, V3) : Rasterizer(V1, V3, V2);
+        for (auto PointIt = ActualPoints->CreateConstIterator(); PointIt; ++PointIt)
+        {
+            FIntPoint Pixel(PointIt->X, PointIt->Y);
+            if (ActualPixels.Contains(Pixel))
+            {
+                ++Report.DuplicatePixelsNum;
+                continue;
+            }
+            ActualPixels.Add(Pixel, PointIt->Z);
+        }
+        delete ActualPoints;
+        for (auto PixelIt = ExpectedPixels.CreateConstIterator(); PixelIt; ++PixelIt)
+        {
+            const float* ActualDepth = ActualPixels.Find(PixelIt.Key());
+            if (ActualDepth == nullptr)
+            {
+                ++Report.MissingPixelsNum;
+                continue;
+            }
+            float DepthError = FMath::Abs(*ActualDepth - PixelIt.Value()) / FMath::Max(FMath::Abs(PixelIt.Value()), 1.f);
+            Report.MaxDepthError = FMath::Max(Report.MaxDepthError, DepthError);
+            if (DepthError > AUTO_SHUFFLE_RASTERIZER_TEST_DEPTH_TOLERANCE)
+            {
+                ++Report.DepthErrorsNum;
+            }
+        }
+        for (auto PixelIt = ActualPixels.CreateConstIterator(); PixelIt; ++PixelIt)
+        {
+            if (!ExpectedPixels.Contains(PixelIt.Key()))
+            {
+                ++Report.ExtraPixelsNum;
+            }
+        }
+        Report.PixelsNum += ExpectedPixels.Num();
+    }
+    ++Report.TrianglesNum;
+    if (Report.MissingPixelsNum + Report.ExtraPixelsNum + Report.DuplicatePixelsNum + Report.DepthErrorsNum != MismatchesNum)
+    {
+        ++Report.MismatchedTrianglesNum;
+    }
+}
+
+void FAutoShuffleWindowTests::CheckRasterizerWatertightness(FAutoShuffleTriangleRasterizer Rasterizer, const F2DPointf &V1, const F2DPointf &V2, const F2DPointf &V3, const F2DPointf &V4, FAutoShuffleRasterizerReport& Report)
+{
+    // the quad V1 V2 V3 V4 is split along V1 V3, and every pixel whose center is strictly inside it must be drawn exactly once
+    const F2DPointf* Quad[] = { &V1, &V2, &V3, &V4 };
+    double Orientation = 0.0;
+    for (int32 EdgeIdx = 0; EdgeIdx < 4; ++EdgeIdx)
+    {
+        const F2DPointf &A = *Quad[EdgeIdx], &B = *Quad[(EdgeIdx + 1) % 4], &C = *Quad[(EdgeIdx + 2) % 4];
+        double Cross = ((double)B.X - A.X) * ((double)C.Y - B.Y) - ((double)B.Y - A.Y) * ((double)C.X - B.X);
+        // only the strictly convex quads have a well defined inside
+        if (FMath::Abs(Cross) < 1e-9 || Cross * Orientation < 0.0)
+        {
+            return;
+        }
+        Orientation = Cross;
+    }
+    TMap<FIntPoint, int32> DrawsNum;
+    const F2DPointf* Triangles[][3] = { { &V1, &V2, &V3 }, { &V1, &V3, &V4 } };
+    for (int32 TriangleIdx = 0; TriangleIdx < 2; ++TriangleIdx)
+    {
+        const F2DPointf &A = *Triangles[TriangleIdx][0], &B = *Triangles[TriangleIdx][1], &C = *Triangles[TriangleIdx][2];
+        for (int Winding = 0; Winding < 2; ++Winding)
+        {
+            TArray<F2DPoint> *Points = Winding == 0 ? Rasterizer(A, B, C) : Rasterizer(A, C, B);
+            for (auto PointIt = Points->CreateConstIterator(); PointIt; ++PointIt)
+            {
+                ++DrawsNum.FindOrAdd(FIntPoint(PointIt->X, PointIt->Y));
+            }
+            delete Points;
+        }
+    }
+    int32 MinX = FMath::FloorToInt(FMath::Min(FMath::Min(V1.X, V2.X), FMath::Min(V3.X, V4.X)));
+    int32 MaxX = FMath::CeilToInt(FMath::Max(FMath::Max(V1.X, V2.X), FMath::Max(V3.X, V4.X)));
+    int32 MinY = FMath::FloorToInt(FMath::Min(FMath::Min(V1.Y, V2.Y), FMath::Min(V3.Y, V4.Y)));
+    int32 MaxY = FMath::CeilToInt(FMath::Max(FMath::Max(V1.Y, V2.Y), FMath::Max(V3.Y, V4.Y)));
+    for (int32 y = MinY; y <= MaxY; ++y)
+    {
+        for (int32 x = MinX; x <= MaxX; ++x)
+        {
+            double CenterX = x + 0.5, CenterY = y + 0.5;
+            bool bIsInside = true;
+            for (int32 EdgeIdx = 0; EdgeIdx < 4 && bIsInside; ++EdgeIdx)
+            {
+                const F2DPointf &A = *Quad[EdgeIdx], &B = *Quad[(EdgeIdx + 1) % 4];
+                double Edge = ((double)B.X - A.X) * (CenterY - A.Y) - ((double)B.Y - A.Y) * (CenterX - A.X);
+                bIsInside = Edge * Orientation > 0.0;
+            }
+            if (!bIsInside)
+            {
+                continue;
+            }
+            int32 PixelDrawsNum = DrawsNum.FindRef(FIntPoint(x, y));
+            if (PixelDrawsNum == 0)
+            {
+                ++Report.HolesNum;
+            }
+            else if (PixelDrawsNum > 1)
+            {
+                ++Report.OverlapsNum;
+            }
+        }
+    }
+    ++Report.SharedEdgesNum;
+}
+
+double FAutoShuffleWindowTests::MeasureRasterizerThroughput(FAutoShuffleTriangleRasterizer Rasterizer, const TArray<F2DPointf>& Vertices, int64& OutPixelsNum)
+{
+    OutPixelsNum = 0;
+    double StartTime = FPlatformTime::Seconds();
+    for (int32 VertexIdx = 0; VertexIdx + 2 < Vertices.Num(); VertexIdx += 3)
+    {
+        const F2DPointf &V1 = Vertices[VertexIdx], &V2 = Vertices[VertexIdx + 1], &V3 = Vertices[VertexIdx + 2];
+        for (int Winding = 0; Winding < 2; ++Winding)
+        {
+            TArray<F2DPoint> *Points = Winding == 0 ? Rasterizer(V1, V2, V3) : Rasterizer(V1, V3, V2);
+            OutPixelsNum += Points->Num();
+            delete Points;
+        }
+    }
+    return FPlatformTime::Seconds() - StartTime;
+}
+
+void FAutoShuffleWindowTests::RunBenchmark(FAutomationTestBase& Test, int32 ProductsNum)
+{
+    int32 ShelvesNum = 10, LevelsNum = 5, MembersNum = 50, Seed = 0;
+    FParse::Value(FCommandLine::Get(), TEXT("AutoShuffleBenchmarkShelves="), ShelvesNum);
+    FParse::Value(FCommandLine::Get(), TEXT("AutoShuffleBenchmarkLevels="), LevelsNum);
+    FParse::Value(FCommandLine::Get(), TEXT("AutoShuffleBenchmarkMembers="), MembersNum);
+    FParse::Value(FCommandLine::Get(), TEXT("AutoShuffleBenchmarkSeed="), Seed);
+    ShelvesNum = FMath::Max(ShelvesNum, 1);
+    LevelsNum = FMath::Max(LevelsNum, 1);
+    MembersNum = FMath::Max(MembersNum, 1);
+    if (ProductsNum <= 0)
+    {
+        Test.AddError(FString::Printf(TEXT("%d products is no benchmark size"), ProductsNum));
+        return;
+    }
+    if (FAutoShuffleWindowModule::ShuffleTickerHandle.IsValid() || FAutoShuffleWindowModule::WhitelistTickerHandle.IsValid())
+    {
+        Test.AddError(TEXT("A shuffle or a whitelist read is running. The benchmark needs the store for itself."));
+        return;
+    }
+    // the session of the window lives in the same statics as the run; it is not thrown away for a benchmark
+    if (FAutoShuffleWindowModule::ProductStore.Num() > 0 || FAutoShuffleWindowModule::ShelvesWhitelist.Num() > 0)
+    {
+        Test.AddError(TEXT("A whitelist is read in the window. The benchmark needs the store for itself; run it in an editor without a session."));
+        return;
+    }
+    FString FileDir = GetBenchmarkFileDir();
+    bool bIsNewFile = !IFileManager::Get().FileExists(*FileDir);
+    TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*FileDir, FILEWRITE_Append));
+    if (!FileWriter.IsValid())
+    {
+        Test.AddError(FString::Printf(TEXT("The benchmark results could not be written to %s"), *FileDir));
+        return;
+    }
+    FAutoShuffleExportBuffer Buffer(FileWriter.Get());
+    if (bIsNewFile)
+    {
+        Buffer.AppendText(TEXT("Date,Products,Shelves,Levels,Members,Placed,SpawnMilliseconds,ResolveMilliseconds,ShuffleMilliseconds,OcclusionMilliseconds,MallocCalls,UsedPhysicalDeltaMB,PeakUsedPhysicalDeltaMB\n"));
+    }
+    // the settings of the window by default, so that the runs are comparable whatever the window shows
+    FAutoShuffleSettings Settings;
+    FMath::RandInit(Seed);
+    // the peak of the process outlives the run, so the run is charged the most physical memory used at the end of any of its phases
+    FPlatformMemoryStats MemoryBefore = FPlatformMemory::GetStats();
+    uint64 PeakUsedPhysical = MemoryBefore.UsedPhysical;
+#if !UE_BUILD_SHIPPING
+    uint32 MallocCallsBefore = FMalloc::TotalMallocCalls;
+#endif
+    double StartTime = FPlatformTime::Seconds();
+    // the scene goes into a world of its own, so that the level open in the editor is neither changed nor dirtied
+    UWorld* PreviousTargetWorld = FAutoShuffleWindowModule::TargetWorld.Get();
+    UWorld* World = UWorld::CreateWorld(EWorldType::Editor, false);
+    FAutoShuffleWindowModule::SetTargetWorld(World);
+    FAutoShuffleWhitelistDescription Whitelist;
+    BuildBenchmarkScene(World, ShelvesNum, LevelsNum, FMath::DivideAndRoundUp(ProductsNum, MembersNum), MembersNum, Whitelist);
+    double SpawnSeconds = FPlatformTime::Seconds() - StartTime;
+    PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+    FAutoShuffleWindowModule::RunTimings.Reset();
+    StartTime = FPlatformTime::Seconds();
+    bool bIsResolved = FAutoShuffleWindowModule::ResolveWhitelist(Whitelist);
+    double ResolveSeconds = FPlatformTime::Seconds() - StartTime;
+    PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+    double ShuffleSeconds = 0.0, OcclusionSeconds = 0.0;
+    int32 PlacedNum = 0;
+    if (bIsResolved)
+    {
+        StartTime = FPlatformTime::Seconds();
+        FAutoShuffleWindowModule::ShuffleProducts(Settings);
+        ShuffleSeconds = FPlatformTime::Seconds() - StartTime;
+        PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+        StartTime = FPlatformTime::Seconds();
+        FAutoShuffleWindowModule::ComputeOcclusionVisibilityWithSettings(Settings);
+        OcclusionSeconds = FPlatformTime::Seconds() - StartTime;
+        for (int32 ProductIdx = 0; ProductIdx < FAutoShuffleWindowModule::ProductStore.Num(); ++ProductIdx)
+        {
+            PlacedNum += FAutoShuffleWindowModule::ProductStore.IsDiscarded(ProductIdx) ? 0 : 1;
+        }
+    }
+    else
+    {
+        Test.AddError(FString::Printf(TEXT("The whitelist of the benchmark scene of %d products did not resolve"), ProductsNum));
+    }
+    int32 MallocCalls = 0;
+#if !UE_BUILD_SHIPPING
+    MallocCalls = FMalloc::TotalMallocCalls - MallocCallsBefore;
+#endif
+    FPlatformMemoryStats MemoryAfter = FPlatformMemory::GetStats();
+    PeakUsedPhysical = FMath::Max<uint64>(PeakUsedPhysical, MemoryAfter.UsedPhysical);
+    // the session was empty before the run, so everything in it points at the actors about to go with the world
+    FAutoShuffleWindowModule::ShelvesWhitelist.Reset();
+    FAutoShuffleWindowModule::ProductsWhitelist.Reset();
+    FAutoShuffleWindowModule::ProductStore.Reset();
+    FAutoShuffleWindowModule::ActorLabelIndex.Reset();
+    FAutoShuffleWindowModule::UnresolvedGroups.Reset();
+    FAutoShuffleWindowModule::NonProductActors.Reset();
+    FAutoShuffleWindowModule::VisibilityWorld.Reset();
+    FAutoShuffleWindowModule::LayoutSnapshots.Remove(TEXT("PreviousShuffle"));
+    FAutoShuffleWindowModule::SetTargetWorld(PreviousTargetWorld);
+    World->DestroyWorld(false);
+    float UsedPhysicalDeltaMB = ((int64)MemoryAfter.UsedPhysical - (int64)MemoryBefore.UsedPhysical) / (1024.f * 1024.f);
+    float PeakUsedPhysicalDeltaMB = ((int64)PeakUsedPhysical - (int64)MemoryBefore.UsedPhysical) / (1024.f * 1024.f);
+    UE_LOG(LogAutoShuffle, Log, TEXT("Benchmark %d products on %d shelves: %d placed, spawn %.1f ms, resolve %.1f ms, shuffle %.1f ms, occlusion %.1f ms, %d mallocs, %+.1f MB used, %+.1f MB at the peak"),
+        ProductsNum, ShelvesNum, PlacedNum, SpawnSeconds * 1000.0, ResolveSeconds * 1000.0, ShuffleSeconds * 1000.0, OcclusionSeconds * 1000.0, MallocCalls, UsedPhysicalDeltaMB, PeakUsedPhysicalDeltaMB);
+    Buffer.AppendText(FString::Printf(TEXT("%s,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%d,%.3f,%.3f\n"), *FDateTime::Now().ToString(), ProductsNum, ShelvesNum, LevelsNum, MembersNum, PlacedNum,
+        SpawnSeconds * 1000.0, ResolveSeconds * 1000.0, ShuffleSeconds * 1000.0, OcclusionSeconds * 1000.0, MallocCalls, UsedPhysicalDeltaMB, PeakUsedPhysicalDeltaMB));
+    Buffer.Flush();
+    FileWriter->Close();
+}
+
+void FAutoShuffleWindowTests::BuildBenchmarkScene(UWorld* World, int32 ShelvesNum, int32 LevelsNum, int32 GroupsNum, int32 MembersNum, FAutoShuffleWhitelistDescription& OutWhitelist)
+{
+    UStaticMesh* ShapeMeshes[] = {
+        LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube")),
+        LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cylinder.Cylinder")),
+        LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Sphere.Sphere"))
+    };
+    UStaticMesh* CubeMesh = ShapeMeshes[0];
+    static const FName OverlapAllProfileName(TEXT("OverlapAll"));
+    // the basic shapes are 100 units wide; the products get as many slots on a level as they need
+    float ProductWidth = 100.f * AUTO_SHUFFLE_BENCHMARK_PRODUCT_SCALE;
+    int32 ProductsPerLevel = FMath::DivideAndRoundUp(GroupsNum * MembersNum, ShelvesNum * LevelsNum);
+    float ShelfLength = FMath::Max(200.f, ProductsPerLevel * ProductWidth * 1.5f);
+    float LevelHeight = AUTO_SHUFFLE_BENCHMARK_SHELF_HEIGHT / LevelsNum;
+    // the products rest a little above the plates and are lowered by the offset, as on the real shelves
+    float RestingGap = 0.5f;
+    for (int32 ShelfIdx = 0; ShelfIdx < ShelvesNum; ++ShelfIdx)
+    {
+        // the shelves stand in a row along y and are looked at from small x, like in the supermarket levels
+        FVector ShelfCenter(0.f, ShelfIdx * (ShelfLength + 100.f), AUTO_SHUFFLE_BENCHMARK_SHELF_HEIGHT * 0.5f);
+        AActor* ShelfActor = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform(ShelfCenter));
+        USceneComponent* ShelfRoot = NewObject<USceneComponent>(ShelfActor);
+        ShelfActor->SetRootComponent(ShelfRoot);
+        ShelfRoot->RegisterComponent();
+        // a back panel and one plate per level, each a scaled cube
+        for (int32 PanelIdx = 0; PanelIdx <= LevelsNum; ++PanelIdx)
+        {
+            UStaticMeshComponent* Panel = NewObject<UStaticMeshComponent>(ShelfActor);
+            Panel->SetStaticMesh(CubeMesh);
+            Panel->SetCollisionProfileName(OverlapAllProfileName);
+            Panel->bGenerateOverlapEvents = true;
+            Panel->SetupAttachment(ShelfRoot);
+            if (PanelIdx == LevelsNum)
+            {
+                Panel->SetRelativeLocation(FVector(AUTO_SHUFFLE_BENCHMARK_SHELF_DEPTH * 0.5f, 0.f, 0.f));
+                Panel->SetRelativeScale3D(FVector(AUTO_SHUFFLE_BENCHMARK_PLATE_THICKNESS, ShelfLength, AUTO_SHUFFLE_BENCHMARK_SHELF_HEIGHT) / 100.f);
+            }
+            else
+            {
+                float PlateCenterZ = PanelIdx * LevelHeight + AUTO_SHUFFLE_BENCHMARK_PLATE_THICKNESS * 0.5f - AUTO_SHUFFLE_BENCHMARK_SHELF_HEIGHT * 0.5f;
+                Panel->SetRelativeLocation(FVector(0.f, 0.f, PlateCenterZ));
+                Panel->SetRelativeScale3D(FVector(AUTO_SHUFFLE_BENCHMARK_SHELF_DEPTH, ShelfLength, AUTO_SHUFFLE_BENCHMARK_PLATE_THICKNESS) / 100.f);
+            }
+            Panel->RegisterComponent();
+        }
+        FString ShelfName = FString::Printf(TEXT("AutoShuffleBenchmark_Shelf_%d"), ShelfIdx);
+        ShelfActor->SetActorLabel(ShelfName);
+        FAutoShuffleShelfDescription& Shelf = OutWhitelist.Shelves[OutWhitelist.Shelves.AddDefaulted()];
+        Shelf.Name = ShelfName;
+        Shelf.Scale = 1.f;
+        for (int32 LevelIdx = 0; LevelIdx < LevelsNum; ++LevelIdx)
+        {
+            Shelf.ShelfBase.Add((LevelIdx * LevelHeight + AUTO_SHUFFLE_BENCHMARK_PLATE_THICKNESS + RestingGap) / AUTO_SHUFFLE_BENCHMARK_SHELF_HEIGHT);
+            Shelf.ShelfOffset.Add(RestingGap / AUTO_SHUFFLE_BENCHMARK_SHELF_HEIGHT);
+        }
+    }
+    // the products are spawned apart from each other and away from the shelves; the shuffle parks them anyway
+    OutWhitelist.ProductGroups.Reserve(GroupsNum);
+    for (int32 GroupIdx = 0; GroupIdx < GroupsNum; ++GroupIdx)
+    {
+        FAutoShuffleProductGroupDescription& Group = OutWhitelist.ProductGroups[OutWhitelist.ProductGroups.AddDefaulted()];
+        Group.GroupName = FString::Printf(TEXT("AutoShuffleBenchmark_Group_%d"), GroupIdx);
+        Group.ShelfName = FString::Printf(TEXT("AutoShuffleBenchmark_Shelf_%d"), GroupIdx % ShelvesNum);
+        Group.Scale = AUTO_SHUFFLE_BENCHMARK_PRODUCT_SCALE;
+        UStaticMesh* ShapeMesh = ShapeMeshes[GroupIdx % ARRAY_COUNT(ShapeMeshes)];
+        for (int32 MemberIdx = 0; MemberIdx < MembersNum; ++MemberIdx)
+        {
+            int32 ProductIdx = GroupIdx * MembersNum + MemberIdx;
+            FVector SpawnLocation(-1000.f - (ProductIdx / 256) * 2.f * ProductWidth, (ProductIdx % 256) * 2.f * ProductWidth, 0.f);
+            AStaticMeshActor* ProductActor = World->SpawnActor<AStaticMeshActor>(AStaticMeshActor::StaticClass(), FTransform(SpawnLocation));
+            ProductActor->SetMobility(EComponentMobility::Movable);
+            ProductActor->GetStaticMeshComponent()->SetStaticMesh(ShapeMesh);
+            ProductActor->GetStaticMeshComponent()->SetCollisionProfileName(OverlapAllProfileName);
+            ProductActor->GetStaticMeshComponent()->bGenerateOverlapEvents = true;
+            FString ProductName = FString::Printf(TEXT("AutoShuffleBenchmark_Product_%d"), ProductIdx);
+            ProductActor->SetActorLabel(ProductName);
+            Group.MemberNames.Add(ProductName);
+            Group.MemberScales.Add(AUTO_SHUFFLE_BENCHMARK_PRODUCT_SCALE);
+        }
+    }
+}
+
+FString FAutoShuffleWindowTests::GetBenchmarkFileDir()
+{
+    return FPaths::Combine(*FPaths::GameSavedDir(), TEXT("AutoShuffle"), TEXT("Benchmark.csv"));
+}
+
+FAutoShuffleRasterizerReport::FAutoShuffleRasterizerReport()
+{
+    TrianglesNum = 0;
+    PixelsNum = 0;
+    MismatchedTrianglesNum = 0;
+    MissingPixelsNum = 0;
+    ExtraPixelsNum = 0;
+    DuplicatePixelsNum = 0;
+    DepthErrorsNum = 0;
+    MaxDepthError = 0.f;
+    SharedEdgesNum = 0;
+    HolesNum = 0;
+    OverlapsNum = 0;
+}
+
+FString FAutoShuffleRasterizerReport::ToString() const
+{
+    return FString::Printf(TEXT("%d / %d triangles differ from the reference over %lld pixels: %d missing, %d extra, %d drawn twice, %d off in depth (%g at most)"),
+        MismatchedTrianglesNum, TrianglesNum, PixelsNum, MissingPixelsNum, ExtraPixelsNum, DuplicatePixelsNum, DepthErrorsNum, MaxDepthError);
+}
+
+bool FAutoShuffleRasterizerReport::HasErrors() const
+{
+    return MismatchedTrianglesNum > 0 || HolesNum > 0 || OverlapsNum > 0;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
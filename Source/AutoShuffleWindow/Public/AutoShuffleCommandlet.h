@@ -0,0 +1,25 @@
+// Copyright 1998-2016 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "AutoShuffleCommandlet.generated.h"
+
+/** Shuffle, compute the occlusion and export the layouts of a map without the editor UI, e.g.
+ *  UE4Editor Project.uproject -run=AutoShuffle -nullrhi -Map=/Game/Maps/Supermarket -FirstSeed=0 -Layouts=100
+ *  -Density=0.5 -Proximity=0.5 -Organize=false -PerGroup=false -RowStacking=false -Occlusion=0.9 -Output=/data/LayoutManifest.bin */
+UCLASS()
+class UAutoShuffleCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UAutoShuffleCommandlet();
+
+    /** UCommandlet implementation */
+    virtual int32 Main(const FString& Params) override;
+
+private:
+    /** Load the map and initialize its world for the overlap queries. Null if it could not be loaded */
+    static UWorld* LoadTargetWorld(const FString& MapName);
+};
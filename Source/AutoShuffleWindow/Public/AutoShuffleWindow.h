@@ -3,18 +3,38 @@
 #pragma once
 
 #include "ModuleManager.h"
+#include "Async/Future.h"
 
 class FToolBarBuilder;
 class FMenuBuilder;
 class FAutoShuffleObject;
 class FAutoShuffleShelf;
 class FAutoShuffleProductGroup;
+class FAutoShuffleProductStore;
+class FAutoShuffleNamePattern;
+class FAutoShuffleDiscoverySettings;
+class FAutoShuffleExportBuffer;
+class FAutoShuffleSettings;
+class FAutoShufflePhaseTimings;
+class FAutoShufflePlacementStats;
+class FAutoShuffleGroupPlacement;
+class FAutoShuffleLayoutSnapshot;
+class FAutoShuffleShelfDescription;
+class FAutoShuffleProductGroupDescription;
+class FAutoShuffleWhitelistDescription;
+class FAutoShuffleDecompositionJob;
+class FAutoShuffleOcclusionGeometry;
+class FAutoShuffleOcclusionMesh;
+class SNotificationItem;
+class UStaticMesh;
+class AStaticMeshActor;
 class F2DPoint;
 class F2DPointf;
 class FOcclusionPixel;
 
 #define OCCLUSION_VISIBILITY_RESOLUTION_WIDTH 1000
 #define OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT 400
+#define OCCLUSION_PROXY_TRIANGLES_PER_PIXEL 0.5f
 
 class FAutoShuffleWindowModule : public IModuleInterface
 {
@@ -26,6 +46,13 @@ public:
     
     /** This function will be bound to Command (by default it will bring up plugin window) */
     void PluginButtonClicked();
+
+    /** Resolve the whitelist in the world and export the layout of the products and their occlusion for each seed
+     *  to the manifest. Every layout starts from the level as loaded. Return the number of layouts exported */
+    static int32 GenerateLayouts(const FAutoShuffleSettings& Settings, int32 FirstSeed, int32 LayoutsNum, const FString& ManifestFileDir);
+
+    /** Make the whitelist resolve to, and the exports read from, the given world instead of the editor world. Null goes back to the editor world */
+    static void SetTargetWorld(UWorld* World);
     
 private:
 
@@ -36,86 +63,476 @@ private:
 
 private:
     TSharedPtr<class FUICommandList> PluginCommands;
-    
+
+    /** The automation tests check and benchmark the private steps of the shuffle and the occlusion directly */
+    friend class FAutoShuffleWindowTests;
+
 
 /** The following are the implementations of the auto shuffle */
 private:
-    /** The main entry of the algorithm */
-    static void AutoShuffleImplementation();
+    /** The phases of a shuffle, in the order they run */
+    enum EShufflePhase
+    {
+        SP_Park,
+        SP_Place,
+        SP_Expand,
+        SP_Organize,
+        SP_Lower,
+        SP_Done
+    };
+
+    /** Get the settings of the shuffle and the occlusion visibility from the window */
+    static FAutoShuffleSettings GetWindowSettings();
+
+    /** Shuffle the products of the whitelist already read, all at once */
+    static void ShuffleProducts(const FAutoShuffleSettings& Settings);
+
+    /** Shuffle the products of the whitelist already read from the core ticker, a few steps per frame, with a progress notification to cancel it */
+    static void StartShuffle();
+
+    /** Set up the phases of a shuffle with the settings and keep the layout before it */
+    static void BeginShuffle(const FAutoShuffleSettings& Settings);
+
+    /** Run the next step of the shuffle. Return false once all the phases are done */
+    static bool StepShuffle();
+
+    /** Run steps of the shuffle within the frame budget */
+    static bool TickShuffle(float DeltaTime);
+
+    /** Stop the running shuffle. The layout before it is restored on the next tick */
+    static void CancelShuffle();
+
+    /** Get the completion of every phase of the running shuffle */
+    static FString GetShuffleProgress();
+
+    /** Get the name of a phase of the shuffle, used for the progress and the timings */
+    static const TCHAR* GetShufflePhaseName(EShufflePhase Phase);
+
+    /** The phase of the running shuffle and the next step in it */
+    static EShufflePhase ShufflePhase;
+    static int32 ShuffleStep;
+
+    /** The number of steps of each phase */
+    static int32 ShuffleStepsNum[SP_Done];
+
+    /** The density and the proxmity when the shuffle started */
+    static float ShuffleDensity;
+    static float ShuffleProxmity;
+
+    /** Set by the Cancel button of the shuffle notification */
+    static bool bIsShuffleCancelled;
+
+    /** The ticker stepping the shuffle. Valid while a shuffle is running */
+    static FDelegateHandle ShuffleTickerHandle;
+
+    /** The progress notification of the running shuffle */
+    static TSharedPtr<SNotificationItem> ShuffleNotification;
+
+    /** The wall time of each phase of the current run: a shuffle, an occlusion visibility or a batch convex decomposition */
+    static FAutoShufflePhaseTimings RunTimings;
+
+    /** Log the phase timings of the run, append them to the timings report and start over */
+    static void WritePhaseTimings(const FString& RunName);
+
+    /** Get the CSV file the phase timings of every run are appended to */
+    static FString GetPhaseTimingsFileDir();
+
+    /** The placement and expansion counters of each product group and of organizing each shelf during the last shuffle */
+    static TArray<FAutoShufflePlacementStats> GroupPlacementStats;
+    static TArray<FAutoShufflePlacementStats> ShelfPlacementStats;
+
+    /** The product group of each product, so that the expansion of a product is counted for its group */
+    static TArray<int32> ProductGroupIndices;
+
+    /** The per shelf and per group counters of the last shuffle, shown under the Auto Shuffle button */
+    static TSharedPtr<STextBlock> PlacementStatsTextBlock;
+
+    /** Get the actors overlapping the actor, counting the query */
+    static void QueryOverlappingActors(AActor* Actor, TArray<AActor*>& OutOverlappingActors, FAutoShufflePlacementStats& Stats);
+
+    /** Commit the staged transform of the product, then count and run an overlap query on it */
+    static void QueryOverlappingProducts(int32 ProductIdx, TArray<AActor*>& OutOverlappingActors, FAutoShufflePlacementStats& Stats);
+
+    /** Size the counters to the whitelist already read and zero them */
+    static void ResetPlacementStats();
+
+    /** The floor area left on each level of each shelf during the placement of a shuffle */
+    static TArray<TArray<float>> ShelfLevelFreeAreas;
+
+    /** The smallest footprint extents that found no place on each level of each shelf, and the free space epoch of the shelf they failed in */
+    static TArray<TArray<FVector2D>> ShelfLevelFailedFootprints;
+    static TArray<TArray<int32>> ShelfLevelFailureEpochs;
+
+    /** The free space epoch of each shelf, moved on whenever space may have freed up on it */
+    static TArray<int32> ShelfFreeSpaceEpochs;
+
+    /** The footprints of the members of the groups of each shelf not placed yet. Negative until the first group of the shelf is placed */
+    static TArray<float> ShelfPendingFootprints;
+
+    /** Set the area left on every shelf level to the whole level and forget the failed footprints */
+    static void ResetShelfCapacities();
+
+    /** Get the sum of the footprints of the members of the groups still to be placed on the shelf, from the given group on */
+    static float GetPendingFootprints(int32 ShelfIdx, int32 FirstGroupIdx);
+
+    /** Move on the free space epochs, so that no footprint is known to fail any more */
+    static void InvalidateFailedFootprints();
+
+    /** Whether a footprint no smaller than one that found no place on the level since the space last freed up */
+    static bool IsFootprintKnownToFail(int32 ShelfIdx, int32 LevelIdx, const FVector2D& FootprintExtent);
+
+    /** Remember a footprint that found no place on the levels it was tried enough times on */
+    static void RecordFailedFootprint(int32 ShelfIdx, const TArray<int32>& LevelTriesNum, const FVector2D& FootprintExtent);
+
+    /** Log the counters per shelf and per group, append them to the placement stats report and show them in the window */
+    static void WritePlacementStats();
+
+    /** Get the CSV file the placement counters of every shuffle are appended to */
+    static FString GetPlacementStatsFileDir();
+
+    /** The world set by SetTargetWorld, if any */
+    static TWeakObjectPtr<UWorld> TargetWorld;
+
+    /** Get the world the products and the shelves are looked up in */
+    static UWorld* GetTargetWorld();
+
+    /** When the background whitelist read and the batch convex decomposition started */
+    static double WhitelistReadStartTime;
+    static double DecompositionStartTime;
+
+    /** Compute the occlusion visibility of the products of the whitelist already read with the settings of the window */
+    static void ComputeOcclusionVisibility();
+
+    /** Compute the occlusion visibility of the products of the whitelist already read with the given settings */
+    static void ComputeOcclusionVisibilityWithSettings(const FAutoShuffleSettings& Settings);
+
+    /** Draw the actors on the rendering device and count the visible and the total pixels of each.
+     *  With proxies, each actor is drawn with the cheapest geometry fitting its projected size. Return the triangles drawn */
+    static int32 RenderOcclusion(const TArray<AStaticMeshActor*>& ActorArray, const FBox& RenderingBorder, bool bUseProxies, TArray<int32>& OutVisiblePixelCount, TArray<int32>& OutTotalPixelCount);
+
+    /** Clean the rendering device and draw the actors on it. Return the triangles drawn */
+    static int32 RasterizeOcclusion(const TArray<AStaticMeshActor*>& ActorArray, const FBox& RenderingBorder, bool bUseProxies);
+
+    /** Count the visible and the total pixels of each actor drawn on the rendering device */
+    static void CountOcclusionPixels(int32 ActorsNum, bool bUseProxies, TArray<int32>& OutVisiblePixelCount, TArray<int32>& OutTotalPixelCount);
+
+    /** Get the finest render LOD of the mesh within the triangle budget. INDEX_NONE if even the coarsest is over it */
+    static int32 SelectOcclusionLOD(UStaticMesh* StaticMesh, float TrianglesBudget);
+
+    /** Project a world position to the pixel coordinates and the depth of the rendering device */
+    static F2DPointf ProjectToRenderingDevice(const FVector& Position, const FBox& RenderingBorder);
 
-    /** The main entry of the occlusion visibility function */
-    static void OcclusionVisibilityImplementation();
+    /** Replace the projected points by their 2D convex hull and triangulate it */
+    static void BuildOutlineTriangles(TArray<F2DPointf>& Points, TArray<uint32>& OutIndices);
+
+    /** Draw the indexed triangles of the projected points on the rendering device. Return the number of triangles */
+    static int32 RasterizeTriangles(const TArray<F2DPointf>& Points, const TArray<uint32>& Indices, int32 ActorIdx);
+
+    /** Check box for also rendering in full detail and reporting the error of the proxies */
+    static TSharedPtr<SCheckBox> ProxyErrorCheckBox;
 
     /** The rendering device for occlusion visibility */
     static TArray<class FOcclusionPixel> RenderingDevice[OCCLUSION_VISIBILITY_RESOLUTION_HEIGHT][OCCLUSION_VISIBILITY_RESOLUTION_WIDTH];
     
     /** SpinBox for Density -- the density of the productions */
-    static TSharedRef<SSpinBox<float>> DensitySpinBox;
+    static TSharedPtr<SSpinBox<float>> DensitySpinBox;
     
     /** SpinBox for Proxmity -- how similar products are placed */
-    static TSharedRef<SSpinBox<float>> ProxmitySpinBox;
+    static TSharedPtr<SSpinBox<float>> ProxmitySpinBox;
 
     /** SpinBox for controlling the threshold of the occlusion percentage
      *  to be consdered as invisible */
-    static TSharedRef<SSpinBox<float>> OcclusionSpinBox;
+    static TSharedPtr<SSpinBox<float>> OcclusionSpinBox;
 
     /** Check box for toggling product organizing */
-    static TSharedRef<SCheckBox> OrganizeCheckBox;
+    static TSharedPtr<SCheckBox> OrganizeCheckBox;
 
     /** The status of the organize checkbox when button clicked */
     static bool bIsOrganizeChecked;
 
     /** Check box for per group organizing */
-    static TSharedRef<SCheckBox> PerGroupCheckBox;
+    static TSharedPtr<SCheckBox> PerGroupCheckBox;
 
     /** The status of the pergroup checkbox when button clicked */
     static bool bIsPerGroupChecked;
+
+    /** Check box for filling the depth of the shelf levels with rows of facings */
+    static TSharedPtr<SCheckBox> RowStackingCheckBox;
+
+    /** The status of the row stacking checkbox when button clicked */
+    static bool bIsRowStackingChecked;
     
     /** The regions for the discarded products */
     static FVector DiscardedProductsRegions;
+
+    /** Where the discard pool starts: the regions for the discarded products, moved under the union of the shelves' bounds */
+    static FVector GetDiscardPoolOrigin();
     
     /** Read the Whitelist of shelves and products from configure file */
     static bool ReadWhitelist();
-    
+
+    /** Whether the store holds the products of a whitelist resolved in the target world, so the session can be used as it is */
+    static bool IsSessionCurrent();
+
+    /** Get the whitelist file under the Resources of the plugin */
+    static FString GetWhitelistFileDir();
+
+    /** Parse the whitelist file into a description without touching any actor. Safe to run off the game thread.
+     *  BytesRead, if given, follows how far the file has been read */
+    static bool ParseWhitelist(const FString& FileDir, FAutoShuffleWhitelistDescription& OutWhitelist, FThreadSafeCounter* BytesRead);
+
+    /** Resolve the described shelves and products to the actors of the target world. Game thread only */
+    static bool ResolveWhitelist(const FAutoShuffleWhitelistDescription& Whitelist);
+
+    /** Parse the whitelist on a background task with a progress notification, then resolve it on the game thread and call OnResolved */
+    static void ReadWhitelistAsync(FSimpleDelegate OnResolved);
+
+    /** Poll the background parse from the core ticker */
+    static bool TickWhitelistAsync(float DeltaTime);
+
+    /** The product groups with members not found in the level at the last whitelist read */
+    static TArray<FString> UnresolvedGroups;
+
+    /** The description being parsed in the background */
+    static TSharedPtr<FAutoShuffleWhitelistDescription, ESPMode::ThreadSafe> PendingWhitelist;
+
+    /** The result of the background parse */
+    static TFuture<bool> WhitelistParseResult;
+
+    /** The bytes of the whitelist file parsed so far, and the size of the file */
+    static FThreadSafeCounter WhitelistBytesRead;
+    static int64 WhitelistFileSize;
+
+    /** The ticker polling the background parse. Valid while a read is pending */
+    static FDelegateHandle WhitelistTickerHandle;
+
+    /** Called once the whitelist read in the background is resolved */
+    static FSimpleDelegate OnWhitelistResolved;
+
+    /** The progress notification of the background read */
+    static TSharedPtr<SNotificationItem> WhitelistNotification;
+
+    /** Index from actor labels to the actors of the editor world. Rebuilt in one pass on every whitelist read */
+    static TMap<FString, AActor*> ActorLabelIndex;
+
+    /** Rebuild ActorLabelIndex from the actors of the given world */
+    static void BuildActorLabelIndex(UWorld* World);
+
+    /** Read one shelf object from the whitelist token stream */
+    static bool ReadShelfFromStream(TJsonReader<ANSICHAR>& Reader, FAutoShuffleShelfDescription& OutShelf);
+
+    /** Read one product group object from the whitelist token stream */
+    static bool ReadProductGroupFromStream(TJsonReader<ANSICHAR>& Reader, FAutoShuffleProductGroupDescription& OutGroup);
+
+    /** Resolve the shelves of one shelf object and add them to ShelvesWhitelist */
+    static void ResolveShelf(const FAutoShuffleShelfDescription& Shelf);
+
+    /** Resolve the members of one product group and add it to ProductsWhitelist. Return the number of members not found */
+    static int32 ResolveProductGroup(const FAutoShuffleProductGroupDescription& Group);
+
+    /** Resolve the actor of the given name and add it to Members if found */
+    static void AddProductMember(const FString& NewName, float NewScale);
+
+    /** Read the "Discovery" object of the whitelist token stream */
+    static bool ReadDiscoveryFromStream(TJsonReader<ANSICHAR>& Reader, FAutoShuffleDiscoverySettings& OutSettings);
+
+    /** Group the static mesh actors that the whitelist doesn't mention into product groups, assign them to shelves
+     *  and add them to ProductsWhitelist. Return the number of groups added */
+    static int32 DiscoverProductGroups(const FAutoShuffleDiscoverySettings& Settings);
+
+    /** Write the shelves and product groups in memory to a whitelist file */
+    static void WriteWhitelist(const FString& FileDir);
+
+    /** Read a Json array of strings from the whitelist token stream */
+    static bool ReadStringArrayFromStream(TJsonReader<ANSICHAR>& Reader, TArray<FString>& OutStrings);
+
+    /** Read a Json array of numbers from the whitelist token stream */
+    static bool ReadNumberArrayFromStream(TJsonReader<ANSICHAR>& Reader, TArray<float>& OutNumbers);
+
+    /** Skip the Json value that has just been started by Notation in the whitelist token stream */
+    static bool SkipValueInStream(TJsonReader<ANSICHAR>& Reader, EJsonNotation Notation);
+
     /** Whitelist of the shelves */
-    static TArray<FAutoShuffleShelf>* ShelvesWhitelist;
+    static TArray<FAutoShuffleShelf> ShelvesWhitelist;
     
-    /** Whitelist of the products */
-    static TArray<FAutoShuffleProductGroup>* ProductsWhitelist;
+    /** Whitelist of the products. The members of the groups live in ProductStore */
+    static TArray<FAutoShuffleProductGroup> ProductsWhitelist;
+
+    /** The products and shelf levels of the session, kept as parallel arrays */
+    static FAutoShuffleProductStore ProductStore;
     
     /** Add noise to position.Z of the shelf of given name w.r.t. the first shelf (fixed) */
     static void AddNoiseToShelf(const FString& ShelfName, float NoiseScale);
     
-    /** Place the products onto the shelves */
-    static void PlaceProducts(float Density, float Proxmity);
+    /** Run the next step of placing the products of a group if it belongs to the shelf: set the group up, place one of
+     *  its members, or push one product together after the last member in the per group mode. Return true once the
+     *  group is done. Exactly the share of the members given by the density is picked, as far as the share of the group
+     *  of the area left on the shelf allows, and a product that fits no level any more is discarded without trying.
+     *  Proxmity is how close the members are placed, 0 one on another and 1 at random. The shelf must be aligned with
+     *  x, y and z, and y is its longest side */
+    static bool StepPlaceProductGroup(int32 ShelfIdx, int32 GroupIdx, float Density, float Proxmity);
+
+    /** Measure the shelf and the members of the group, pick the members for the density budget and the anchor. Return false if the group is not placed on the shelf */
+    static bool BeginPlaceProductGroup(int32 ShelfIdx, int32 GroupIdx, float Density);
+
+    /** Place the next member of the group being placed */
+    static void PlaceNextProduct(float Proxmity);
+
+    /** Push a product placed at the front of the shelf into it step by step, until it collides */
+    static void PushProduct(int32 ProductIdx, FAutoShufflePlacementStats& Stats);
+
+    /** Move a product placed at the front of a level to the deepest facing free for it and fill the row in front of it with the next picked members */
+    static void StackRow(int32 LeadIdx, int32 LevelIdx);
+
+    /** The group being placed, kept from one step of the placement to the next */
+    static FAutoShuffleGroupPlacement GroupPlacement;
     
     /** Lower all the products so that they can almost touch the shevles */
     static void LowerProducts();
     
-    /** Organize the objects that are already on the shelves -- push all of them to left of the shelf until collided. Should respond to a checkbox on the plugin window */
-    static void OrganizeProducts();
+    /** Organize the objects that are already on the shelves -- push the next of them to left of the shelf until collided.
+     *  Return true once a pass over all the shelves is done. Should respond to a checkbox on the plugin window */
+    static bool StepOrganizeProducts();
+
+    /** Collect the actors of the products on the shelf that have not been discarded, in the order they are pushed */
+    static void CollectOrganizedProducts(int32 ShelfIdx);
+
+    /** Push one product to the end of its shelf until collided */
+    static void OrganizeProduct(int32 ShelfIdx, AActor* ProductActor);
+
+    /** The shelf being organized, INDEX_NONE between two passes, its products and the next of them to push */
+    static int32 OrganizeShelfIdx;
+    static TArray<AActor*> OrganizedProducts;
+    static int32 NextOrganizedProduct;
     
-    /** Predicate used for sorting AActors in OrganizeProducts from low to high */
+    /** Predicate used for sorting AActors in CollectOrganizedProducts from low to high */
     static bool OrganizeProductsPredicateLowToHigh(const AActor &Actor1, const AActor &Actor2);
 
-    /** Predicate used for sorting AActors in OrganizeProducts from high to low */
+    /** Predicate used for sorting AActors in CollectOrganizedProducts from high to low */
     static bool OrganizeProductsPredicateHighToLow(const AActor &Actor1, const AActor &Actor2);
 
-    /** The rasterization for counter-clockwise triangle, used in computing occlusion */
+    /** The rasterization for counter-clockwise triangle, used in computing occlusion. Pixels are sampled at their centers, with the top-left fill rule */
     static TArray<class F2DPoint>* TriangleRasterizer(const class F2DPointf &V1, const class F2DPointf &V2, const class F2DPointf &V3);
 
     /** Batch Convex Decomposition of the Products List */
     static void BatchConvexDecomposition();
 
+    /** Start decomposing the unique meshes of the products in the background. Groups without a preset use the given settings */
+    static void StartConvexDecomposition(float DefaultAccuracy, int32 DefaultMaxHullVerts);
+
+    /** SpinBox for the accuracy of the convex decomposition of groups without a preset */
+    static TSharedPtr<SSpinBox<float>> AccuracySpinBox;
+
+    /** SpinBox for the max vertices per hull of the convex decomposition of groups without a preset */
+    static TSharedPtr<SSpinBox<int32>> MaxHullVertsSpinBox;
+
+    /** Describe the decomposition settings, as stored in the metadata of the decomposed meshes */
+    static FString GetConvexDecompositionSettings(float InAccuracy, int32 InMaxHullVerts);
+
+    /** Describe the decomposition settings and the derived data key of the render data of the mesh, as stored in its metadata */
+    static FString DescribeConvexDecomposition(UStaticMesh* StaticMesh, float InAccuracy, int32 InMaxHullVerts);
+
+    /** Whether the mesh already has hulls from a batch decomposition of the same description, settings and render data */
+    static bool IsConvexDecompositionCurrent(UStaticMesh* StaticMesh, const FString& DecompositionSettings);
+
+    /** Copy the LOD0 vertices and the indices of the sections with collision of the mesh */
+    static void ExtractCollisionGeometry(UStaticMesh* StaticMesh, TArray<FVector>& OutVerts, TArray<uint32>& OutIndices);
+
+    /** Hash the collision geometry and the decomposition settings into the key of the hull cache */
+    static FString GetConvexHullCacheKey(const TArray<FVector>& Verts, const TArray<uint32>& Indices, float InAccuracy, int32 InMaxHullVerts);
+
+    /** Get the file of the hull cache entry of the given key, under Saved/AutoShuffle/ConvexHullCache */
+    static FString GetConvexHullCacheFileDir(const FString& CacheKey);
+
+    /** Read the hull vertices of the cache entry. Return false if there is no valid entry */
+    static bool LoadConvexHullsFromCache(const FString& CacheKey, TArray<TArray<FVector>>& OutHulls);
+
+    /** Write the hull vertices to the cache entry */
+    static void SaveConvexHullsToCache(const FString& CacheKey, TArray<TArray<FVector>>& Hulls);
+
+    /** Decompose the geometry into the vertices of convex hulls with V-HACD. Touches no UObject, so it may run on any thread */
+    static void DecomposeGeometryToHulls(const TArray<FVector>& Verts, const TArray<uint32>& Indices, float InAccuracy, int32 InMaxHullVerts, TArray<TArray<FVector>>& OutHulls);
+
+    /** Replace the simple collision of the mesh by convex elements of the given hull vertices. Game thread only */
+    static void ApplyConvexDecomposition(UStaticMesh* StaticMesh, const TArray<TArray<FVector>>& Hulls, const FString& Settings, const FString& HullKey);
+
+    /** Store the description of the decomposition and the hull cache key of the geometry in the metadata of the mesh */
+    static void RecordConvexDecomposition(UStaticMesh* StaticMesh, const FString& Settings, const FString& HullKey);
+
+    /** Apply the finished decompositions and start new ones, from the core ticker */
+    static bool TickConvexDecomposition(float DeltaTime);
+
+    /** Start no more decompositions. Those running are still applied */
+    static void CancelConvexDecomposition();
+
+    /** One job per unique mesh of the running batch decomposition */
+    static TArray<FAutoShuffleDecompositionJob> DecompositionJobs;
+
+    /** The next job to start, the jobs started but not applied and the jobs applied */
+    static int32 NextDecompositionJob;
+    static int32 RunningDecompositionJobs;
+    static int32 AppliedDecompositionJobs;
+
+    /** The jobs served from the hull cache */
+    static FThreadSafeCounter CachedDecompositionJobs;
+
+    /** Set by the Cancel button of the progress notification */
+    static FThreadSafeBool bIsDecompositionCancelled;
+
+    /** The ticker of the running batch decomposition. Valid while it runs */
+    static FDelegateHandle DecompositionTickerHandle;
+
+    /** The progress notification of the running batch decomposition */
+    static TSharedPtr<SNotificationItem> DecompositionNotification;
+
     /** The status for toggling non-products visibility */
     static bool bIsNonProductsVisible;
 
     /** The implementation of toggling the non-products visibility */
     static void NonProductsVisibilityTogglingImplementation();
 
+    /** The actors of the level that are not products, as of the last whitelist read */
+    static TArray<TWeakObjectPtr<AActor>> NonProductActors;
+
+    /** The world NonProductActors was collected from */
+    static TWeakObjectPtr<UWorld> VisibilityWorld;
+
+    /** Remove the products of the store from NonProductActors */
+    static void TrackNonProductActors();
+
     /** The implementation of export the mapping between actor id and actor display name */
     static void ExportMappingBetweenActorIdAndDisplayName();
 
+    /** Check box for adding the transform, world AABB, mesh and product group columns to the mapping */
+    static TSharedPtr<SCheckBox> DetailedExportCheckBox;
+
+    /** Check box for exporting the mapping as binary records instead of csv */
+    static TSharedPtr<SCheckBox> BinaryExportCheckBox;
+
+    /** Quote a csv field if it contains a comma, a quote or a line break */
+    static FString EscapeCsvField(const FString& Field);
+
+    /** Text box for the name of the layout snapshot to save or restore */
+    static TSharedPtr<SEditableTextBox> SnapshotNameTextBox;
+
+    /** The layout snapshots taken in this session by name. The layout before the last shuffle is kept as "PreviousShuffle" */
+    static TMap<FString, FAutoShuffleLayoutSnapshot> LayoutSnapshots;
+
+    /** Capture the current layout of the products under the name in the text box and save it to Data/Snapshots */
+    static void SaveLayoutSnapshot();
+
+    /** Restore the layout of the name in the text box, from memory if taken in this session or else from Data/Snapshots */
+    static void RestoreLayoutSnapshot();
+
+    /** Get the file of the layout snapshot of the given name */
+    static FString GetLayoutSnapshotFileDir(const FString& SnapshotName);
+
+    /** Append the current layout of the products as one columnar record to Data/LayoutManifest.bin */
+    static void AppendLayoutManifest();
+
+    /** Append the current layout of the products as one columnar record to the file. Return whether it was written */
+    static bool WriteLayoutManifest(const FString& ManifestFileDir);
+
 public:
     /** Static method for parsing the Whitelist written in Json */
     static TSharedPtr<FJsonObject> ParseJSON(const FString& FileContents, const FString& NameForErrors, bool bSilent);
@@ -141,58 +558,18 @@ public:
     /** Get the position */
     FVector GetPosition() const;
     
-    /** Set the rotation */
-    void SetRotation(FVector& NewRotation);
-    
-    /** Get the rotation */
-    FVector GetRotation() const;
-    
     /** Set the scale */
     void SetScale(float NewScale);
     
     /** Get the scale */
     float GetScale() const;
     
-    /** Shrink the scale: keep x, y and 1/3 z. Used to fit to the shelf */
-    void ShrinkScale();
-    
-    /** Expand the Scale: set scale of x, y to z, then expand as big as possible before original scale of x and y. Used to fit to the shelf */
-    void ExpandScale();
-    
     /** Set the ObjectActor */
     void SetObjectActor(AActor* NewObjectActor);
     
     /** Get the ObjectActor */
     AActor* GetObjectActor() const;
     
-    /** Set the bIsDiscarded */
-    void Discard();
-    
-    /** Get the bIsDiscarded */
-    bool IsDiscarded();
-    
-    /** Reset the bIsDiscarded */
-    void ResetDiscard();
-    
-    /** Set the fShelfOffset */
-    void SetShelfOffset(float NewShelfOffset);
-    
-    /** Get the fShelfOffset */
-    float GetShelfOffset() const;
-    
-    /** Return if the object is contained in the given bound */
-    bool IsContainedIn(FVector& BoundOrigin, FVector& BoundExtent);
-    
-    /** Return if the object is on shelf */
-    bool IsOnShelf() const;
-    
-    /** Reset the bIsOnShelf */
-    void ResetOnShelf();
-    
-    /** Put on Shelf */
-    void SetOnShelf();
-    
-    
 private:
     /** The rendering scale of the shelf in the editor world */
     float Scale;
@@ -203,23 +580,8 @@ private:
     /** The Position of the object in the editor world */
     FVector Position;
     
-    /** The Rotation of the object in the editor world */
-    FVector Rotation;
-    
     /** Pointer to the AActor in the Editor World */
     AActor* ObjectActor;
-    
-    /** Whether this object has been discarded */
-    bool bIsDiscarded;
-    
-    /** Because the collision model of the shelf isn't perfect, we need to add offset to the object 
-     *  to make it touch the surface of the shelf even if collision is already detected. 
-     *  @note this value is not a relative value. It is the real value. 
-     *  @todo find more elegant way of doing this */
-    float fShelfOffset;
-    
-    /** Whether the object is already placed on the shelf */
-    bool bIsOnShelf;
 };
 
 class FAutoShuffleShelf : public FAutoShuffleObject
@@ -229,24 +591,21 @@ public:
     FAutoShuffleShelf();
     ~FAutoShuffleShelf();
     
-    /** Get the shelf base */
-    TArray<float>* GetShelfBase() const;
+    /** Set the levels of the shelf as a range of the shelf levels in the product store */
+    void SetLevels(int32 NewFirstLevel, int32 NewLevelsNum);
     
-    /** Set the shelf base */
-    void SetShelfBase(TArray<float>* NewShelfBase);
+    /** Get the index of the first level in the product store */
+    int32 GetFirstLevel() const;
     
-    /** Get the shelf offset */
-    TArray<float>* GetShelfOffset() const;
-    
-    /** Set the shelf offset */
-    void SetShelfOffset(TArray<float>* NewShelfOffset);
+    /** Get the number of levels */
+    int32 GetLevelsNum() const;
     
 private:
-    /** The relative heights of each level of bases measured from bottom */
-    TArray<float>* ShelfBase;
+    /** The index of the first level of the shelf in the product store */
+    int32 FirstLevel;
     
-    /** The relative offset of each level of bases measured from bottom */
-    TArray<float>* ShelfOffset;
+    /** The number of levels of the shelf */
+    int32 LevelsNum;
 };
 
 class FAutoShuffleProductGroup
@@ -256,11 +615,17 @@ public:
     FAutoShuffleProductGroup();
     ~FAutoShuffleProductGroup();
     
-    /** Set the members. Each member is an instance of the product group */
-    void SetMembers(TArray<FAutoShuffleObject>* NewMembers);
+    /** Set the members as a range of the products in the product store. Each member is an instance of the product group */
+    void SetMembers(int32 NewFirstMember, int32 NewMembersNum);
+    
+    /** Get the index of the first member in the product store */
+    int32 GetFirstMember() const;
     
-    /** Get the members */
-    TArray<FAutoShuffleObject>* GetMembers() const;
+    /** Get the index after the last member in the product store */
+    int32 GetMembersEnd() const;
+    
+    /** Get the number of members */
+    int32 GetMembersNum() const;
     
     /** Set the group name */
     void SetName(FString& NewName);
@@ -282,10 +647,23 @@ public:
 
     /** Return if the whole group is discarded */
     bool IsDiscarded();
+
+    /** Set the convex decomposition preset. A negative accuracy or a non-positive vertex count means none */
+    void SetDecompositionPreset(float NewAccuracy, int32 NewMaxHullVerts);
+
+    /** Get the decomposition accuracy of the preset, or the default if none */
+    float GetDecompositionAccuracy(float DefaultAccuracy) const;
+
+    /** Get the max vertices per hull of the preset, or the default if none */
+    int32 GetDecompositionMaxHullVerts(int32 DefaultMaxHullVerts) const;
+
+    /** Return if the group has a decomposition preset */
+    bool HasDecompositionPreset() const;
     
 private:
-    /** The members of the product. Proxmity is used for deciding placing members */
-    TArray<FAutoShuffleObject>* Members;
+    /** The members of the product as a range of the product store. Proxmity is used for deciding placing members */
+    int32 FirstMember;
+    int32 MembersNum;
     
     /** The group name */
     FString Name;
@@ -296,6 +674,612 @@ private:
     /** Whether the whole group is discarded by whitelist */
     /** This is extremely important */
     bool bIsDiscarded;
+
+    /** The convex decomposition preset of the group */
+    float DecompositionAccuracy;
+    int32 DecompositionMaxHullVerts;
+};
+
+class FAutoShuffleProductStore
+{
+public:
+    /** Construct and Deconstruct */
+    FAutoShuffleProductStore();
+    ~FAutoShuffleProductStore();
+
+    /** Forget all the products and shelf levels. The memory is kept for the next whitelist read */
+    void Reset();
+
+    /** Add a product and return its index */
+    int32 AddProduct(const FName& NewName, AActor* NewObjectActor, float NewScale);
+
+    /** Get the number of products */
+    int32 Num() const;
+
+    /** Add the levels of one shelf and return the index of the first level */
+    int32 AddShelfLevels(const TArray<float>& NewLevelBases, const TArray<float>& NewLevelOffsets);
+
+    /** Get the relative height of the shelf level measured from bottom */
+    float GetLevelBase(int32 LevelIdx) const;
+
+    /** Get the relative offset of the shelf level */
+    float GetLevelOffset(int32 LevelIdx) const;
+
+    /** Get the product name */
+    FName GetName(int32 ProductIdx) const;
+
+    /** Stage the position. The actor moves at the next commit */
+    void SetPosition(int32 ProductIdx, const FVector& NewPosition);
+
+    /** Get the position */
+    FVector GetPosition(int32 ProductIdx) const;
+
+    /** Set the scale and stage it. The actor is scaled at the next commit */
+    void SetScale(int32 ProductIdx, float NewScale);
+
+    /** Get the scale */
+    float GetScale(int32 ProductIdx) const;
+
+    /** Shrink the scale: keep x, y and 1/3 z. Used to fit to the shelf */
+    void ShrinkScale(int32 ProductIdx);
+
+    /** Expand the Scale: set scale of x, y to z, then expand as big as possible before original scale of x and y. Used to fit to the shelf.
+     *  Return the number of scale steps tried, one overlap query each */
+    int32 ExpandScale(int32 ProductIdx);
+
+    /** Get the ObjectActor */
+    AActor* GetObjectActor(int32 ProductIdx) const;
+
+    /** Set where the discard pool starts. Parked products are laid out on a grid from there */
+    void SetDiscardPool(const FVector& NewDiscardPoolOrigin);
+
+    /** Set the discarded bit and park the product in the discard pool with its collision and rendering disabled */
+    void Discard(int32 ProductIdx);
+
+    /** Get the discarded bit */
+    bool IsDiscarded(int32 ProductIdx) const;
+
+    /** Reset the discarded bit and take the product out of the discard pool. The position is left to the caller */
+    void ResetDiscard(int32 ProductIdx);
+
+    /** Set the shelf offset */
+    void SetShelfOffset(int32 ProductIdx, float NewShelfOffset);
+
+    /** Get the shelf offset */
+    float GetShelfOffset(int32 ProductIdx) const;
+
+    /** Set the shelf level the product is placed on */
+    void SetShelfLevel(int32 ProductIdx, int32 NewShelfLevel);
+
+    /** Get the shelf level the product is placed on. INDEX_NONE if none */
+    int32 GetShelfLevel(int32 ProductIdx) const;
+
+    /** Return if the object is on shelf */
+    bool IsOnShelf(int32 ProductIdx) const;
+
+    /** Put on Shelf */
+    void SetOnShelf(int32 ProductIdx);
+
+    /** Reset the on shelf bit */
+    void ResetOnShelf(int32 ProductIdx);
+
+    /** Get all the state bits at once. Used by layout snapshots */
+    uint8 GetStates(int32 ProductIdx) const;
+
+    /** Set all the state bits at once, parking or unparking the product if the discarded bit changes. Used by layout snapshots */
+    void SetStates(int32 ProductIdx, uint8 NewStates);
+
+    /** Set the position, rotation and scale of the actor in one transform update, dropping what was staged */
+    void SetTransform(int32 ProductIdx, const FTransform& NewTransform);
+
+    /** Get the world bounds the product will have once its staged transform is committed */
+    void GetBounds(int32 ProductIdx, FVector& OutOrigin, FVector& OutExtent);
+
+    /** Commit the staged transform of the product and get the actors overlapping it */
+    void GetOverlappingActors(int32 ProductIdx, TArray<AActor*>& OutOverlappingActors);
+
+    /** Apply the staged position and scale of the product to its actor in one movement update */
+    void CommitTransform(int32 ProductIdx);
+
+    /** Commit the staged transforms of all the products. Return the number of actors updated */
+    int32 CommitTransforms();
+
+    /** Set the fraction of the product hidden by other products, computed by the occlusion visibility */
+    void SetOcclusionRatio(int32 ProductIdx, float NewOcclusionRatio);
+
+    /** Get the occlusion ratio. Negative if not computed since the whitelist was read */
+    float GetOcclusionRatio(int32 ProductIdx) const;
+
+private:
+    /** The bits of States */
+    enum EProductState
+    {
+        PS_Discarded = 1 << 0,
+        PS_OnShelf = 1 << 1
+    };
+
+    /** The bits of TransformDirtyBits */
+    enum ETransformDirty
+    {
+        TD_Position = 1 << 0,
+        TD_Scale = 1 << 1
+    };
+
+    /** Enable or disable the collision and rendering of a product going into or out of the discard pool */
+    void SetParked(int32 ProductIdx, bool bIsParked);
+
+    /** Stage the actor scale, which may differ from the whitelist scale while the product is shrunk or expanded */
+    void StageScale(int32 ProductIdx, const FVector& NewScale3D);
+
+    /** Where the grid of the discard pool starts */
+    FVector DiscardPoolOrigin;
+
+    /** The Position of each product in the editor world, staged until committed */
+    TArray<FVector> Positions;
+
+    /** The scale of each product given by the whitelist */
+    TArray<float> Scales;
+
+    /** The actor scale of each product, staged until committed */
+    TArray<FVector> StagedScales;
+
+    /** The ETransformDirty bits of each product: what is staged and not yet applied to the actor */
+    TArray<uint8> TransformDirtyBits;
+
+    /** Because the collision model of the shelf isn't perfect, we need to add offset to the object
+     *  to make it touch the surface of the shelf even if collision is already detected.
+     *  @note this value is not a relative value. It is the real value.
+     *  @todo find more elegant way of doing this */
+    TArray<float> ShelfOffsets;
+
+    /** The EProductState bits of each product */
+    TArray<uint8> States;
+
+    /** The shelf level each product is placed on */
+    TArray<int32> ShelfLevels;
+
+    /** Pointer to the AActor of each product in the Editor World */
+    TArray<AActor*> ObjectActors;
+
+    /** The name of each product. Only used for logging and exporting */
+    TArray<FName> Names;
+
+    /** The occlusion ratio of each product, negative if unknown */
+    TArray<float> OcclusionRatios;
+
+    /** The relative heights of each level of all the shelves measured from bottom */
+    TArray<float> LevelBases;
+
+    /** The relative offset of each level of all the shelves */
+    TArray<float> LevelOffsets;
+};
+
+class FAutoShuffleLayoutSnapshot
+{
+public:
+    /** Construct and Deconstruct */
+    FAutoShuffleLayoutSnapshot();
+    ~FAutoShuffleLayoutSnapshot();
+
+    /** Record the transforms and the states of all the products of the store in one pass */
+    void Capture(const FAutoShuffleProductStore& Store);
+
+    /** Apply the snapshot to the products of the store with the same names. Return the number restored */
+    int32 Restore(FAutoShuffleProductStore& Store) const;
+
+    /** Save the snapshot to a file */
+    bool SaveToFile(const FString& FileDir);
+
+    /** Load the snapshot from a file */
+    bool LoadFromFile(const FString& FileDir);
+
+    /** Get the number of products recorded */
+    int32 Num() const;
+
+private:
+    /** Read or write the snapshot, column by column */
+    void Serialize(FArchive& Ar);
+
+    /** The names of the products */
+    TArray<FString> Names;
+
+    /** The actor transforms of the products */
+    TArray<FTransform> Transforms;
+
+    /** The state bits of the products */
+    TArray<uint8> States;
+
+    /** The shelf levels of the products */
+    TArray<int32> ShelfLevels;
+
+    /** The shelf offsets of the products */
+    TArray<float> ShelfOffsets;
+};
+
+class FAutoShuffleNamePattern
+{
+public:
+    /** Construct and Deconstruct */
+    FAutoShuffleNamePattern();
+    ~FAutoShuffleNamePattern();
+
+    /** Parse a pattern like chips_pringles_{001..500} or chips_kettle_{001..010,168..176,201}.
+     *  The width of the first index in braces is the zero padding of all the names. Indices are non-negative and
+     *  a pattern expanding to more than AUTO_SHUFFLE_NAME_PATTERN_MAX_NAMES names is refused */
+    bool Parse(const FString& Pattern);
+
+    /** Replace the indices in braces by an explicit list. The padding of the pattern is kept and negative indices are skipped */
+    void SetIndices(const TArray<float>& NewIndices);
+
+    /** Get the number of names the pattern expands to */
+    int32 Num() const;
+
+    /** Get the name of the given position in the expansion */
+    FString GetName(int32 NameIdx) const;
+
+private:
+    /** Get the number of names without the int32 overflow of huge ranges */
+    int64 GetNamesNum() const;
+
+    /** Whether the item is a non-negative index that fits in an int32 */
+    static bool IsIndex(const FString& Item);
+
+    /** The text before and after the braces */
+    FString Prefix, Suffix;
+
+    /** The number of digits of each index, padded with zeros */
+    int32 Width;
+
+    /** Inclusive index ranges in the order they appear in the pattern */
+    TArray<FIntPoint> Ranges;
+};
+
+class FAutoShuffleDiscoverySettings
+{
+public:
+    FAutoShuffleDiscoverySettings();
+
+    /** Whether the whitelist asks for discovery */
+    bool bIsEnabled;
+
+    /** Group by the shared UStaticMesh instead of the label prefix before the trailing _NNN */
+    bool bGroupByMesh;
+
+    /** Assign groups to shelves by the prefix rules first; groups matching no rule go to the closest shelf */
+    bool bAssignByRules;
+
+    /** Only actors whose labels start with one of these are considered. Empty means all */
+    TArray<FString> IncludePrefixes;
+
+    /** The prefix rules and the shelves they assign to */
+    TArray<FString> RulePrefixes;
+    TArray<FString> RuleShelfNames;
+
+    /** Groups with fewer members are not products */
+    int32 MinMembers;
+
+    /** The scale of the discovered products */
+    float Scale;
+
+    /** If not empty, the resulting whitelist is written to this file under Resources */
+    FString Output;
+};
+
+class FAutoShuffleExportBuffer
+{
+public:
+    /** Construct on an opened archive. The archive is not owned. Bytes are written in chunks of ChunkSize */
+    FAutoShuffleExportBuffer(FArchive* NewArchive, int32 NewChunkSize = 64 * 1024);
+
+    /** Flush what is left */
+    ~FAutoShuffleExportBuffer();
+
+    /** Append the text encoded as UTF-8 */
+    void AppendText(const FString& Text);
+
+    /** Append the string as its UTF-8 byte length (int32) followed by the bytes */
+    void AppendString(const FString& Text);
+
+    /** Append raw bytes */
+    void AppendBytes(const void* Data, int32 Num);
+
+    /** Append the four components X, Y, Z, W of the quaternion as floats. FQuat may be padded or aligned for SIMD,
+     *  so it is never written as raw bytes */
+    void AppendQuat(const FQuat& Quat);
+
+    /** Append a plain value as raw bytes */
+    template<typename ValueType>
+    void AppendValue(const ValueType& Value)
+    {
+        AppendBytes(&Value, sizeof(ValueType));
+    }
+
+    /** Write the buffered bytes to the archive */
+    void Flush();
+
+private:
+    /** The archive written to */
+    FArchive* Archive;
+
+    /** The bytes not written yet */
+    TArray<uint8> Buffer;
+
+    /** The number of bytes that triggers a write */
+    int32 ChunkSize;
+};
+
+class FAutoShuffleSettings
+{
+public:
+    /** Construct with the defaults of the window */
+    FAutoShuffleSettings();
+
+    /** How many products are placed and how close the members of a group are placed */
+    float Density;
+    float Proxmity;
+
+    /** Whether the products are organized after the placement, and after each group */
+    bool bIsOrganizing;
+    bool bIsPerGroup;
+
+    /** Whether a placed product is followed by the next members of its group in a row from the back of the level to the front */
+    bool bIsRowStacking;
+
+    /** The visible fraction under which a product is hidden by the occlusion visibility */
+    float OcclusionThreshold;
+
+    /** Whether the occlusion visibility also renders in full detail to report the error of the proxies */
+    bool bIsProxyErrorReported;
+};
+
+class FAutoShufflePlacementStats
+{
+public:
+    /** Construct with all the counters zeroed */
+    FAutoShufflePlacementStats();
+
+    /** Add the counters of another group, used to sum up a shelf */
+    FAutoShufflePlacementStats& operator+=(const FAutoShufflePlacementStats& Other);
+
+    /** Count a product pushed into the shelf by the given steps */
+    void AddPush(int32 StepsNum);
+
+    /** Get the average distance the products were pushed into the shelf */
+    float GetAveragePushDistance() const;
+
+    /** Get the counters in one line for the log and the window */
+    FString ToString() const;
+
+    /** Get the CSV header of the counters and the counters as a CSV row */
+    static FString GetCsvHeader();
+    FString ToCsvRow() const;
+
+    /** The products described and the products placed */
+    int32 ProductsNum;
+    int32 PlacedNum;
+
+    /** The overlap queries and the extra tries of the placement loops */
+    int32 QueriesNum;
+    int32 RetriesNum;
+
+    /** The placement loops that ran out of tries */
+    int32 RetryBoundHitsNum;
+
+    /** The products discarded by the density, for lack of room on the shelf, and for lack of room near the anchor of the group */
+    int32 DiscardedByDensityNum;
+    int32 DiscardedNoRoomNum;
+    int32 DiscardedNoRoomNearAnchorNum;
+
+    /** The products discarded without a query because no level of the shelf had the area left for them */
+    int32 DiscardedNoCapacityNum;
+
+    /** The products discarded without a query because no smaller product fitted the levels with area left */
+    int32 DiscardedKnownToFailNum;
+
+    /** The products placed in the row of another product of the group by the row stacking */
+    int32 StackedNum;
+
+    /** The products pushed into the shelf and the steps they were pushed by */
+    int32 PushedNum;
+    int32 PushStepsNum;
+
+    /** The scale steps of the expansion */
+    int32 ExpansionStepsNum;
+};
+
+class FAutoShuffleGroupPlacement
+{
+public:
+    /** Construct with no group being placed */
+    FAutoShuffleGroupPlacement();
+
+    /** Forget the group being placed */
+    void Reset();
+
+    /** The shelf and the group being placed, INDEX_NONE when none is */
+    int32 ShelfIdx;
+    int32 GroupIdx;
+
+    /** The member to place in the next step. The members are all placed once it reaches their number */
+    int32 NextMemberIdx;
+
+    /** The bounding box of the shelf, and the Z values and the Z offsets of its levels */
+    FVector BoundingBoxOrigin;
+    FVector BoundingBoxExtent;
+    TArray<float> ShelfBaseZ;
+    TArray<float> ShelfOffsetZ;
+
+    /** The footprint of each member and its extents */
+    TArray<float> Footprints;
+    TArray<FVector2D> FootprintExtents;
+
+    /** The members picked for the density budget, and those already placed in the row of another member */
+    TArray<bool> bIsSelected;
+    TArray<bool> bIsStacked;
+
+    /** The level of the anchor the members are placed near, and the anchor */
+    int32 ShelfBaseIdx;
+    FVector Anchor;
+};
+
+class FAutoShufflePhaseTimings
+{
+public:
+    /** Construct and Deconstruct */
+    FAutoShufflePhaseTimings();
+    ~FAutoShufflePhaseTimings();
+
+    /** Forget the phases of the last run */
+    void Reset();
+
+    /** Add wall time to a phase */
+    void Add(const FString& Phase, double Seconds);
+
+    /** Get the wall time of all the phases */
+    double GetTotalSeconds() const;
+
+    /** Get the phases and their times in one line for the log */
+    FString ToString() const;
+
+    /** Append a row per phase to the CSV file, writing the header if the file is new */
+    bool AppendToFile(const FString& FileDir, const FString& RunName) const;
+
+private:
+    /** The phases in the order they first ran */
+    TArray<FString> Phases;
+
+    /** The wall time of each phase */
+    TArray<double> PhaseSeconds;
+};
+
+class FAutoShufflePhaseScope
+{
+public:
+    /** Add the wall time from construction to destruction to the phase */
+    FAutoShufflePhaseScope(FAutoShufflePhaseTimings& NewTimings, const TCHAR* NewPhase);
+    ~FAutoShufflePhaseScope();
+
+private:
+    FAutoShufflePhaseTimings& Timings;
+    const TCHAR* Phase;
+    double StartTime;
+};
+
+class FAutoShuffleShelfDescription
+{
+public:
+    FAutoShuffleShelfDescription();
+
+    /** The shelf name, or the pattern of the names of the shelves sharing the levels */
+    FString Name, NamePattern;
+
+    /** The rendering scale of the shelf */
+    float Scale;
+
+    /** The relative heights and offsets of the levels */
+    TArray<float> ShelfBase, ShelfOffset;
+};
+
+class FAutoShuffleProductGroupDescription
+{
+public:
+    FAutoShuffleProductGroupDescription();
+
+    /** The group name and the name of the shelf that this group belongs to */
+    FString GroupName, ShelfName;
+
+    /** Whether the whole group is discarded */
+    bool bIsDiscarded;
+
+    /** The compact member descriptor, its explicit indices and the scale of its members */
+    FString MemberPattern;
+    TArray<float> Indices;
+    float Scale;
+
+    /** The members listed one by one */
+    TArray<FString> MemberNames;
+    TArray<float> MemberScales;
+
+    /** The convex decomposition preset. Negative or zero means the settings of the window */
+    float DecompositionAccuracy;
+    int32 DecompositionMaxHullVerts;
+};
+
+class FAutoShuffleWhitelistDescription
+{
+public:
+    /** The shelf objects in the order of the whitelist */
+    TArray<FAutoShuffleShelfDescription> Shelves;
+
+    /** The product groups in the order of the whitelist */
+    TArray<FAutoShuffleProductGroupDescription> ProductGroups;
+
+    /** The discovery settings */
+    FAutoShuffleDiscoverySettings Discovery;
+};
+
+class FAutoShuffleOcclusionGeometry
+{
+public:
+    /** The vertices in the space of the mesh */
+    TArray<FVector> Vertices;
+
+    /** Three indices per triangle */
+    TArray<uint32> Indices;
+};
+
+class FAutoShuffleOcclusionMesh
+{
+public:
+    FAutoShuffleOcclusionMesh();
+
+    /** Get the triangles of the source model, loaded on first use. Null if the mesh has no source model */
+    const FAutoShuffleOcclusionGeometry* GetFullDetail(UStaticMesh* StaticMesh);
+
+    /** Get the triangles of the render LOD, loaded on first use */
+    const FAutoShuffleOcclusionGeometry* GetRenderLOD(UStaticMesh* StaticMesh, int32 LODIdx);
+
+private:
+    /** The source model and whether it has been loaded */
+    FAutoShuffleOcclusionGeometry FullDetail;
+    bool bIsFullDetailLoaded;
+
+    /** The render LODs loaded so far */
+    TArray<FAutoShuffleOcclusionGeometry> RenderLODs;
+};
+
+class FAutoShuffleDecompositionJob
+{
+public:
+    FAutoShuffleDecompositionJob();
+
+    /** The mesh to decompose */
+    TWeakObjectPtr<UStaticMesh> StaticMesh;
+
+    /** Whether the job has started and is not applied yet */
+    bool bIsRunning;
+
+    /** The vertices of the hulls the background task decomposed the mesh into, turned into convex elements when applied */
+    TArray<TArray<FVector>> Hulls;
+
+    /** Whether the hulls are to be applied, once the background task ends */
+    TFuture<bool> Result;
+
+    /** The decomposition settings, and their description stored in the mesh metadata */
+    float Accuracy;
+    int32 MaxHullVerts;
+    FString Settings;
+
+    /** The hull cache key the mesh was last decomposed for, empty if it has no batch hulls any more, and the key the task hashes from its geometry */
+    FString StoredHullKey;
+    FString HullKey;
+
+    /** Whether the task found the hulls of the mesh made for the same geometry and settings, so that only the metadata is updated */
+    bool bIsCurrent;
+
+    /** Whether the hulls came from the hull cache, and the time the background task took */
+    bool bIsCached;
+    double Seconds;
 };
 
 class F2DPoint